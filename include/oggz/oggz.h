@@ -580,6 +580,8 @@ oggz_content_type (OggzStreamContent content);
 #include <oggz/oggz_write.h>
 #include <oggz/oggz_io.h>
 #include <oggz/oggz_comments.h>
+#include <oggz/oggz_page.h>
+#include <oggz/oggz_stats.h>
 #include <oggz/oggz_deprecated.h>
 
 #ifdef __cplusplus
@@ -40,8 +40,9 @@
 /**
  * Flags to oggz_new(), oggz_open(), and oggz_openfd().
  * Can be or'ed together in the following combinations:
- * - OGGZ_READ | OGGZ_AUTO
- * - OGGZ_WRITE | OGGZ_NONSTRICT | OGGZ_PREFIX | OGGZ_SUFFIX
+ * - OGGZ_READ | OGGZ_AUTO | OGGZ_NOCRC
+ * - OGGZ_WRITE | OGGZ_NONSTRICT | OGGZ_PREFIX | OGGZ_SUFFIX | OGGZ_AUTO |
+ *   OGGZ_SORT
  */
 enum OggzFlags {
   /** Read only */
@@ -74,7 +75,27 @@ enum OggzFlags {
    * Ogg stream, ie. disable checking for conformance with
    * beginning-of-stream constraints.
    */
-  OGGZ_SUFFIX       = 0x80
+  OGGZ_SUFFIX       = 0x80,
+
+  /**
+   * Skip page checksum verification while reading. Pages are
+   * recognised by their capture pattern and lengths alone. This is
+   * faster, but corrupt pages are delivered rather than skipped, so
+   * only use it for data from trusted storage.
+   */
+  OGGZ_NOCRC        = 0x100,
+
+  /**
+   * Write pages in time order. Pages are held until every other stream
+   * with a metric has been written up to the same time, so that
+   * streams may be fed at different rates and still be interleaved,
+   * as oggz-merge does. Each stream needs a metric, eg. by also
+   * setting OGGZ_AUTO; streams without one are written as soon as
+   * their pages are made. Held pages are released as the streams
+   * advance, and all of them once every stream has ended with an
+   * e_o_s packet.
+   */
+  OGGZ_SORT         = 0x200
 
 };
 
@@ -176,6 +197,9 @@ enum OggzError {
   /** Out of memory */
   OGGZ_ERR_OUT_OF_MEMORY                = -18,
 
+  /** Packet not queued, as the writer's packet queue is full */
+  OGGZ_ERR_QUEUE_FULL                   = -19,
+
   /** The requested serialno does not exist in this OGGZ */
   OGGZ_ERR_BAD_SERIALNO                 = -20,
 
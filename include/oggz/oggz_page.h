@@ -0,0 +1,219 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_PAGE_H__
+#define __OGGZ_PAGE_H__
+
+/** \file
+ * Page header manipulation
+ *
+ * Tools which rewrite Ogg data page by page, such as oggz-chop,
+ * oggz-sort and oggz-basetime, typically change only a few bytes of each
+ * page header. The functions in this file make such changes and update
+ * the page checksum from the changed bytes only, rather than
+ * recalculating it over the whole page with ogg_page_checksum_set().
+ */
+
+/**
+ * Overwrite bytes of a page header, updating the page checksum
+ * incrementally.
+ * If the checksum of \a og was valid before this call, it remains valid
+ * afterwards. The page body is not read: the cost is proportional to
+ * \a length, plus a term logarithmic in the number of bytes which follow
+ * the changed range.
+ * \param og An ogg_page
+ * \param offset The byte offset into og->header at which to write
+ * \param data The bytes to write
+ * \param length The number of bytes to write
+ * \retval 0 Success
+ * \retval OGGZ_ERR_INVALID The given range lies outside og->header, or
+ * overlaps the checksum field (bytes 22 to 25)
+ */
+int oggz_page_patch_header (ogg_page * og, long offset,
+                            const unsigned char * data, long length);
+
+/**
+ * Set the granulepos of a page, updating the page checksum incrementally.
+ * \param og An ogg_page
+ * \param granulepos The new granulepos
+ * \retval 0 Success
+ * \retval OGGZ_ERR_INVALID \a og is not a valid page
+ */
+int oggz_page_set_granulepos (ogg_page * og, ogg_int64_t granulepos);
+
+/**
+ * Set or clear the e_o_s (end of stream) flag of a page, updating the
+ * page checksum incrementally.
+ * \param og An ogg_page
+ * \param eos Non-zero to set the flag, zero to clear it
+ * \retval 0 Success
+ * \retval OGGZ_ERR_INVALID \a og is not a valid page
+ */
+int oggz_page_set_eos (ogg_page * og, int eos);
+
+/**
+ * Verify the checksum of a page.
+ * \param og An ogg_page
+ * \retval 1 The checksum stored in the page header is correct
+ * \retval 0 The checksum is incorrect, or \a og is not a valid page
+ */
+int oggz_page_checksum_verify (const ogg_page * og);
+
+/**
+ * A view of one packet, or the part of a packet, contained in a page.
+ * \a data points into the body of the page, so remains valid only as
+ * long as the page does.
+ */
+typedef struct {
+  /** The packet data within the page body */
+  unsigned char * data;
+
+  /** The number of bytes of packet data within the page */
+  long bytes;
+
+  /** The index in the page's segment table of the first lacing value of
+   * this packet */
+  int segment;
+
+  /** The number of lacing values of this packet in the page */
+  int segments;
+
+  /** Non-zero if the packet began on an earlier page */
+  int continued;
+
+  /** Non-zero if the packet ends on this page; otherwise it continues
+   * on the next page */
+  int complete;
+} OggzPagePacket;
+
+/**
+ * An iterator over the packets contained in a page.
+ */
+typedef struct {
+  const ogg_page * og;
+  int segment;
+  long offset;
+} OggzPagePackets;
+
+/**
+ * Begin iterating over the packets contained in a page. The packets are
+ * found by walking the segment table of the page; no packet data is
+ * copied.
+ * \param iter An OggzPagePackets iterator
+ * \param og An ogg_page
+ * \retval 0 Success
+ * \retval OGGZ_ERR_INVALID \a og is not a valid page
+ */
+int oggz_page_packets_init (OggzPagePackets * iter, const ogg_page * og);
+
+/**
+ * Get the next packet of a page. The first packet given may be the end
+ * of a packet continued from an earlier page, and the last may continue
+ * on the next page; these are marked in the \a continued and
+ * \a complete fields of \a pp. Packets which span pages must be
+ * assembled by the caller, for example with ogg_stream_pagein().
+ * \param iter An OggzPagePackets iterator
+ * \param pp An OggzPagePacket to fill in
+ * \retval 1 \a pp holds the next packet
+ * \retval 0 There are no more packets in the page
+ * \retval OGGZ_ERR_INVALID The segment table runs past the end of the
+ * page body
+ */
+int oggz_page_packets_next (OggzPagePackets * iter, OggzPagePacket * pp);
+
+/**
+ * The kinds of change an OggzPageEdit can make to a page header.
+ */
+typedef enum {
+  /** Set the granulepos of the page to \a value */
+  OGGZ_PAGE_EDIT_GRANULEPOS,
+
+  /** Set the e_o_s flag of the page if \a value is non-zero, or clear
+   * it if \a value is zero */
+  OGGZ_PAGE_EDIT_EOS,
+
+  /** Overwrite \a length bytes of the page header, starting at
+   * \a header_offset, with \a data (as for oggz_page_patch_header()) */
+  OGGZ_PAGE_EDIT_BYTES
+} OggzPageEditType;
+
+/**
+ * A change to the header of the page at a given offset in a file.
+ */
+typedef struct {
+  /** The offset in the file of the first byte of the page */
+  oggz_off_t offset;
+
+  /** The kind of change */
+  OggzPageEditType type;
+
+  /** The new granulepos or e_o_s flag */
+  ogg_int64_t value;
+
+  /** For OGGZ_PAGE_EDIT_BYTES, the byte offset into the page header */
+  long header_offset;
+
+  /** For OGGZ_PAGE_EDIT_BYTES, the number of bytes of \a data to write */
+  long length;
+
+  /** For OGGZ_PAGE_EDIT_BYTES, the bytes to write */
+  unsigned char data[8];
+} OggzPageEdit;
+
+/**
+ * Apply changes to the headers of pages of an Ogg file, in place.
+ * Only the changed header bytes and the page checksums are written;
+ * page bodies are not read or copied. The page boundaries must already
+ * be known, for example from the offsets given by oggz_tell() in an
+ * OggzReadPage callback, or from oggz_scan_pages().
+ *
+ * Where the file can be memory-mapped, the edits are divided between
+ * \a nthreads threads by page offset, so that all the edits of any one
+ * page are made by the same thread, in the order given. Otherwise they
+ * are made one after another in the calling thread.
+ *
+ * \param filename The file to change
+ * \param edits The changes to make, in any order. Several edits may
+ * refer to the same page.
+ * \param nedits The number of elements of \a edits
+ * \param nthreads The number of threads to use
+ * \returns The number of edits made
+ * \retval OGGZ_ERR_INVALID An edit refers to an offset at which there
+ * is no complete page header and body, or is not valid for the page.
+ * Edits of other pages may have been made.
+ * \retval OGGZ_ERR_SYSTEM System error; check errno for details
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+long oggz_page_rewrite (const char * filename, const OggzPageEdit * edits,
+                        long nedits, int nthreads);
+
+#endif /* __OGGZ_PAGE_H__ */
@@ -185,6 +185,41 @@ long oggz_read_input (OGGZ * oggz, unsigned char * buf, long n);
 /** \}
  */
 
+/**
+ * Scan all the pages of a seekable input, using several threads.
+ * The input is split into byte ranges which are read and scanned in
+ * parallel. Each range is synchronised at its first page with a valid
+ * checksum, and checked against the end of the preceding range, so the
+ * pages found are the same as those of a sequential read. They are
+ * passed to \a read_page one at a time, in file order, from the calling
+ * thread; during the callback oggz_tell() gives the offset of the page.
+ *
+ * Unlike oggz_read(), no packets are assembled and no OggzReadPacket
+ * callbacks are called. New logical bitstreams are identified as they
+ * are found, and with OGGZ_AUTO their granulerate is set up from the
+ * bos page, so oggz_granulepos_to_time() can be used in \a read_page.
+ * The read position of \a oggz is not changed.
+ *
+ * \param oggz An OGGZ handle previously opened for reading
+ * \param nthreads The number of threads to use. Values less than 2, and
+ * inputs other than files opened with oggz_open() or oggz_open_stdio(),
+ * scan sequentially in the calling thread.
+ * \param read_page Your callback function, called for each page
+ * \param user_data Arbitrary data to pass to \a read_page
+ * \returns The number of pages passed to \a read_page
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_NOSEEK The input is not seekable
+ * \retval OGGZ_ERR_SYSTEM System error; check errno for details
+ * \retval OGGZ_ERR_STOP_OK Scanning was stopped by \a read_page
+ * returning OGGZ_STOP_OK
+ * \retval OGGZ_ERR_STOP_ERR Scanning was stopped by \a read_page
+ * returning OGGZ_STOP_ERR
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Out of memory
+ */
+long oggz_scan_pages (OGGZ * oggz, int nthreads, OggzReadPage read_page,
+                      void * user_data);
+
 /**
  * Erase any input buffered in Oggz. This discards any input read from the
  * underlying IO system but not yet delivered as ogg_packets.
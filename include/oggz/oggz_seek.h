@@ -108,6 +108,41 @@ ogg_int64_t oggz_tell_units (OGGZ * oggz);
  */
 ogg_int64_t oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence);
 
+/**
+ * Seek to the keyframe needed to decode from an offset in milliseconds,
+ * or custom units as specified by a Metric function you have provided.
+ * This performs a double seek: first to the page before \a units, then
+ * back to the keyframe in effect at that point in each logical bitstream
+ * with a granuleshift (eg. Theora, Dirac). The reader is positioned at the
+ * earliest of these, so that the next packet read from each such
+ * bitstream is its keyframe, or a packet preceding it.
+ * \param oggz An OGGZ handle
+ * \param units A number of milliseconds, or custom units
+ * \param reads Return location for the number of reads made while
+ * seeking, or NULL
+ * \returns the unit position of the earliest keyframe, or -1 on failure.
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \note The granuleshift of each bitstream is known for streams identified
+ * by OGGZ_AUTO, and can otherwise be set with oggz_set_granuleshift().
+ */
+ogg_int64_t oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t units, long * reads);
+
+/**
+ * Query the duration of the bitstream, in milliseconds or custom units as
+ * specified by a Metric function you have provided. This is the unit
+ * position of the last page in the file on which a packet finishes.
+ * The result is remembered, and the end of the file is only searched
+ * again if the input has changed size.
+ * \param oggz An OGGZ handle
+ * \returns the duration in units
+ * \retval -1 No metric is defined, or the end of the input could not be
+ * determined (eg. the input is not seekable)
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+ogg_int64_t oggz_get_duration (OGGZ * oggz);
+
 /**
  * Provide the exact stored granulepos (from the page header) if relevant to
  * the current packet, or a constructed granulepos if the stored granulepos
@@ -142,9 +177,36 @@ oggz_off_t oggz_tell (OGGZ * oggz);
  */
 oggz_off_t oggz_seek (OGGZ * oggz, oggz_off_t offset, int whence);
 
-#ifdef _UNIMPLEMENTED
+/**
+ * Seek to a specific packet of a logical bitstream, such that the next
+ * packet of \a serialno delivered by oggz_read() is that packet. Packets
+ * are numbered from 0 for the bos packet, as in ogg_packet.packetno.
+ *
+ * Pages on which packets begin are indexed as they are read, and when
+ * seeking beyond the pages read, by walking forward over the page
+ * headers which follow. Seeking within the index requires no further
+ * reads to locate the packet, and seeking a short distance ahead of
+ * the current position requires no I/O at all: earlier packets of
+ * \a serialno are skipped as reading continues.
+ *
+ * \param oggz An OGGZ handle
+ * \param serialno The logical bitstream to seek in
+ * \param packets A packet number or offset
+ * \param whence SEEK_SET: \a packets is a packet number;
+ *               SEEK_CUR: \a packets is relative to the next packet to
+ *               be read; SEEK_END: \a packets is relative to the end of
+ *               the logical bitstream, such that -1 is its last packet
+ * \returns the number of the packet sought
+ * \retval -1 No such packet, or the current packet is unknown (SEEK_CUR
+ *            after seeking by other means)
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \retval OGGZ_ERR_BAD_SERIALNO \a serialno does not identify an existing
+ *                               logical bitstream in \a oggz
+ * \note Other logical bitstreams are read from the start of the page on
+ * which the packet sought begins, as for other seeks.
+ */
 long oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence);
-#endif
 
 /** \}
  */
@@ -340,6 +402,50 @@ int oggz_set_granulerate (OGGZ * oggz, long serialno,
 			  ogg_int64_t granule_rate_numerator,
 			  ogg_int64_t granule_rate_denominator);
 
+/**
+ * Convert a granulepos of a logical bitstream to a time in nanoseconds.
+ * This uses the granulerate and granuleshift of the bitstream, as set
+ * automatically by OGGZ_AUTO or by oggz_set_granulerate() and
+ * oggz_set_granuleshift(), and is exact where the millisecond units
+ * returned by oggz_tell_units() would be rounded. The conversion does
+ * not overflow for any granulepos whose time fits in 64 bits.
+ * For bitstreams with a custom metric set with oggz_set_metric(), the
+ * units returned by the metric are taken to be milliseconds.
+ * \param oggz An OGGZ handle
+ * \param serialno Identify the logical bitstream in \a oggz
+ * \param granulepos A granulepos within that logical bitstream
+ * \returns The time in nanoseconds
+ * \retval -1 \a granulepos is -1, or no metric is set for the bitstream
+ * \retval OGGZ_ERR_BAD_SERIALNO \a serialno does not identify an existing
+ * logical bitstream in \a oggz.
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ */
+ogg_int64_t oggz_granulepos_to_time (OGGZ * oggz, long serialno,
+				     ogg_int64_t granulepos);
+
+/**
+ * Convert an array of granuleposes of a logical bitstream to times in
+ * nanoseconds. Each element of \a out is set as oggz_granulepos_to_time()
+ * would return for the corresponding element of \a in, but the
+ * bitstream is looked up only once, and for the built-in granulerate
+ * and granuleshift mappings the conversion is done a block at a time
+ * without calling the metric.
+ * \param oggz An OGGZ handle
+ * \param serialno Identify the logical bitstream in \a oggz
+ * \param in An array of \a n granuleposes
+ * \param out An array of \a n values to receive the times. This may be
+ * the same array as \a in.
+ * \param n The number of granuleposes to convert
+ * \returns 0 Success
+ * \retval OGGZ_ERR_BAD_SERIALNO \a serialno does not identify an existing
+ * logical bitstream in \a oggz.
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID \a n is negative, or \a in or \a out is NULL
+ */
+int oggz_granulepos_to_time_batch (OGGZ * oggz, long serialno,
+				   const ogg_int64_t * in, ogg_int64_t * out,
+				   long n);
+
 /**
  * This is the signature of a function to correlate Ogg streams.
  * If every position in an Ogg stream can be described by a metric (eg. time)
@@ -385,12 +491,11 @@ typedef ogg_int64_t (*OggzMetric) (OGGZ * oggz, long serialno,
 int oggz_set_metric (OGGZ * oggz, long serialno, OggzMetric metric,
 		     void * user_data);
 
-#ifdef _UNIMPLEMENTED
 /** \defgroup order OggzOrder
  *
  * - A mechanism to aid seeking across non-metric spaces for which a partial
  *   order exists (ie. data that is not synchronised by a measure such as time,
- *   but is nevertheless somehow seekably structured), is also planned.
+ *   but is nevertheless somehow seekably structured), is also provided.
  *
  * \subsection OggzOrder
  *
@@ -454,10 +559,27 @@ typedef int (*OggzOrder) (OGGZ * oggz, ogg_packet * op, void * target,
 int oggz_set_order (OGGZ * oggz, long serialno, OggzOrder order,
 		    void * user_data);
 
+/**
+ * Seek to the position represented by \a target, as ordered by the
+ * OggzOrder callbacks set with oggz_set_order().
+ *
+ * The input is bisected by byte offset, calling the OggzOrder of each
+ * probed page's stream on the first packet beginning on that page.
+ * Reading resumes from the start of the last page whose first packet
+ * occurs before \a target, so that the packets delivered include all
+ * of those at or after \a target.
+ *
+ * \param oggz An OGGZ handle
+ * \param target A user defined object, passed to the OggzOrder callbacks
+ * \returns The byte offset from which reading resumes
+ * \retval -1 No OggzOrder is set, or seeking failed
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ * \note Pages of streams with no OggzOrder, and packets for which the
+ * OggzOrder returns 2 (undefined), are passed over.
+ */
 long oggz_seek_byorder (OGGZ * oggz, void * target);
 
-#endif /* _UNIMPLEMENTED */
-
 /**
  * Tell Oggz to remember the given offset as the start of data.
  * This informs the seeking mechanism that when seeking back to unit 0,
@@ -0,0 +1,114 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_STATS_H__
+#define __OGGZ_STATS_H__
+
+/** \file
+ * Instrumentation counters
+ *
+ * Each OGGZ handle counts the work it does: calls into the IO layer,
+ * pages framed and written, bytes skipped while resynchronising, and the
+ * iterations of each seek. These counters are cheap enough to be kept
+ * at all times, and can be queried with oggz_get_stats() when a read or
+ * a seek turns out to be slow.
+ *
+ * Counting is compiled in unless liboggz was configured with
+ * --disable-stats.
+ */
+
+/**
+ * Counters kept by an OGGZ handle, from when it was opened.
+ */
+typedef struct {
+  /** Bytes read from the input */
+  ogg_int64_t bytes_read;
+
+  /** Bytes written to the output */
+  ogg_int64_t bytes_written;
+
+  /** Calls made to read the input, via stdio, pread() or an OggzIORead */
+  ogg_int64_t io_reads;
+
+  /** Calls made to write the output */
+  ogg_int64_t io_writes;
+
+  /** Calls made to seek the input or output */
+  ogg_int64_t io_seeks;
+
+  /** Pages framed from the input, including those probed while seeking */
+  ogg_int64_t pages_read;
+
+  /** Pages written to the output */
+  ogg_int64_t pages_written;
+
+  /** Bytes of the input skipped while resynchronising to a page boundary
+   *  when reading, eg. because of corrupt data */
+  ogg_int64_t bytes_skipped;
+
+  /** Packets held back when reading until a later granulepos allowed
+   *  their own granulepos to be calculated (OGGZ_AUTO only) */
+  ogg_int64_t packets_buffered;
+
+  /** Seeks by time, made by oggz_seek_units() and related functions */
+  ogg_int64_t seeks;
+
+  /** Bisection iterations made over all seeks */
+  ogg_int64_t seek_iterations;
+
+  /** Bisection iterations made by the most recent seek */
+  ogg_int64_t seek_iterations_last;
+
+  /** Reads made by seeks to probe for pages */
+  ogg_int64_t seek_reads;
+
+  /** Allocations made for streams, and for each packet buffered when
+   *  reading or queued when writing */
+  ogg_int64_t allocs;
+
+  /** Pages currently held in the packet indexes of all streams, which
+   *  oggz_seek_packets() uses; each stream's index is bounded */
+  ogg_int64_t index_entries;
+} OggzStats;
+
+/**
+ * Retrieve the counters of an OGGZ handle.
+ * \param oggz An OGGZ handle
+ * \param stats Location to copy the counters to
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID \a stats is NULL
+ * \retval OGGZ_ERR_DISABLED Counting was disabled when liboggz was built
+ */
+int oggz_get_stats (OGGZ * oggz, OggzStats * stats);
+
+#endif /* __OGGZ_STATS_H__ */
@@ -42,8 +42,8 @@
  * Force feeding involves synchronously:
  * - Creating an \a ogg_packet structure
  * - Adding it to the packet queue with oggz_write_feed()
- * - Calling oggz_write() or oggz_write_output(), repeatedly as necessary,
- *   to generate the Ogg bitstream.
+ * - Calling oggz_write(), oggz_write_output() or oggz_write_next_page(),
+ *   repeatedly as necessary, to generate the Ogg bitstream.
  *
  * This process is illustrated in the following diagram:
  *
@@ -66,8 +66,14 @@
  * - Add it to the packet queue with oggz_write_feed()
  *
  * Once you have set such a callback with oggz_write_set_hungry_callback(),
- * simply call oggz_write() or oggz_write_output() repeatedly, and Oggz
- * will call your callback to provide packets when it is hungry.
+ * simply call oggz_write(), oggz_write_output() or oggz_write_next_page()
+ * repeatedly, and Oggz will call your callback to provide packets when it
+ * is hungry. If the packet queue is limited with
+ * oggz_write_set_queue_limits(), the callback can ask how much to feed
+ * with oggz_write_get_queue_space().
+ *
+ * Streams set up with oggz_write_set_producer() can instead be fed from
+ * other threads, each into its own queue.
  *
  * This process is illustrated in the following diagram:
  *
@@ -178,6 +184,10 @@ int oggz_write_set_hungry_callback (OGGZ * oggz,
  * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
  * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
  * \retval OGGZ_ERR_OUT_OF_MEMORY Unable to allocate memory to queue packet
+ * \retval OGGZ_ERR_QUEUE_FULL Queueing the packet would exceed a limit set
+ *         with oggz_write_set_queue_limits(), or the queue of a stream
+ *         set up with oggz_write_set_producer() is full. The packet is
+ *         not queued, and may be fed again once pages have been output.
  *
  * \note If \a op->b_o_s is initialized to \a -1 before calling
  *       oggz_write_feed(), Oggz will fill it in with the appropriate
@@ -186,6 +196,81 @@ int oggz_write_set_hungry_callback (OGGZ * oggz,
 int oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 		     int * guard);
 
+/**
+ * Limit the size of \a oggz's packet queue, so that a writer whose
+ * output stalls runs in bounded memory. Once a limit is reached,
+ * oggz_write_feed() refuses further packets with OGGZ_ERR_QUEUE_FULL
+ * until pages have been output. A packet is always accepted into an
+ * empty queue, however large it is.
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param max_packets The maximum number of packets queued, or 0 for
+ * no limit
+ * \param max_bytes The maximum number of bytes of packet data queued,
+ * or 0 for no limit
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, or
+ * a negative limit
+ */
+int oggz_write_set_queue_limits (OGGZ * oggz, long max_packets,
+                                 long max_bytes);
+
+/**
+ * Query how much more \a oggz's packet queue will accept before
+ * reaching the limits set with oggz_write_set_queue_limits(). An
+ * OggzWriteHungry callback can use this as a hint of how much to feed.
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param packets Return location for the number of packets which may
+ * be queued, or -1 if there is no limit; may be NULL
+ * \param bytes Return location for the number of bytes of packet data
+ * which may be queued, or -1 if there is no limit; may be NULL
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ
+ */
+int oggz_write_get_queue_space (OGGZ * oggz, long * packets, long * bytes);
+
+/**
+ * Give the stream \a serialno its own packet queue, so that its packets
+ * can be fed from another thread while the writing thread calls
+ * oggz_write(), oggz_write_output() or oggz_write_next_page().
+ * Packets are exchanged without locking: the queue is a lock-free ring
+ * with one producer, the thread which calls oggz_write_feed() for
+ * \a serialno, and one consumer, the writing thread.
+ *
+ * Set up every producer stream before any packets are fed. While
+ * producers are feeding, each thread may feed only its own stream, and
+ * no other streams may be added. When the queue is full
+ * oggz_write_feed() fails with OGGZ_ERR_QUEUE_FULL, and the producer
+ * can try again once the writing thread has caught up.
+ *
+ * The writing thread takes packets first from the ordinary packet
+ * queue, then from each producer in turn; to interleave the streams by
+ * time, open \a oggz with OGGZ_SORT. Guards given to oggz_write_feed()
+ * are set by the writing thread. The limits of
+ * oggz_write_set_queue_limits() do not apply to producer queues.
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param serialno The serialno of a stream to which no packets have
+ * been fed
+ * \param max_packets The number of packets the queue holds, rounded up
+ * to a power of two
+ * \retval 0 Success
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, \a
+ * max_packets is not positive, or \a serialno is already a producer or
+ * has been fed
+ * \retval OGGZ_ERR_BAD_SERIALNO \a serialno is not valid for a stream
+ * \retval OGGZ_ERR_BOS Another stream has already been written past its
+ * headers
+ * \retval OGGZ_ERR_OUT_OF_MEMORY Unable to allocate the queue
+ * \retval OGGZ_ERR_DISABLED Lock-free queues are not supported by this
+ * build
+ */
+int oggz_write_set_producer (OGGZ * oggz, long serialno, long max_packets);
+
 /**
  * Output data from an OGGZ handle. Oggz will call your write callback
  * as needed.
@@ -206,6 +291,34 @@ int oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
  */
 long oggz_write_output (OGGZ * oggz, unsigned char * buf, long n);
 
+/**
+ * Output the next whole page from an OGGZ handle, without copying it.
+ * This suits transports which carry one page per datagram or chunk,
+ * such as RTP or HTTP chunked encoding. Packets are taken from the
+ * packet queue, calling your OggzHungry callback as needed, exactly
+ * as for oggz_write_output().
+ *
+ * \param oggz An OGGZ handle previously opened for writing
+ * \param og Return location for the page. The page and the data it
+ * points to belong to \a oggz, and remain valid until the next call
+ * to oggz_write_next_page(), oggz_write_output() or oggz_write(), or
+ * until \a oggz is closed.
+ * \retval "> 0" The number of bytes in the page, ie. its
+ * \a header_len plus \a body_len
+ * \retval 0 End of stream
+ * \retval OGGZ_ERR_RECURSIVE_WRITE Attempt to initiate writing from
+ * within an OggzHungry callback
+ * \retval OGGZ_ERR_BAD_OGGZ \a oggz does not refer to an existing OGGZ
+ * \retval OGGZ_ERR_INVALID Operation not suitable for this OGGZ, or
+ * part of the current page has already been output by
+ * oggz_write_output() or oggz_write()
+ * \retval OGGZ_ERR_STOP_OK Writing was stopped by an OggzHungry callback
+ * returning OGGZ_STOP_OK
+ * \retval OGGZ_ERR_STOP_ERR Writing was stopped by an OggzHungry callback
+ * returning OGGZ_STOP_ERR
+ */
+long oggz_write_next_page (OGGZ * oggz, const ogg_page ** og);
+
 /**
  * Write n bytes from an OGGZ handle. Oggz will call your write callback
  * as needed.
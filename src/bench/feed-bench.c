@@ -0,0 +1,274 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * feed-bench: throughput of feeding one writer from several threads.
+ *
+ * Each producer thread feeds packets for its own stream while the main
+ * thread writes the pages out. In the "mutex" method every call into
+ * the writer is serialized on one lock; in the "producers" method each
+ * stream is set up with oggz_write_set_producer() and fed without
+ * locking. The number of producers doubles up to the given maximum.
+ *
+ * Results are printed one per line as key=value pairs, eg.
+ *   method=producers producers=4 packets=800000 seconds=0.52 ...
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#endif
+
+#include "oggz/oggz.h"
+
+#define FAIL(str) \
+  { printf ("%s:%d: %s\n", __FILE__, __LINE__, (str)); exit(1); }
+
+#define DEFAULT_PACKETS 200000
+#define DEFAULT_PRODUCERS 4
+#define MAX_PRODUCERS 64
+
+/* Packets queued per producer before feeding backs off */
+#define QUEUE_PACKETS 64
+
+#define BLOCKSIZE 65536
+
+#ifdef HAVE_PTHREAD
+
+typedef struct {
+  OGGZ * oggz;
+  long serialno;
+} BenchProducer;
+
+static pthread_mutex_t oggz_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int use_mutex = 0;
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int nr_done = 0;
+
+static long nr_packets = DEFAULT_PACKETS;
+
+static double
+bench_now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int
+bench_feed (OGGZ * oggz, ogg_packet * op, long serialno)
+{
+  int ret;
+
+  if (use_mutex) pthread_mutex_lock (&oggz_mutex);
+  ret = oggz_write_feed (oggz, op, serialno, 0, NULL);
+  if (use_mutex) pthread_mutex_unlock (&oggz_mutex);
+
+  return ret;
+}
+
+static void *
+producer_run (void * arg)
+{
+  BenchProducer * producer = (BenchProducer *)arg;
+  unsigned char buf[256];
+  ogg_packet op;
+  long i;
+  int ret;
+
+  memset (buf, 0, sizeof (buf));
+
+  /* The bos packet has already been fed */
+  for (i = 1; i <= nr_packets; i++) {
+    op.packet = buf;
+    op.bytes = 100 + (i * 37) % 150;
+    op.b_o_s = 0;
+    op.e_o_s = (i == nr_packets);
+    op.granulepos = i;
+    op.packetno = i;
+
+    while ((ret = bench_feed (producer->oggz, &op, producer->serialno))
+           == OGGZ_ERR_QUEUE_FULL)
+      sched_yield ();
+
+    if (ret != 0) FAIL ("Oggz write failed");
+  }
+
+  pthread_mutex_lock (&done_mutex);
+  nr_done++;
+  pthread_mutex_unlock (&done_mutex);
+
+  return NULL;
+}
+
+static int
+producers_done (int nr_producers)
+{
+  int done;
+
+  pthread_mutex_lock (&done_mutex);
+  done = (nr_done == nr_producers);
+  pthread_mutex_unlock (&done_mutex);
+
+  return done;
+}
+
+static void
+bench_run (const char * method, int nr_producers)
+{
+  static unsigned char block[BLOCKSIZE];
+  BenchProducer producers[MAX_PRODUCERS];
+  pthread_t threads[MAX_PRODUCERS];
+  OGGZ * writer;
+  ogg_packet op;
+  unsigned char bos = 0;
+  double start, seconds;
+  long n, bytes = 0;
+  int i, empty = 0;
+
+  use_mutex = !strcmp (method, "mutex");
+  nr_done = 0;
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  if (use_mutex) {
+    oggz_write_set_queue_limits (writer, QUEUE_PACKETS * nr_producers, 0);
+  }
+
+  for (i = 0; i < nr_producers; i++) {
+    producers[i].oggz = writer;
+    producers[i].serialno = 1000 + i;
+
+    if (!use_mutex &&
+        oggz_write_set_producer (writer, producers[i].serialno,
+                                 QUEUE_PACKETS) != 0)
+      FAIL ("Could not set producer");
+
+    /* Start every stream before any data is written */
+    op.packet = &bos;
+    op.bytes = 1;
+    op.b_o_s = 1;
+    op.e_o_s = 0;
+    op.granulepos = 0;
+    op.packetno = 0;
+    if (oggz_write_feed (writer, &op, producers[i].serialno, 0, NULL) != 0)
+      FAIL ("Oggz write failed");
+  }
+
+  start = bench_now ();
+
+  for (i = 0; i < nr_producers; i++) {
+    if (pthread_create (&threads[i], NULL, producer_run, &producers[i]) != 0)
+      FAIL ("Could not create producer thread");
+  }
+
+  while (empty < 2) {
+    if (use_mutex) pthread_mutex_lock (&oggz_mutex);
+    n = oggz_write_output (writer, block, BLOCKSIZE);
+    if (use_mutex) pthread_mutex_unlock (&oggz_mutex);
+
+    if (n > 0) {
+      bytes += n;
+      empty = 0;
+    } else if (n < 0) {
+      FAIL ("Oggz write output failed");
+    } else if (producers_done (nr_producers)) {
+      empty++;
+    } else {
+      sched_yield ();
+    }
+  }
+
+  for (i = 0; i < nr_producers; i++)
+    pthread_join (threads[i], NULL);
+
+  seconds = bench_now () - start;
+
+  oggz_close (writer);
+
+  printf ("method=%s producers=%d packets=%ld bytes=%ld seconds=%.3f "
+          "packets/s=%.0f\n", method, nr_producers,
+          nr_packets * nr_producers, bytes, seconds,
+          seconds > 0.0 ? nr_packets * nr_producers / seconds : 0.0);
+}
+
+int
+main (int argc, char * argv[])
+{
+  long max_producers = DEFAULT_PRODUCERS;
+  OGGZ * oggz;
+  int p, ret;
+
+  if (argc > 1) nr_packets = atol (argv[1]);
+  if (argc > 2) max_producers = atol (argv[2]);
+  if (nr_packets <= 0 || max_producers <= 0 ||
+      max_producers > MAX_PRODUCERS) {
+    printf ("usage: %s [packets per producer] [max producers]\n", argv[0]);
+    exit (1);
+  }
+
+  /* Check that producers are supported by this build */
+  if ((oggz = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+  ret = oggz_write_set_producer (oggz, 1, 1);
+  oggz_close (oggz);
+
+  for (p = 1; p <= max_producers; p *= 2) {
+    bench_run ("mutex", p);
+    if (ret == 0) bench_run ("producers", p);
+  }
+
+  if (ret != 0) printf ("# producers not supported by this build\n");
+
+  exit (0);
+}
+
+#else /* HAVE_PTHREAD */
+
+int
+main (int argc, char * argv[])
+{
+  printf ("# feed-bench requires POSIX threads\n");
+  exit (0);
+}
+
+#endif /* HAVE_PTHREAD */
@@ -0,0 +1,816 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz-bench: throughput of liboggz reading, writing and seeking.
+ *
+ * Synthetic Ogg files are generated in memory for a number of layouts,
+ * and the write, read, read_pages, seek_units, seek_relative and
+ * seek_packets workloads are timed over them. The read workload assembles
+ * packets; read_pages installs only a page callback, as page-level tools
+ * such as oggz-rip do. seek_units seeks to random times; seek_relative
+ * steps a short way ahead with SEEK_CUR, as a player skipping forward does.
+ * seek_packets seeks to random packet numbers with oggz_seek_packets(),
+ * each followed by a few SEEK_CUR steps. The files and the seek targets
+ * depend only on a fixed seed, so results are comparable across runs and
+ * across versions of liboggz.
+ *
+ * Results are printed one per line as key=value pairs, eg.
+ *   layout=theora workload=read bytes=16777216 ops=1562 seconds=0.01 ...
+ * Lines beginning with '#' are comments.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_INTTYPES_H
+#  include <inttypes.h>
+#else
+#  define PRId64 "I64d"
+#endif
+
+#include "oggz/oggz.h"
+
+#define DEFAULT_MBYTES 16
+#define DEFAULT_REPEATS 3
+#define NR_SEEKS 200
+
+/* Size of each block passed in and out by the application */
+#define BLOCKSIZE 65536
+
+#define MAX_TRACKS 16
+
+#undef MIN
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+typedef enum {
+  BENCH_AUDIO, /* Vorbis-like: linear granulepos, small packets */
+  BENCH_VIDEO  /* Theora-like: granuleshift, large keyframes */
+} BenchKind;
+
+typedef struct {
+  BenchKind kind;
+  long serialno;
+  ogg_int64_t rate_n;
+  ogg_int64_t rate_d;
+  int granuleshift;
+  ogg_int64_t packetno;
+  ogg_int64_t granule; /* granules, or frames, written */
+  ogg_int64_t keyframe;
+  ogg_int64_t granulepos; /* of the last packet written */
+  ogg_int64_t time_ms; /* presentation time of the next packet */
+} BenchTrack;
+
+typedef struct {
+  const char * name;
+  const char * description;
+  int naudio;
+  int nvideo;
+  int nchains;
+} BenchLayout;
+
+static const BenchLayout layouts[] = {
+  {"vorbis", "one Vorbis-like track", 1, 0, 1},
+  {"theora", "Theora-like and Vorbis-like tracks", 1, 1, 1},
+  {"many", "16 Vorbis-like tracks", MAX_TRACKS, 0, 1},
+  {"chained", "4 chained links of Theora-like and Vorbis-like tracks",
+   1, 1, 4},
+  {NULL, NULL, 0, 0, 0}
+};
+
+#define AUDIO_RATE 44100
+#define AUDIO_GRANULES 1024 /* per packet */
+#define VIDEO_FPS 25
+#define VIDEO_SHIFT 6
+#define VIDEO_KEY_INTERVAL 32
+
+typedef struct {
+  const BenchLayout * layout;
+
+  unsigned char * data;
+  long data_len;
+  long data_size;
+
+  /* Tracks of all links; the tracks of link i follow those of link i-1 */
+  BenchTrack tracks[MAX_TRACKS * 4];
+  int ntracks;
+
+  long packets;
+} BenchFile;
+
+static int repeats = DEFAULT_REPEATS;
+
+/* A fixed pseudo-random sequence, independent of the C library */
+static unsigned long bench_seed;
+
+static unsigned long
+bench_rand (void)
+{
+  bench_seed = bench_seed * 1103515245UL + 12345UL;
+  return (bench_seed >> 16) & 0x7fff;
+}
+
+static long
+bench_rand_range (long min, long max)
+{
+  return min + (long)((bench_rand () << 15 | bench_rand ()) % (max - min + 1));
+}
+
+static void
+bench_fail (const char * str)
+{
+  fprintf (stderr, "oggz-bench: %s\n", str);
+  exit (1);
+}
+
+static double
+bench_seconds (clock_t start)
+{
+  return (double)(clock () - start) / CLOCKS_PER_SEC;
+}
+
+/*
+ * Print a result. Throughput in MB/s is given for workloads which pass
+ * over the whole file.
+ */
+static void
+bench_report (BenchFile * file, const char * workload, long ops,
+              double seconds, const char * unit, int whole_file,
+              const char * extra)
+{
+  double rate = seconds > 0.0 ? ops / seconds : 0.0;
+  double mbps = seconds > 0.0 ?
+    file->data_len / seconds / (1024.0 * 1024.0) : 0.0;
+
+  printf ("layout=%s workload=%s bytes=%ld ops=%ld seconds=%.6f "
+          "rate=%.1f unit=%s", file->layout->name, workload, file->data_len,
+          ops, seconds, rate, unit);
+  if (whole_file) printf (" mbps=%.2f", mbps);
+  if (extra) printf (" %s", extra);
+  printf ("\n");
+}
+
+/******** Generation, and the write workload ********/
+
+static void
+track_init (BenchTrack * track, BenchKind kind, long serialno)
+{
+  memset (track, 0, sizeof (BenchTrack));
+
+  track->kind = kind;
+  track->serialno = serialno;
+
+  /* Granules per millisecond, so that units are milliseconds */
+  if (kind == BENCH_AUDIO) {
+    track->rate_n = AUDIO_RATE;
+    track->rate_d = 1000;
+  } else {
+    track->rate_n = VIDEO_FPS;
+    track->rate_d = 1000;
+    track->granuleshift = VIDEO_SHIFT;
+  }
+}
+
+/*
+ * Fill in the next packet of a track. The first packet of a link starts
+ * its track; later links continue the granulepos of earlier ones, so
+ * that seeking by time is meaningful throughout the file.
+ */
+static void
+track_packet (BenchTrack * track, ogg_packet * op, unsigned char * buf,
+              ogg_int64_t granule_base)
+{
+  ogg_int64_t frame;
+
+  op->packet = buf;
+  op->b_o_s = (track->packetno == 0);
+  op->e_o_s = 0;
+  op->packetno = track->packetno++;
+
+  if (op->b_o_s) {
+    op->bytes = 64;
+    op->granulepos = 0;
+    buf[0] = (track->kind == BENCH_AUDIO) ? 0x01 : 0x80;
+    return;
+  }
+
+  if (track->kind == BENCH_AUDIO) {
+    op->bytes = bench_rand_range (150, 450);
+    track->granule += AUDIO_GRANULES;
+    op->granulepos = granule_base + track->granule;
+    track->time_ms = (granule_base + track->granule) * 1000 / AUDIO_RATE;
+  } else {
+    frame = granule_base + track->granule;
+    if (track->granule % VIDEO_KEY_INTERVAL == 0) {
+      track->keyframe = frame;
+      op->bytes = bench_rand_range (12000, 20000);
+    } else {
+      op->bytes = bench_rand_range (800, 3000);
+    }
+    op->granulepos = (track->keyframe << VIDEO_SHIFT) |
+      (frame - track->keyframe);
+    track->granule++;
+    track->time_ms = (frame + 1) * 1000 / VIDEO_FPS;
+  }
+
+  track->granulepos = op->granulepos;
+  buf[0] = (unsigned char)(op->packetno & 0xff);
+}
+
+static void
+bench_output (OGGZ * writer, BenchFile * file)
+{
+  long n;
+
+  for (;;) {
+    if (file->data_size - file->data_len < BLOCKSIZE) {
+      file->data_size *= 2;
+      file->data = realloc (file->data, file->data_size);
+      if (file->data == NULL) bench_fail ("Out of memory");
+    }
+
+    n = oggz_write_output (writer, file->data + file->data_len, BLOCKSIZE);
+    if (n <= 0) break;
+    file->data_len += n;
+  }
+}
+
+/*
+ * Write a file of the given layout, and return the time taken. Packets
+ * of each link are interleaved in presentation time order, as a muxer
+ * would, until the link has its share of the target size.
+ */
+static double
+bench_generate (BenchFile * file, const BenchLayout * layout, long target)
+{
+  static unsigned char buf[20000];
+  OGGZ * writer;
+  BenchTrack * track, * next;
+  ogg_packet op;
+  ogg_int64_t audio_base = 0, video_base = 0;
+  long link_target;
+  clock_t start;
+  int flags, link, i, first;
+
+  memset (file, 0, sizeof (BenchFile));
+  file->layout = layout;
+  file->data_size = target + 1024 * 1024;
+  if ((file->data = malloc (file->data_size)) == NULL)
+    bench_fail ("Out of memory");
+
+  memset (buf, 'x', sizeof (buf));
+  bench_seed = 1;
+
+  start = clock ();
+
+  /* Strict checking refuses the bos pages of links after the first */
+  flags = OGGZ_WRITE | (layout->nchains > 1 ? OGGZ_NONSTRICT : 0);
+  if ((writer = oggz_new (flags)) == NULL)
+    bench_fail ("Could not create writer");
+
+  for (link = 0; link < layout->nchains; link++) {
+    first = file->ntracks;
+
+    for (i = 0; i < layout->nvideo; i++)
+      track_init (&file->tracks[file->ntracks++], BENCH_VIDEO,
+                  oggz_serialno_new (writer));
+    for (i = 0; i < layout->naudio; i++)
+      track_init (&file->tracks[file->ntracks++], BENCH_AUDIO,
+                  oggz_serialno_new (writer));
+
+    /* All bos pages of a link come first */
+    for (i = first; i < file->ntracks; i++) {
+      track = &file->tracks[i];
+      track_packet (track, &op, buf, 0);
+      if (oggz_write_feed (writer, &op, track->serialno, OGGZ_FLUSH_AFTER,
+                           NULL) != 0)
+        bench_fail ("Write failed");
+    }
+
+    link_target = (link + 1) * (target / layout->nchains);
+
+    while (file->data_len < link_target) {
+      next = NULL;
+      for (i = first; i < file->ntracks; i++) {
+        track = &file->tracks[i];
+        if (next == NULL || track->time_ms < next->time_ms) next = track;
+      }
+
+      track_packet (next, &op, buf, next->kind == BENCH_AUDIO ?
+                    audio_base : video_base);
+      if (oggz_write_feed (writer, &op, next->serialno, 0, NULL) != 0)
+        bench_fail ("Write failed");
+      file->packets++;
+
+      bench_output (writer, file);
+    }
+
+    /* End the link with an empty eos packet on each track, so that its
+     * last page keeps the granulepos of the last packet */
+    for (i = first; i < file->ntracks; i++) {
+      track = &file->tracks[i];
+      op.packet = buf;
+      op.bytes = 0;
+      op.b_o_s = 0;
+      op.e_o_s = 1;
+      op.granulepos = track->granulepos;
+      op.packetno = track->packetno++;
+      if (oggz_write_feed (writer, &op, track->serialno, 0, NULL) != 0)
+        bench_fail ("Write failed");
+
+      if (track->kind == BENCH_AUDIO)
+        audio_base += track->granule;
+      else
+        video_base += track->granule;
+    }
+
+    bench_output (writer, file);
+  }
+
+  oggz_close (writer);
+
+  return bench_seconds (start);
+}
+
+static void
+bench_write (BenchFile * file, const BenchLayout * layout, long target)
+{
+  double seconds, best = -1.0;
+  int i;
+
+  for (i = 0; i < repeats; i++) {
+    if (i > 0) free (file->data);
+    seconds = bench_generate (file, layout, target);
+    if (best < 0.0 || seconds < best) best = seconds;
+  }
+
+  bench_report (file, "write", file->packets, best, "packets/s", 1, NULL);
+}
+
+/******** Reading ********/
+
+static int
+bench_track_index (BenchFile * file, long serialno)
+{
+  int i;
+
+  for (i = 0; i < file->ntracks; i++)
+    if (file->tracks[i].serialno == serialno) return i;
+
+  return -1;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  BenchFile * file = (BenchFile *)user_data;
+  BenchTrack * track;
+  int i;
+
+  if (ogg_page_bos ((ogg_page *)og) &&
+      (i = bench_track_index (file, serialno)) != -1) {
+    track = &file->tracks[i];
+    oggz_set_granulerate (oggz, serialno, track->rate_n, track->rate_d);
+    oggz_set_granuleshift (oggz, serialno, track->granuleshift);
+  }
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+count_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  (*(long *)user_data)++;
+  return OGGZ_CONTINUE;
+}
+
+static int
+count_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  (*(long *)user_data)++;
+  return OGGZ_CONTINUE;
+}
+
+static void
+bench_read (BenchFile * file, int read_packets)
+{
+  OGGZ * reader;
+  char extra[128];
+  double seconds, best = -1.0;
+  long offset, bytes, pages = 0, packets = 0;
+  clock_t start;
+  int i;
+
+  for (i = 0; i < repeats; i++) {
+    start = clock ();
+
+    if ((reader = oggz_new (OGGZ_READ)) == NULL)
+      bench_fail ("Could not create reader");
+
+    pages = 0;
+    packets = 0;
+    oggz_set_read_page (reader, -1, count_page, &pages);
+    if (read_packets)
+      oggz_set_read_callback (reader, -1, count_packet, &packets);
+
+    for (offset = 0; offset < file->data_len; offset += bytes) {
+      bytes = MIN (BLOCKSIZE, file->data_len - offset);
+      oggz_read_input (reader, file->data + offset, bytes);
+    }
+
+    seconds = bench_seconds (start);
+    if (best < 0.0 || seconds < best) best = seconds;
+
+    oggz_close (reader);
+  }
+
+  if (read_packets) {
+    snprintf (extra, sizeof (extra), "packets=%ld", packets);
+    bench_report (file, "read", pages, best, "pages/s", 1, extra);
+  } else {
+    bench_report (file, "read_pages", pages, best, "pages/s", 1, NULL);
+  }
+}
+
+/******** Seeking ********/
+
+typedef struct {
+  BenchFile * file;
+  long offset;
+} BenchIO;
+
+static size_t
+bench_io_read (void * user_handle, void * buf, size_t n)
+{
+  BenchIO * io = (BenchIO *)user_handle;
+  long len;
+
+  len = MIN ((long)n, io->file->data_len - io->offset);
+  if (len < 0) len = 0;
+  memcpy (buf, io->file->data + io->offset, len);
+  io->offset += len;
+
+  return len;
+}
+
+static int
+bench_io_seek (void * user_handle, long offset, int whence)
+{
+  BenchIO * io = (BenchIO *)user_handle;
+
+  switch (whence) {
+  case SEEK_SET: io->offset = offset; break;
+  case SEEK_CUR: io->offset += offset; break;
+  case SEEK_END: io->offset = io->file->data_len + offset; break;
+  default: return -1;
+  }
+
+  return 0;
+}
+
+static long
+bench_io_tell (void * user_handle)
+{
+  return ((BenchIO *)user_handle)->offset;
+}
+
+/* Open a reader on a file, having read it through once to find its tracks */
+static OGGZ *
+bench_open_seekable (BenchFile * file, BenchIO * io)
+{
+  OGGZ * reader;
+  long packets = 0;
+
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    bench_fail ("Could not create reader");
+
+  io->file = file;
+  io->offset = 0;
+  oggz_io_set_read (reader, bench_io_read, io);
+  oggz_io_set_seek (reader, bench_io_seek, io);
+  oggz_io_set_tell (reader, bench_io_tell, io);
+
+  oggz_set_read_page (reader, -1, read_page, file);
+  oggz_set_read_callback (reader, -1, count_packet, &packets);
+
+  while (oggz_read (reader, BLOCKSIZE) > 0);
+
+  return reader;
+}
+
+static void
+bench_report_seeks (BenchFile * file, const char * workload, long seeks,
+                    double seconds, OggzStats * before, OggzStats * after)
+{
+  char extra[256];
+
+  snprintf (extra, sizeof (extra),
+            "us_per_seek=%.1f reads_per_seek=%.2f iterations_per_seek=%.2f "
+            "bytes_per_seek=%.0f",
+            seconds * 1000000.0 / seeks,
+            (double)(after->seek_reads - before->seek_reads) / seeks,
+            (double)(after->seek_iterations - before->seek_iterations) / seeks,
+            (double)(after->bytes_read - before->bytes_read) / seeks);
+
+  bench_report (file, workload, seeks, seconds, "seeks/s", 0, extra);
+}
+
+static void
+bench_seek_units (BenchFile * file)
+{
+  OGGZ * reader;
+  BenchIO io;
+  OggzStats before, after;
+  ogg_int64_t units, duration;
+  double seconds, best = -1.0;
+  clock_t start;
+  int i, j;
+
+  reader = bench_open_seekable (file, &io);
+
+  /* Seek within the time covered by the last page */
+  if ((duration = oggz_seek_units (reader, 0, SEEK_END)) == -1)
+    bench_fail ("Could not seek to end");
+
+  memset (&before, 0, sizeof (before));
+  memset (&after, 0, sizeof (after));
+
+  for (i = 0; i < repeats; i++) {
+    /* The same targets on each repeat */
+    bench_seed = 2;
+
+    oggz_get_stats (reader, &before);
+    start = clock ();
+
+    for (j = 0; j < NR_SEEKS; j++) {
+      units = bench_rand_range (0, (long)duration);
+      if (oggz_seek_units (reader, units, SEEK_SET) == -1)
+        bench_fail ("Seek failed");
+    }
+
+    seconds = bench_seconds (start);
+    oggz_get_stats (reader, &after);
+    if (best < 0.0 || seconds < best) best = seconds;
+  }
+
+  bench_report_seeks (file, "seek_units", NR_SEEKS, best, &before, &after);
+
+  oggz_close (reader);
+}
+
+/* Step ahead by this many milliseconds in the seek_relative workload */
+#define RELATIVE_STEP 500
+
+/*
+ * Time short relative seeks, as made by a player skipping ahead. Each
+ * SEEK_CUR is made from a random position; only the relative seeks are
+ * timed and counted.
+ */
+static void
+bench_seek_relative (BenchFile * file)
+{
+  OGGZ * reader;
+  BenchIO io;
+  OggzStats before, after, total;
+  ogg_int64_t units, duration;
+  double seconds, best = -1.0;
+  clock_t start;
+  int i, j;
+
+  reader = bench_open_seekable (file, &io);
+
+  if ((duration = oggz_seek_units (reader, 0, SEEK_END)) == -1)
+    bench_fail ("Could not seek to end");
+
+  for (i = 0; i < repeats; i++) {
+    /* The same positions on each repeat */
+    bench_seed = 3;
+
+    memset (&total, 0, sizeof (total));
+    seconds = 0.0;
+
+    for (j = 0; j < NR_SEEKS; j++) {
+      units = bench_rand_range (1000, (long)(duration - RELATIVE_STEP));
+      if (oggz_seek_units (reader, units, SEEK_SET) == -1)
+        bench_fail ("Seek failed");
+
+      oggz_get_stats (reader, &before);
+      start = clock ();
+
+      if (oggz_seek_units (reader, RELATIVE_STEP, SEEK_CUR) == -1)
+        bench_fail ("Relative seek failed");
+
+      seconds += bench_seconds (start);
+      oggz_get_stats (reader, &after);
+
+      total.seek_reads += after.seek_reads - before.seek_reads;
+      total.seek_iterations += after.seek_iterations - before.seek_iterations;
+      total.bytes_read += after.bytes_read - before.bytes_read;
+    }
+
+    if (best < 0.0 || seconds < best) best = seconds;
+  }
+
+  memset (&before, 0, sizeof (before));
+  bench_report_seeks (file, "seek_relative", NR_SEEKS, best, &before, &total);
+
+  oggz_close (reader);
+}
+
+/* Runs of the seek_packets workload: a SEEK_SET, then this many SEEK_CUR
+ * steps of PACKET_STEP packets */
+#define PACKET_STEPS 4
+#define PACKET_STEP 10
+
+static int
+stop_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  long * stop_serialno = (long *)user_data;
+
+  if (serialno != *stop_serialno) return OGGZ_CONTINUE;
+
+  *stop_serialno = -1;
+  return OGGZ_STOP_OK;
+}
+
+/* Read on to the next packet of a track */
+static void
+bench_read_packet (OGGZ * reader, long * stop_serialno, long serialno)
+{
+  long n;
+
+  *stop_serialno = serialno;
+
+  /* A stop is also reported by the read following it */
+  while (*stop_serialno != -1) {
+    n = oggz_read (reader, BLOCKSIZE);
+    if (n == 0 || (n < 0 && n != OGGZ_ERR_STOP_OK))
+      bench_fail ("Could not read the packet sought");
+  }
+}
+
+/*
+ * Time seeking by packet number on a random track of the file, as an
+ * editor stepping through packets does. Each run seeks to a random packet
+ * and then steps ahead a few times with SEEK_CUR; the packet sought is
+ * read after each seek.
+ */
+static void
+bench_seek_packets (BenchFile * file)
+{
+  OGGZ * reader;
+  BenchIO io;
+  BenchTrack * track;
+  OggzStats before, after;
+  long packetno, stop_serialno, seeks = 0;
+  double seconds, best = -1.0;
+  clock_t start;
+  int i, j, k;
+
+  reader = bench_open_seekable (file, &io);
+  oggz_set_read_callback (reader, -1, stop_packet, &stop_serialno);
+
+  memset (&before, 0, sizeof (before));
+  memset (&after, 0, sizeof (after));
+
+  for (i = 0; i < repeats; i++) {
+    /* The same targets on each repeat */
+    bench_seed = 4;
+    seeks = 0;
+
+    oggz_get_stats (reader, &before);
+    start = clock ();
+
+    for (j = 0; j < NR_SEEKS / (PACKET_STEPS + 1); j++) {
+      track = &file->tracks[bench_rand_range (0, file->ntracks - 1)];
+      packetno = bench_rand_range (0, (long)track->packetno - 1 -
+                                   PACKET_STEPS * (PACKET_STEP + 1));
+      if (oggz_seek_packets (reader, track->serialno, packetno,
+                             SEEK_SET) != packetno)
+        bench_fail ("Packet seek failed");
+      bench_read_packet (reader, &stop_serialno, track->serialno);
+      seeks++;
+
+      /* Step on from the packet after the one just read */
+      packetno++;
+      for (k = 0; k < PACKET_STEPS; k++) {
+        packetno += PACKET_STEP;
+        if (oggz_seek_packets (reader, track->serialno, PACKET_STEP,
+                               SEEK_CUR) != packetno)
+          bench_fail ("Relative packet seek failed");
+        bench_read_packet (reader, &stop_serialno, track->serialno);
+        seeks++;
+        packetno++;
+      }
+    }
+
+    seconds = bench_seconds (start);
+    oggz_get_stats (reader, &after);
+    if (best < 0.0 || seconds < best) best = seconds;
+  }
+
+  bench_report_seeks (file, "seek_packets", seeks, best, &before, &after);
+
+  oggz_close (reader);
+}
+
+static void
+usage (char * progname)
+{
+  const BenchLayout * layout;
+
+  printf ("Usage: %s [options] [layout ...]\n", progname);
+  printf ("Time liboggz reading, writing and seeking on generated files.\n");
+  printf ("\nOptions\n");
+  printf ("  -m mbytes  Size of each generated file (default %d)\n",
+          DEFAULT_MBYTES);
+  printf ("  -r repeats Report the fastest of this many runs (default %d)\n",
+          DEFAULT_REPEATS);
+  printf ("\nLayouts (default all)\n");
+  for (layout = layouts; layout->name; layout++)
+    printf ("  %-10s %s\n", layout->name, layout->description);
+}
+
+int
+main (int argc, char * argv[])
+{
+  const BenchLayout * layout;
+  BenchFile file;
+  long mbytes = DEFAULT_MBYTES;
+  int i, nnames = 0, selected;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp (argv[i], "-m") && i+1 < argc) {
+      mbytes = atol (argv[++i]);
+    } else if (!strcmp (argv[i], "-r") && i+1 < argc) {
+      repeats = atoi (argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage (argv[0]);
+      exit (1);
+    } else {
+      nnames++;
+    }
+  }
+
+  if (mbytes <= 0 || repeats <= 0) {
+    usage (argv[0]);
+    exit (1);
+  }
+
+  printf ("# oggz-bench liboggz %s mbytes=%ld repeats=%d seeks=%d\n",
+          VERSION, mbytes, repeats, NR_SEEKS);
+
+  for (layout = layouts; layout->name; layout++) {
+    selected = (nnames == 0);
+    for (i = 1; i < argc; i++) {
+      if (!strcmp (argv[i], "-m") || !strcmp (argv[i], "-r")) i++;
+      else if (!strcmp (argv[i], layout->name)) selected = 1;
+    }
+    if (!selected) continue;
+
+    bench_write (&file, layout, mbytes * 1024 * 1024);
+    bench_read (&file, 1);
+    bench_read (&file, 0);
+    bench_seek_units (&file);
+    bench_seek_relative (&file);
+    bench_seek_packets (&file);
+
+    free (file.data);
+    fflush (stdout);
+  }
+
+  exit (0);
+}
@@ -0,0 +1,219 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * sync-bench: compare page framing throughput of oggz_read_input()
+ * against the equivalent libogg ogg_sync/ogg_stream loop.
+ *
+ * Output is one line per method:
+ *   method bytes pages seconds MB/s
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "oggz/oggz.h"
+
+#define FAIL(str) \
+  { printf ("%s:%d: %s\n", __FILE__, __LINE__, (str)); exit(1); }
+
+#undef MIN
+#define MIN(a,b) ((a)<(b)?(a):(b))
+
+#define DEFAULT_MBYTES 32
+#define NR_ITERATIONS 4
+
+/* Size of each block passed in by the application */
+#define BLOCKSIZE 4096
+
+static unsigned char * data = NULL;
+static long data_len = 0;
+static long data_size = 0;
+
+static long serialno;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  static unsigned char buf[8192];
+  static ogg_int64_t packetno = 0;
+  ogg_packet op;
+  long target = *(long *)user_data;
+
+  if (data_len >= target) return 1;
+
+  op.packet = buf;
+  op.bytes = 100 + (rand () % (sizeof (buf) - 100));
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = 0;
+  op.granulepos = packetno;
+  op.packetno = packetno;
+
+  memset (buf, (int)(packetno & 0xff), op.bytes);
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  packetno++;
+
+  return 0;
+}
+
+static void
+generate (long target)
+{
+  OGGZ * writer;
+  long n;
+
+  data_size = target + 1024 * 1024;
+  if ((data = malloc (data_size)) == NULL)
+    FAIL ("Out of memory");
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+  oggz_write_set_hungry_callback (writer, hungry, 0, &target);
+
+  while (data_len < data_size &&
+         (n = oggz_write_output (writer, data + data_len,
+                                 MIN (BLOCKSIZE, data_size - data_len))) > 0) {
+    data_len += n;
+  }
+
+  oggz_close (writer);
+}
+
+static long
+run_libogg (void)
+{
+  ogg_sync_state oy;
+  ogg_stream_state os;
+  ogg_page og;
+  ogg_packet op;
+  char * buffer;
+  long offset, bytes, pages = 0;
+
+  ogg_sync_init (&oy);
+  ogg_stream_init (&os, serialno);
+
+  for (offset = 0; offset < data_len; offset += bytes) {
+    bytes = MIN (BLOCKSIZE, data_len - offset);
+    buffer = ogg_sync_buffer (&oy, bytes);
+    memcpy (buffer, data + offset, bytes);
+    ogg_sync_wrote (&oy, bytes);
+
+    while (ogg_sync_pageout (&oy, &og) == 1) {
+      pages++;
+      ogg_stream_pagein (&os, &og);
+      while (ogg_stream_packetout (&os, &op) == 1);
+    }
+  }
+
+  ogg_stream_clear (&os);
+  ogg_sync_clear (&oy);
+
+  return pages;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  (*(long *)user_data)++;
+  return OGGZ_CONTINUE;
+}
+
+static long
+run_oggz (int flags)
+{
+  OGGZ * reader;
+  long offset, bytes, pages = 0;
+
+  if ((reader = oggz_new (OGGZ_READ | flags)) == NULL)
+    FAIL ("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, &pages);
+
+  for (offset = 0; offset < data_len; offset += bytes) {
+    bytes = MIN (BLOCKSIZE, data_len - offset);
+    oggz_read_input (reader, data + offset, bytes);
+  }
+
+  oggz_close (reader);
+
+  return pages;
+}
+
+static void
+report (const char * method, long pages, clock_t elapsed)
+{
+  double seconds = (double)elapsed / CLOCKS_PER_SEC / NR_ITERATIONS;
+  double mbps = seconds > 0.0 ? data_len / seconds / (1024.0 * 1024.0) : 0.0;
+
+  printf ("%s %ld %ld %.6f %.2f\n", method, data_len, pages, seconds, mbps);
+}
+
+int
+main (int argc, char * argv[])
+{
+  long mbytes = DEFAULT_MBYTES, pages = 0;
+  clock_t start;
+  int i;
+
+  if (argc > 1) mbytes = atol (argv[1]);
+  if (mbytes <= 0) {
+    printf ("usage: %s [megabytes]\n", argv[0]);
+    exit (1);
+  }
+
+  generate (mbytes * 1024 * 1024);
+
+  start = clock ();
+  for (i = 0; i < NR_ITERATIONS; i++) pages = run_libogg ();
+  report ("libogg", pages, clock () - start);
+
+  start = clock ();
+  for (i = 0; i < NR_ITERATIONS; i++) pages = run_oggz (0);
+  report ("oggz", pages, clock () - start);
+
+  start = clock ();
+  for (i = 0; i < NR_ITERATIONS; i++) pages = run_oggz (OGGZ_NOCRC);
+  report ("oggz-nocrc", pages, clock () - start);
+
+  free (data);
+
+  exit (0);
+}
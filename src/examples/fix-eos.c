@@ -106,28 +106,32 @@ write_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
       ogg_page_checksum_set((ogg_page *)og);
     }
 
-    /* Now we want to discard any remaining partial packets at the end of this
-     * page. Unfortunately, neither libogg nor liboggz have helpful
-     * functions for this, so do it all in a manual way...
+    /* Now we want to discard any remaining partial packet at the end of
+     * this page.
      *
      * We need to do this because libogg (correctly) doesn't tag the last
      * complete packet on an EOS page with EOS if there's an incomplete
      * packet following it (so you get complaints from oggz-validate).
      */
     {
-      int i, segments, discard = 0;
+      OggzPagePackets iter;
+      OggzPagePacket pp;
+      int segments, keep_segments = 0;
+      long keep_bytes = 0;
+
       segments = og->header[26];
-      for(i=segments-1; i >= 0; i--) {
-        if(og->header[i+27] < 255)
-            break;
-        else
-            discard += 255;
+      oggz_page_packets_init (&iter, og);
+      while (oggz_page_packets_next (&iter, &pp) == 1) {
+        if (pp.complete) {
+          keep_segments = pp.segment + pp.segments;
+          keep_bytes = (pp.data - og->body) + pp.bytes;
+        }
       }
-      if(i != segments-1) {
-        fprintf(stderr, "Discarding %d useless segments of %d, retaining %d\n", segments-1-i, segments, i+1);
-        og->header[26] = i+1;
-        ((ogg_page *)og)->header_len -= segments-1-i;
-        ((ogg_page *)og)->body_len -= discard;
+      if(keep_segments != segments) {
+        fprintf(stderr, "Discarding %d useless segments of %d, retaining %d\n", segments-keep_segments, segments, keep_segments);
+        og->header[26] = keep_segments;
+        ((ogg_page *)og)->header_len -= segments-keep_segments;
+        ((ogg_page *)og)->body_len = keep_bytes;
         ogg_page_checksum_set((ogg_page *)og);
       }
     }
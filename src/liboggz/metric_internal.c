@@ -32,77 +32,215 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "oggz_private.h"
 
 #include "oggz/oggz_stream.h"
 
+#define OGGZ_INT64_MAX ((ogg_int64_t)((~(ogg_uint64_t)0) >> 1))
+
+/* High 64 bits of the 128-bit product a * b */
+static ogg_uint64_t
+oggz_mulhi64 (ogg_uint64_t a, ogg_uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+  return (ogg_uint64_t)(((unsigned __int128)a * b) >> 64);
+#else
+  ogg_uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+  ogg_uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+  ogg_uint64_t t, w;
+
+  t = a_hi * b_lo + ((a_lo * b_lo) >> 32);
+  w = (t & 0xffffffff) + a_lo * b_hi;
+
+  return a_hi * b_hi + (t >> 32) + (w >> 32);
+#endif
+}
+
 static ogg_int64_t
-oggz_metric_dirac (OGGZ * oggz, long serialno,
-                   ogg_int64_t granulepos, void * user_data)
+oggz_gcd (ogg_int64_t a, ogg_int64_t b)
 {
-  oggz_stream_t * stream;
-  ogg_int64_t iframe, pframe;
-  ogg_uint32_t pt;
-  ogg_uint16_t dist;
-  ogg_uint16_t delay;
-  ogg_int64_t dt;
-  ogg_int64_t units;
+  ogg_int64_t t;
 
-  stream = oggz_get_stream (oggz, serialno);
-  if (stream == NULL) return -1;
+  while (b != 0) {
+    t = a % b;
+    a = b;
+    b = t;
+  }
 
-  iframe = granulepos >> stream->granuleshift;
-  pframe = granulepos - (iframe << stream->granuleshift);
-  pt = (iframe + pframe) >> 9;
-  delay = pframe >> 9;
-  dt = (ogg_int64_t)pt - delay;
+  return a;
+}
 
-  units = dt * stream->granulerate_d / stream->granulerate_n;
+/*
+ * Set up scale to multiply by mult/div. Returns -1 if the ratio is not
+ * usable (div not positive or mult negative), in which case the scale
+ * is marked invalid by a zero div.
+ */
+int
+oggz_scale_init (oggz_scale_t * scale, ogg_int64_t mult, ogg_int64_t div)
+{
+  ogg_int64_t g;
 
-#ifdef DEBUG
-  printf ("oggz_..._granuleshift: serialno %010lu Got frame or field %lld (%lld + %lld): %lld units\n",
-	  serialno, dt, iframe, pframe, units);
-#endif
+  scale->div = 0;
+
+  if (div <= 0 || mult < 0) return -1;
+
+  if ((g = oggz_gcd (mult, div)) > 1) {
+    mult /= g;
+    div /= g;
+  }
+
+  scale->quot = mult / div;
+  scale->rem = (ogg_uint64_t)(mult % div);
+  scale->div = (ogg_uint64_t)div;
+  scale->recip = (~(ogg_uint64_t)0) / scale->div;
+  scale->rem_max = scale->rem ? (~(ogg_uint64_t)0) / scale->rem : ~(ogg_uint64_t)0;
+
+  return 0;
+}
+
+/* x / div, by multiplying with the reciprocal; the estimate is low by
+ * at most 2 */
+static ogg_uint64_t
+oggz_scale_div (const oggz_scale_t * scale, ogg_uint64_t x)
+{
+  ogg_uint64_t q, r;
+
+  q = oggz_mulhi64 (x, scale->recip);
+  r = x - q * scale->div;
+
+  while (r >= scale->div) {
+    q++;
+    r -= scale->div;
+  }
 
-  return units;
+  return q;
+}
+
+/*
+ * x * mult / div, truncated towards zero as for the equivalent C
+ * expression, but without overflow in the intermediate product.
+ */
+ogg_int64_t
+oggz_scale (const oggz_scale_t * scale, ogg_int64_t x)
+{
+  ogg_uint64_t ux, frac;
+  int negative = 0;
+
+  if (x < 0) {
+    negative = 1;
+    ux = -(ogg_uint64_t)x;
+  } else {
+    ux = (ogg_uint64_t)x;
+  }
+
+  if (scale->rem == 0) {
+    frac = 0;
+  } else if (ux <= scale->rem_max) {
+    frac = oggz_scale_div (scale, ux * scale->rem);
+  } else {
+    /* Split x into whole multiples of div and a remainder */
+    ogg_uint64_t whole = oggz_scale_div (scale, ux);
+    ogg_uint64_t part = ux - whole * scale->div;
+    frac = whole * scale->rem + oggz_scale_div (scale, part * scale->rem);
+  }
+
+  ux = ux * (ogg_uint64_t)scale->quot + frac;
+
+  return negative ? -(ogg_int64_t)ux : (ogg_int64_t)ux;
+}
+
+/* Convert a granulepos to the count of frames (or samples) it denotes */
+ogg_int64_t
+oggz_stream_granule_frames (oggz_stream_t * stream, ogg_int64_t granulepos)
+{
+  ogg_int64_t iframe, pframe;
+
+  switch (stream->granule_mapping) {
+  case OGGZ_GRANULE_GRANULESHIFT:
+    iframe = granulepos >> stream->granuleshift;
+    pframe = granulepos - (iframe << stream->granuleshift);
+    granulepos = iframe + pframe;
+    if (granulepos > 0) granulepos -= stream->first_granule;
+    return granulepos;
+  case OGGZ_GRANULE_DIRAC:
+    iframe = granulepos >> stream->granuleshift;
+    pframe = granulepos - (iframe << stream->granuleshift);
+    /* frame or field number, less the delay */
+    return (ogg_int64_t)(ogg_uint32_t)((iframe + pframe) >> 9) -
+      (ogg_uint16_t)(pframe >> 9);
+  case OGGZ_GRANULE_LINEAR:
+  default:
+    return granulepos;
+  }
 }
 
 static ogg_int64_t
-oggz_metric_default_granuleshift (OGGZ * oggz, long serialno,
-				  ogg_int64_t granulepos, void * user_data)
+oggz_metric_internal_units (OGGZ * oggz, long serialno, ogg_int64_t granulepos)
 {
   oggz_stream_t * stream;
-  ogg_int64_t iframe, pframe;
-  ogg_int64_t units;
+  ogg_int64_t frames;
 
   stream = oggz_get_stream (oggz, serialno);
   if (stream == NULL) return -1;
 
-  iframe = granulepos >> stream->granuleshift;
-  pframe = granulepos - (iframe << stream->granuleshift);
-  granulepos = iframe + pframe;
-  if (granulepos > 0) granulepos -= stream->first_granule;
+  frames = oggz_stream_granule_frames (stream, granulepos);
 
-  units = granulepos * stream->granulerate_d / stream->granulerate_n;
+  if (stream->units_scale.div == 0)
+    return frames * stream->granulerate_d / stream->granulerate_n;
 
-#ifdef DEBUG
-  printf ("oggz_..._granuleshift: serialno %010lu Got frame %lld (%lld + %lld): %lld units\n",
-	  serialno, granulepos, iframe, pframe, units);
-#endif
+  return oggz_scale (&stream->units_scale, frames);
+}
 
-  return units;
+static ogg_int64_t
+oggz_metric_dirac (OGGZ * oggz, long serialno,
+                   ogg_int64_t granulepos, void * user_data)
+{
+  return oggz_metric_internal_units (oggz, serialno, granulepos);
+}
+
+static ogg_int64_t
+oggz_metric_default_granuleshift (OGGZ * oggz, long serialno,
+				  ogg_int64_t granulepos, void * user_data)
+{
+  return oggz_metric_internal_units (oggz, serialno, granulepos);
 }
 
 static ogg_int64_t
 oggz_metric_default_linear (OGGZ * oggz, long serialno, ogg_int64_t granulepos,
 			    void * user_data)
 {
-  oggz_stream_t * stream;
+  return oggz_metric_internal_units (oggz, serialno, granulepos);
+}
 
-  stream = oggz_get_stream (oggz, serialno);
-  if (stream == NULL) return -1;
+/*
+ * Units are milliseconds for the built-in metrics, so the time in
+ * nanoseconds of each granule is granulerate_d * 1000000 / granulerate_n.
+ * Reduce by common factors first to keep the multiplier in range.
+ */
+static void
+oggz_metric_update_time_scale (oggz_stream_t * stream)
+{
+  ogg_int64_t mult = 1000000, div = stream->granulerate_n, d, g;
 
-  return (stream->granulerate_d * granulepos / stream->granulerate_n);
+  stream->time_scale.div = 0;
+
+  if (div <= 0 || stream->granulerate_d < 0) return;
+
+  g = oggz_gcd (mult, div);
+  mult /= g;
+  div /= g;
+
+  d = stream->granulerate_d;
+  if ((g = oggz_gcd (d, div)) > 1) {
+    d /= g;
+    div /= g;
+  }
+
+  if (d != 0 && mult > OGGZ_INT64_MAX / d) return;
+
+  oggz_scale_init (&stream->time_scale, d * mult, div);
 }
 
 static int
@@ -122,15 +260,22 @@ oggz_metric_update (OGGZ * oggz, long serialno)
     stream->granulerate_d = 0;
   }
 
+  oggz_scale_init (&stream->units_scale, stream->granulerate_d,
+                   stream->granulerate_n);
+  oggz_metric_update_time_scale (stream);
+
   if (stream->granuleshift == 0) {
+    stream->granule_mapping = OGGZ_GRANULE_LINEAR;
     return oggz_set_metric_internal (oggz, serialno,
 				     oggz_metric_default_linear,
 				     NULL, 1);
   } else if (oggz_stream_get_content (oggz, serialno) == OGGZ_CONTENT_DIRAC) {
+    stream->granule_mapping = OGGZ_GRANULE_DIRAC;
     return oggz_set_metric_internal (oggz, serialno,
 				     oggz_metric_dirac,
 				     NULL, 1);
   } else {
+    stream->granule_mapping = OGGZ_GRANULE_GRANULESHIFT;
     return oggz_set_metric_internal (oggz, serialno,
 				     oggz_metric_default_granuleshift,
 				     NULL, 1);
@@ -201,6 +346,132 @@ oggz_get_granulerate (OGGZ * oggz, long serialno,
   return 0;
 }
 
+/*
+ * Time in nanoseconds of a granulepos. Streams without a built-in
+ * mapping fall back to their metric, whose units are milliseconds.
+ */
+static ogg_int64_t
+oggz_stream_get_time (OGGZ * oggz, oggz_stream_t * stream, long serialno,
+                      ogg_int64_t granulepos)
+{
+  ogg_int64_t units;
+
+  if (granulepos == -1) return -1;
+
+  if (stream->metric_internal && stream->time_scale.div != 0) {
+    return oggz_scale (&stream->time_scale,
+                       oggz_stream_granule_frames (stream, granulepos));
+  }
+
+  units = oggz_stream_get_unit (oggz, stream, serialno, granulepos);
+  if (units == -1) return -1;
+
+  return units * 1000000;
+}
+
+ogg_int64_t
+oggz_granulepos_to_time (OGGZ * oggz, long serialno, ogg_int64_t granulepos)
+{
+  oggz_stream_t * stream;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  stream = oggz_get_stream (oggz, serialno);
+  if (stream == NULL) return OGGZ_ERR_BAD_SERIALNO;
+
+  return oggz_stream_get_time (oggz, stream, serialno, granulepos);
+}
+
+/*
+ * The batch conversion works on blocks of granuleposes in two passes:
+ * first granulepos to frames, then frames to nanoseconds. Each pass is a
+ * branch-free loop over one mapping, which the compiler can vectorize;
+ * the shift and mask of a granuleshift in particular are done for
+ * several granuleposes at once.
+ */
+#define OGGZ_BATCH_BLOCK 256
+
+static void
+oggz_granule_frames_batch (oggz_stream_t * stream, const ogg_int64_t * in,
+                           ogg_int64_t * frames, long n)
+{
+  int shift = stream->granuleshift;
+  ogg_int64_t mask = ((ogg_int64_t)1 << shift) - 1;
+  ogg_int64_t first_granule = stream->first_granule;
+  ogg_int64_t f;
+  long i;
+
+  switch (stream->granule_mapping) {
+  case OGGZ_GRANULE_GRANULESHIFT:
+    for (i = 0; i < n; i++) {
+      f = (in[i] >> shift) + (in[i] & mask);
+      frames[i] = f - (f > 0 ? first_granule : 0);
+    }
+    break;
+  case OGGZ_GRANULE_DIRAC:
+    for (i = 0; i < n; i++) {
+      f = (in[i] >> shift) + (in[i] & mask);
+      frames[i] = ((f >> 9) & 0xffffffff) - (((in[i] & mask) >> 9) & 0xffff);
+    }
+    break;
+  case OGGZ_GRANULE_LINEAR:
+  default:
+    memcpy (frames, in, n * sizeof (ogg_int64_t));
+    break;
+  }
+}
+
+static void
+oggz_scale_batch (const oggz_scale_t * scale, const ogg_int64_t * in,
+                  const ogg_int64_t * frames, ogg_int64_t * out, long n)
+{
+  ogg_int64_t quot = scale->quot;
+  long i;
+
+  if (scale->rem == 0) {
+    for (i = 0; i < n; i++) {
+      out[i] = (in[i] == -1) ? -1 : frames[i] * quot;
+    }
+  } else {
+    for (i = 0; i < n; i++) {
+      out[i] = (in[i] == -1) ? -1 : oggz_scale (scale, frames[i]);
+    }
+  }
+}
+
+int
+oggz_granulepos_to_time_batch (OGGZ * oggz, long serialno,
+                               const ogg_int64_t * in, ogg_int64_t * out,
+                               long n)
+{
+  oggz_stream_t * stream;
+  ogg_int64_t frames[OGGZ_BATCH_BLOCK];
+  long i, len;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  stream = oggz_get_stream (oggz, serialno);
+  if (stream == NULL) return OGGZ_ERR_BAD_SERIALNO;
+
+  if (n < 0 || (n > 0 && (in == NULL || out == NULL)))
+    return OGGZ_ERR_INVALID;
+
+  if (!stream->metric_internal || stream->time_scale.div == 0) {
+    for (i = 0; i < n; i++) {
+      out[i] = oggz_stream_get_time (oggz, stream, serialno, in[i]);
+    }
+    return 0;
+  }
+
+  for (i = 0; i < n; i += len) {
+    len = MIN (n - i, OGGZ_BATCH_BLOCK);
+    oggz_granule_frames_batch (stream, in + i, frames, len);
+    oggz_scale_batch (&stream->time_scale, in + i, frames, out + i, len);
+  }
+
+  return 0;
+}
+
 int
 oggz_set_first_granule (OGGZ * oggz, long serialno,
 		        ogg_int64_t first_granule)
@@ -105,6 +105,8 @@ oggz_new (int flags)
   oggz->order = NULL;
   oggz->order_user_data = NULL;
 
+  memset (&oggz->stats, 0, sizeof (OggzStats));
+
   oggz->packet_buffer = oggz_dlist_new ();
   if (oggz->packet_buffer == NULL) {
     goto err_streams_new;
@@ -195,6 +197,9 @@ oggz_stream_clear (void * data)
 
   if (stream->calculate_data != NULL)
     oggz_free (stream->calculate_data);
+
+  if (stream->index != NULL)
+    oggz_free (stream->index);
   
   oggz_free (stream);
 
@@ -334,6 +339,7 @@ oggz_add_stream (OGGZ * oggz, long serialno)
 
   stream = oggz_malloc (sizeof (oggz_stream_t));
   if (stream == NULL) return NULL;
+  OGGZ_STATS_ADD (oggz, allocs, 1);
 
   ogg_stream_init (&stream->ogg_stream, (int)serialno);
 
@@ -356,10 +362,35 @@ oggz_add_stream (OGGZ * oggz, long serialno)
   stream->e_o_s = 0;
   stream->granulepos = 0;
   stream->packetno = -1; /* will be incremented on first read or write */
+  stream->page_only = 0;
+
+  stream->index = NULL;
+  stream->index_nr = 0;
+  stream->index_max = 0;
+  stream->index_stride = 1;
+  stream->index_candidates = 0;
+  stream->index_end_pageno = -1;
+  stream->index_end_offset = 0;
+  stream->index_end_packets = 0;
+  stream->index_eos = 0;
+  stream->index_next_pageno = -1;
+  stream->seek_packetno = -1;
+
+  stream->sort_head = NULL;
+  stream->sort_tail = NULL;
+  stream->sort_unkeyed = NULL;
+  stream->sort_unit = -1;
+  stream->sort_heap_index = -1;
+  stream->sort_ended = 0;
+
+  stream->producer = NULL;
 
   stream->metric = NULL;
   stream->metric_user_data = NULL;
   stream->metric_internal = 0;
+  stream->granule_mapping = OGGZ_GRANULE_NONE;
+  stream->units_scale.div = 0;
+  stream->time_scale.div = 0;
   stream->order = NULL;
   stream->order_user_data = NULL;
   stream->read_packet = NULL;
@@ -585,13 +616,31 @@ oggz_get_unit (OGGZ * oggz, long serialno, ogg_int64_t granulepos)
     stream = oggz_get_stream (oggz, serialno);
     if (!stream) return -1;
 
-    if (stream->metric) {
-      return stream->metric (oggz, serialno, granulepos,
-			     stream->metric_user_data);
-    } else if (oggz->metric) {
-      return oggz->metric (oggz, serialno, granulepos,
-			   oggz->metric_user_data);
-    }
+    return oggz_stream_get_unit (oggz, stream, serialno, granulepos);
+  }
+
+  return -1;
+}
+
+/*
+ * As for oggz_get_unit(), for a stream already looked up. The built-in
+ * metrics are evaluated directly from the stream's precomputed scale.
+ */
+ogg_int64_t
+oggz_stream_get_unit (OGGZ * oggz, oggz_stream_t * stream, long serialno,
+                      ogg_int64_t granulepos)
+{
+  if (granulepos == -1) return -1;
+
+  if (stream->metric_internal && stream->units_scale.div != 0) {
+    return oggz_scale (&stream->units_scale,
+                       oggz_stream_granule_frames (stream, granulepos));
+  } else if (stream->metric) {
+    return stream->metric (oggz, serialno, granulepos,
+			   stream->metric_user_data);
+  } else if (oggz->metric) {
+    return oggz->metric (oggz, serialno, granulepos,
+			 oggz->metric_user_data);
   }
 
   return -1;
@@ -623,6 +672,19 @@ oggz_set_order (OGGZ * oggz, long serialno,
   return 0;
 }
 
+int
+oggz_get_stats (OGGZ * oggz, OggzStats * stats)
+{
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+  if (stats == NULL) return OGGZ_ERR_INVALID;
+
+  if (!OGGZ_CONFIG_STATS) return OGGZ_ERR_DISABLED;
+
+  memcpy (stats, &oggz->stats, sizeof (OggzStats));
+
+  return 0;
+}
+
 /* Map callback return values to error return values */
 int
 oggz_map_return_value_to_error (int cb_ret)
@@ -0,0 +1,115 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_crc.c
+ *
+ * Ogg page checksums.
+ *
+ * The Ogg checksum is a CRC-32 with polynomial 0x04c11db7, processed most
+ * significant bit first, with an initial value of 0 and no final xor. It is
+ * therefore linear: the checksum of (a xor b) is the checksum of a xor the
+ * checksum of b, for messages of equal length. oggz_page_patch_header()
+ * uses this to update the checksum of a page from the changed header bytes
+ * only; see oggz_page.c.
+ */
+
+#include "config.h"
+
+#include "oggz_crc.h"
+#include "oggz_crc_table.h"
+
+ogg_uint32_t
+oggz_crc32 (ogg_uint32_t crc, const unsigned char * data, long n)
+{
+  const ogg_uint32_t (*t)[256] = oggz_crc_lookup;
+
+  while (n >= 8) {
+    crc ^= ((ogg_uint32_t)data[0] << 24) | ((ogg_uint32_t)data[1] << 16) |
+           ((ogg_uint32_t)data[2] << 8) | (ogg_uint32_t)data[3];
+
+    crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff] ^
+          t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff] ^
+          t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+
+    data += 8;
+    n -= 8;
+  }
+
+  while (n-- > 0) {
+    crc = (crc << 8) ^ t[0][(crc >> 24) ^ *data++];
+  }
+
+  return crc;
+}
+
+/* Multiply a by b, modulo the CRC polynomial */
+static ogg_uint32_t
+oggz_crc32_mulmod (ogg_uint32_t a, ogg_uint32_t b)
+{
+  ogg_uint32_t r = 0;
+  int i;
+
+  for (i = 31; i >= 0; i--) {
+    r = (r << 1) ^ ((r & 0x80000000UL) ? 0x04c11db7UL : 0);
+    if ((b >> i) & 1) r ^= a;
+  }
+
+  return r;
+}
+
+ogg_uint32_t
+oggz_crc32_zeros (ogg_uint32_t crc, ogg_int64_t n)
+{
+  int k;
+
+  for (k = 0; n > 0 && k < 64; k++, n >>= 1) {
+    if (n & 1) crc = oggz_crc32_mulmod (crc, oggz_crc_zeros[k]);
+  }
+
+  return crc;
+}
+
+ogg_uint32_t
+oggz_crc32_page (const unsigned char * header, long header_len,
+                 const unsigned char * body, long body_len)
+{
+  static const unsigned char zeros[4] = {0, 0, 0, 0};
+  ogg_uint32_t crc;
+
+  crc = oggz_crc32 (0, header, 22);
+  crc = oggz_crc32 (crc, zeros, 4);
+  crc = oggz_crc32 (crc, header + 26, header_len - 26);
+  crc = oggz_crc32 (crc, body, body_len);
+
+  return crc;
+}
@@ -0,0 +1,62 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_CRC_H__
+#define __OGGZ_CRC_H__
+
+#include <ogg/ogg.h>
+
+/*
+ * oggz_crc32 (crc, data, n)
+ *
+ * Continue the Ogg page checksum crc over n bytes of data.
+ * Start a new checksum with crc = 0.
+ */
+ogg_uint32_t oggz_crc32 (ogg_uint32_t crc, const unsigned char * data, long n);
+
+/*
+ * oggz_crc32_zeros (crc, n)
+ *
+ * Continue the checksum crc over n zero bytes, in O(log n) time.
+ */
+ogg_uint32_t oggz_crc32_zeros (ogg_uint32_t crc, ogg_int64_t n);
+
+/*
+ * oggz_crc32_page (header, header_len, body, body_len)
+ *
+ * Calculate the checksum of a page, treating the checksum field of the
+ * header as zero (without modifying it).
+ */
+ogg_uint32_t oggz_crc32_page (const unsigned char * header, long header_len,
+                              const unsigned char * body, long body_len);
+
+#endif /* __OGGZ_CRC_H__ */
@@ -43,6 +43,10 @@
 #include <string.h>
 #include <errno.h>
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "oggz_compat.h"
 #include "oggz_private.h"
 
@@ -69,6 +73,9 @@ oggz_io_read (OGGZ * oggz, void * buf, size_t n)
 
   else return (size_t) OGGZ_ERR_INVALID;
 
+  OGGZ_STATS_ADD (oggz, io_reads, 1);
+  if ((long)bytes > 0) OGGZ_STATS_ADD (oggz, bytes_read, bytes);
+
   return bytes;
 }
 
@@ -90,7 +97,10 @@ oggz_io_write (OGGZ * oggz, void * buf, size_t n)
   else {
     return (size_t) OGGZ_ERR_INVALID;
   }
-    
+
+  OGGZ_STATS_ADD (oggz, io_writes, 1);
+  if ((long)bytes > 0) OGGZ_STATS_ADD (oggz, bytes_written, bytes);
+
   return bytes;
 }
 
@@ -99,8 +109,15 @@ oggz_io_seek (OGGZ * oggz, long offset, int whence)
 {
   OggzIO * io;
 
+  OGGZ_STATS_ADD (oggz, io_seeks, 1);
+
   if (oggz->file != NULL) {
-    if (fseek (oggz->file, offset, whence) == -1) {
+    /* Reads bypass stdio (see oggz_io_read), so position the descriptor
+     * directly; fseek() may skip the lseek() if its cached offset matches */
+    if (!(oggz->flags & OGGZ_WRITE)) {
+      if (lseek (fileno(oggz->file), offset, whence) == -1)
+        return OGGZ_ERR_SYSTEM;
+    } else if (fseek (oggz->file, offset, whence) == -1) {
       if (errno == ESPIPE) {
 	/*oggz_set_error (oggz, OGGZ_ERR_NOSEEK);*/
       } else {
@@ -128,7 +145,10 @@ oggz_io_tell (OGGZ * oggz)
   long offset;
 
   if (oggz->file != NULL) {
-    if ((offset = ftell (oggz->file)) == -1) {
+    if (!(oggz->flags & OGGZ_WRITE)) {
+      if ((offset = (long) lseek (fileno(oggz->file), 0, SEEK_CUR)) == -1)
+        return -1;
+    } else if ((offset = ftell (oggz->file)) == -1) {
       if (errno == ESPIPE) {
 	/*oggz_set_error (oggz, OGGZ_ERR_NOSEEK);*/
       } else {
@@ -201,6 +221,9 @@ oggz_io_set_read (OGGZ * oggz, OggzIORead read, void * user_handle)
   oggz->io->read = read;
   oggz->io->read_user_handle = user_handle;
 
+  /* Pages remembered from previous seeks may no longer apply */
+  if (!(oggz->flags & OGGZ_WRITE)) oggz_seek_cache_clear (oggz);
+
   return 0;
 }
 
@@ -257,6 +280,9 @@ oggz_io_set_seek (OGGZ * oggz, OggzIOSeek seek, void * user_handle)
   oggz->io->seek = seek;
   oggz->io->seek_user_handle = user_handle;
 
+  /* Pages remembered from previous seeks may no longer apply */
+  if (!(oggz->flags & OGGZ_WRITE)) oggz_seek_cache_clear (oggz);
+
   return 0;
 }
 
@@ -0,0 +1,205 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_page.c
+ *
+ * Page header manipulation with incremental checksum updates.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "oggz_private.h"
+#include "oggz_crc.h"
+
+#include "oggz/oggz_page.h"
+
+#define OGGZ_PAGE_CRC_OFFSET 22
+#define OGGZ_PAGE_CRC_LEN 4
+
+static int
+oggz_page_valid (const ogg_page * og)
+{
+  if (og == NULL || og->header == NULL) return 0;
+  if (og->header_len < 27 || og->header_len != 27 + og->header[26]) return 0;
+  if (og->body_len < 0 || (og->body_len > 0 && og->body == NULL)) return 0;
+
+  return 1;
+}
+
+static ogg_uint32_t
+oggz_page_crc_get (const ogg_page * og)
+{
+  const unsigned char * c = og->header + OGGZ_PAGE_CRC_OFFSET;
+
+  return (ogg_uint32_t)c[0] | ((ogg_uint32_t)c[1] << 8) |
+    ((ogg_uint32_t)c[2] << 16) | ((ogg_uint32_t)c[3] << 24);
+}
+
+static void
+oggz_page_crc_set (ogg_page * og, ogg_uint32_t crc)
+{
+  unsigned char * c = og->header + OGGZ_PAGE_CRC_OFFSET;
+
+  c[0] = (unsigned char)(crc & 0xff);
+  c[1] = (unsigned char)((crc >> 8) & 0xff);
+  c[2] = (unsigned char)((crc >> 16) & 0xff);
+  c[3] = (unsigned char)((crc >> 24) & 0xff);
+}
+
+int
+oggz_page_patch_header (ogg_page * og, long offset,
+                        const unsigned char * data, long length)
+{
+  unsigned char delta[256];
+  ogg_uint32_t crc;
+  long i, n, done = 0;
+
+  if (!oggz_page_valid (og)) return OGGZ_ERR_INVALID;
+  if (data == NULL || offset < 0 || length < 0) return OGGZ_ERR_INVALID;
+  if (offset + length > og->header_len) return OGGZ_ERR_INVALID;
+  if (offset < OGGZ_PAGE_CRC_OFFSET + OGGZ_PAGE_CRC_LEN &&
+      offset + length > OGGZ_PAGE_CRC_OFFSET)
+    return OGGZ_ERR_INVALID;
+
+  /* The checksum is linear, so the new checksum is the old one xor the
+   * checksum of a page which is zero except for (old ^ new) at the
+   * changed bytes. Leading zeros do not affect the checksum, and trailing
+   * zeros are accounted for with oggz_crc32_zeros(). */
+  crc = 0;
+  while (done < length) {
+    n = MIN (length - done, (long)sizeof (delta));
+    for (i = 0; i < n; i++) {
+      delta[i] = og->header[offset + done + i] ^ data[done + i];
+    }
+    crc = oggz_crc32 (crc, delta, n);
+    done += n;
+  }
+  crc = oggz_crc32_zeros (crc, (og->header_len - offset - length) +
+                          (ogg_int64_t)og->body_len);
+
+  memcpy (og->header + offset, data, length);
+  oggz_page_crc_set (og, oggz_page_crc_get (og) ^ crc);
+
+  return 0;
+}
+
+int
+oggz_page_set_granulepos (ogg_page * og, ogg_int64_t granulepos)
+{
+  unsigned char gp[8];
+  ogg_uint64_t g = (ogg_uint64_t)granulepos;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    gp[i] = (unsigned char)(g & 0xff);
+    g >>= 8;
+  }
+
+  return oggz_page_patch_header (og, 6, gp, 8);
+}
+
+int
+oggz_page_set_eos (ogg_page * og, int eos)
+{
+  unsigned char header_type;
+
+  if (!oggz_page_valid (og)) return OGGZ_ERR_INVALID;
+
+  if (eos)
+    header_type = og->header[5] | 0x04;
+  else
+    header_type = og->header[5] & ~0x04;
+
+  return oggz_page_patch_header (og, 5, &header_type, 1);
+}
+
+int
+oggz_page_packets_init (OggzPagePackets * iter, const ogg_page * og)
+{
+  if (iter == NULL || !oggz_page_valid (og)) return OGGZ_ERR_INVALID;
+
+  iter->og = og;
+  iter->segment = 0;
+  iter->offset = 0;
+
+  return 0;
+}
+
+int
+oggz_page_packets_next (OggzPagePackets * iter, OggzPagePacket * pp)
+{
+  const ogg_page * og;
+  long bytes = 0;
+  int nsegments, segment, val = 255;
+
+  if (iter == NULL || pp == NULL) return OGGZ_ERR_INVALID;
+
+  og = iter->og;
+  nsegments = og->header[26];
+  segment = iter->segment;
+
+  if (segment >= nsegments) return 0;
+
+  /* A packet runs up to and including its first lacing value below 255 */
+  while (segment < nsegments) {
+    val = og->header[27 + segment];
+    bytes += val;
+    segment++;
+    if (val < 255) break;
+  }
+
+  if (iter->offset + bytes > og->body_len) return OGGZ_ERR_INVALID;
+
+  pp->data = og->body + iter->offset;
+  pp->bytes = bytes;
+  pp->segment = iter->segment;
+  pp->segments = segment - iter->segment;
+  pp->continued = (iter->segment == 0 && (og->header[5] & 0x01));
+  pp->complete = (val < 255);
+
+  iter->segment = segment;
+  iter->offset += bytes;
+
+  return 1;
+}
+
+int
+oggz_page_checksum_verify (const ogg_page * og)
+{
+  if (!oggz_page_valid (og)) return 0;
+
+  return (oggz_crc32_page (og->header, og->header_len,
+                           og->body, og->body_len) == oggz_page_crc_get (og));
+}
@@ -45,6 +45,7 @@
 #include "oggz_macros.h"
 #include "oggz_vector.h"
 #include "oggz_dlist.h"
+#include "oggz_sync.h"
 
 #define OGGZ_AUTO_MULT 1000Ull
 
@@ -55,6 +56,17 @@ typedef struct _OggzReader OggzReader;
 typedef struct _OggzWriter OggzWriter;
 
 
+#include "oggz/oggz_stats.h"
+#include "oggz/oggz_page.h"
+
+#if OGGZ_CONFIG_STATS
+#define OGGZ_STATS_ADD(oggz,field,n) ((oggz)->stats.field += (n))
+#define OGGZ_STATS_SET(oggz,field,n) ((oggz)->stats.field = (n))
+#else
+#define OGGZ_STATS_ADD(oggz,field,n)
+#define OGGZ_STATS_SET(oggz,field,n)
+#endif
+
 typedef int (*OggzReadPacket) (OGGZ * oggz, oggz_packet * op, long serialno,
 			       void * user_data);
 typedef int (*OggzReadPage) (OGGZ * oggz, const ogg_page * og, long serialno,
@@ -72,6 +84,28 @@ typedef int (*OggzOrder) (OGGZ * oggz, ogg_packet * op, void * target,
 
 typedef int (*OggzWriteHungry) (OGGZ * oggz, int empty, void * user_data);
 
+/**
+ * Precomputed constants for multiplying a value by the rational
+ * mult/div without a 64-bit divide: x * mult / div is evaluated as
+ * x * quot + (x * rem) / div, where the final division is done by
+ * multiplying by recip and correcting the remainder.
+ */
+typedef struct {
+  ogg_int64_t quot; /* mult / div */
+  ogg_uint64_t rem; /* mult % div */
+  ogg_uint64_t div;
+  ogg_uint64_t recip; /* floor ((2^64 - 1) / div) */
+  ogg_uint64_t rem_max; /* largest x for which x * rem does not overflow */
+} oggz_scale_t;
+
+/* Built-in granulepos mappings, for which the scale constants are valid */
+enum oggz_granule_mapping {
+  OGGZ_GRANULE_NONE = 0,
+  OGGZ_GRANULE_LINEAR,
+  OGGZ_GRANULE_GRANULESHIFT,
+  OGGZ_GRANULE_DIRAC
+};
+
 /* oggz_io */
 typedef size_t (*OggzIORead) (void * user_handle, void * buf, size_t n);
 typedef size_t (*OggzIOWrite) (void * user_handle, void * buf, size_t n);
@@ -79,6 +113,36 @@ typedef int (*OggzIOSeek) (void * user_handle, long offset, int whence);
 typedef long (*OggzIOTell) (void * user_handle);
 typedef int (*OggzIOFlush) (void * user_handle);
 
+/**
+ * A page of a logical bitstream on which a packet begins, as recorded
+ * in the stream's packet index for oggz_seek_packets().
+ */
+typedef struct {
+  oggz_off_t offset;
+  ogg_int64_t packetno; /* the first packet beginning on the page */
+  long pageno;
+  int segment; /* index of the lacing value which begins that packet */
+} oggz_packet_index_t;
+
+/**
+ * A page held by an OGGZ_SORT writer until it can be output in time
+ * order. Its sort key is computed once: from its own granulepos, or for
+ * a page on which no packet ends, from that of the next such page of
+ * its stream. The page data follows the structure in memory.
+ */
+typedef struct _oggz_sort_page oggz_sort_page_t;
+
+struct _oggz_sort_page {
+  oggz_sort_page_t * next;
+  ogg_int64_t unit; /* end time of the page, once keyed */
+  long seq; /* order in which pages were made */
+  int bos;
+  int keyed;
+  ogg_page og;
+};
+
+typedef struct _oggz_producer oggz_producer_t;
+
 struct _oggz_stream_t {
   ogg_stream_state ogg_stream;
 
@@ -105,11 +169,50 @@ struct _oggz_stream_t {
   ogg_int64_t granulepos;
   ogg_int64_t packetno;
 
+  /* pages are being read without packet assembly */
+  int page_only;
+
+  /* Pages on which packets begin, from the bos page up to index_end */
+  oggz_packet_index_t * index;
+  long index_nr;
+  long index_max;
+  long index_stride; /* only every stride'th candidate page is kept */
+  ogg_int64_t index_candidates; /* pages seen on which packets begin */
+  long index_end_pageno; /* pageno of the next page to index, or -1 */
+  oggz_off_t index_end_offset; /* offset following the last indexed page */
+  ogg_int64_t index_end_packets; /* packets completed before index_end */
+  int index_eos; /* the index covers the whole stream */
+
+  /* The pageno of the next page expected by the reader; -1 if packetno
+   * is not known since seeking, -2 if pages have been missed */
+  long index_next_pageno;
+
+  /* Packet sought by oggz_seek_packets(), or -1; earlier packets are
+   * skipped when reading */
+  ogg_int64_t seek_packetno;
+
+  /* Pages held for time-ordered output by an OGGZ_SORT writer */
+  oggz_sort_page_t * sort_head;
+  oggz_sort_page_t * sort_tail;
+  oggz_sort_page_t * sort_unkeyed; /* first page awaiting a key, or NULL */
+  ogg_int64_t sort_unit; /* key of the last page keyed */
+  int sort_heap_index; /* position in the writer's heap, or -1 */
+  int sort_ended; /* the eos page has been made */
+
+  /* Queue of packets fed from another thread, or NULL */
+  oggz_producer_t * producer;
+
   /** CALLBACKS **/
   OggzMetric metric;
   void * metric_user_data;
   int metric_internal;
 
+  /* Conversion constants for the built-in metrics, set by
+   * oggz_metric_update() whenever the granulerate changes */
+  int granule_mapping;
+  oggz_scale_t units_scale; /* granules to units */
+  oggz_scale_t time_scale; /* granules to nanoseconds */
+
   OggzOrder order;
   void * order_user_data;
 
@@ -126,8 +229,23 @@ struct _oggz_stream_t {
   ogg_packet * last_packet;
 };
 
+/**
+ * A page found while seeking, and the range of offsets before it in
+ * which no other page starts. Seeking to any offset within
+ * [gap_start, offset] finds this page.
+ */
+typedef struct {
+  oggz_off_t gap_start;
+  oggz_off_t offset;
+  long bytes;
+  long serialno;
+  ogg_int64_t granulepos;
+} oggz_seek_page_t;
+
+#define OGGZ_SEEK_CACHE_SIZE 64
+
 struct _OggzReader {
-  ogg_sync_state ogg_sync;
+  OggzSync sync;
 
   /* XXX: these two can prolly be removed again :) */
   ogg_stream_state ogg_stream;
@@ -150,9 +268,31 @@ struct _OggzReader {
   int current_packet_pages;
   int current_packet_begin_segment_index;
 
+  /* Packets being delivered straight from the current page, without
+   * copying them into the stream's ogg_stream_state */
+  int page_direct;
+  ogg_page page_direct_og;
+  OggzPagePackets page_direct_iter;
+  ogg_int64_t page_direct_packetno; /* libogg packetno of next packet */
+  int page_direct_delivered; /* packets delivered from the page */
+
 #if 0
   oggz_off_t offset_page_end; /* offset of end of current page */
 #endif
+
+  /* Seeking; probe reads are kept apart from the demux sync state */
+  OggzSync seek_sync;
+  oggz_off_t seek_io_offset; /* io position after last probe, or -1 */
+  long seek_read_size; /* size of the first read of each probe */
+  long seek_reads; /* number of probe reads made */
+
+  /* Recently probed pages, kept across seeks */
+  oggz_seek_page_t seek_cache[OGGZ_SEEK_CACHE_SIZE];
+  int seek_cache_next;
+
+  /* Last page with a granulepos, and the input size when it was found */
+  oggz_seek_page_t seek_last_page;
+  oggz_off_t seek_last_size;
 };
 
 /**
@@ -166,6 +306,31 @@ typedef struct {
   int * guard;
 } oggz_writer_packet_t;
 
+#define OGGZ_CACHE_LINE 64
+
+/**
+ * A single-producer, single-consumer ring of packets for one stream, set
+ * up by oggz_write_set_producer(). The producer thread alone advances
+ * tail and the writing thread alone advances head; each keeps a cached
+ * copy of the other's index, and the two sides are kept on separate
+ * cache lines.
+ */
+struct _oggz_producer {
+  oggz_writer_packet_t ** ring;
+  unsigned long mask; /* ring size - 1; the size is a power of two */
+  char pad0[OGGZ_CACHE_LINE];
+
+  /* Written by the producer */
+  unsigned long tail;
+  unsigned long head_cache;
+  char pad1[OGGZ_CACHE_LINE];
+
+  /* Written by the writing thread */
+  unsigned long head;
+  unsigned long tail_cache;
+  char pad2[OGGZ_CACHE_LINE];
+};
+
 enum oggz_writer_state {
   OGGZ_MAKING_PACKETS = 0,
   OGGZ_WRITING_PAGES = 1
@@ -174,6 +339,9 @@ enum oggz_writer_state {
 struct _OggzWriter {
   oggz_writer_packet_t * next_zpacket; /* stashed in case of FLUSH_BEFORE */
   OggzVector * packet_queue;
+  long queue_bytes; /* bytes of packet data in packet_queue */
+  long queue_max_packets; /* limits on packet_queue, or 0 for none */
+  long queue_max_bytes;
 
   OggzWriteHungry hungry;
   void * hungry_user_data;
@@ -200,6 +368,18 @@ struct _OggzWriter {
   int no_more_packets; /* used only in the local oggz_write loop to indicate
                           end of stream */
 
+  /* OGGZ_SORT: streams whose first held page is keyed, as a heap
+   * ordered by the key of that page */
+  oggz_stream_t ** sort_heap;
+  int sort_heap_nr;
+  int sort_heap_max;
+  long sort_seq;
+  oggz_sort_page_t * sort_out; /* held page currently being output */
+
+  /* Streams fed from other threads, taken from in turn */
+  oggz_stream_t ** producers;
+  int nr_producers;
+  int next_producer;
 };
 
 struct _OggzIO {
@@ -257,6 +437,8 @@ struct _OGGZ {
   } x;
 
   OggzDList * packet_buffer;
+
+  OggzStats stats;
 };
 
 OGGZ * oggz_read_init (OGGZ * oggz);
@@ -270,6 +452,8 @@ int oggz_map_return_value_to_error (int cb_ret);
 
 int oggz_get_bos (OGGZ * oggz, long serialno);
 ogg_int64_t oggz_get_unit (OGGZ * oggz, long serialno, ogg_int64_t granulepos);
+ogg_int64_t oggz_stream_get_unit (OGGZ * oggz, oggz_stream_t * stream,
+                                  long serialno, ogg_int64_t granulepos);
 
 int oggz_set_metric_internal (OGGZ * oggz, long serialno, OggzMetric metric,
 			      void * user_data, int internal);
@@ -277,8 +461,19 @@ int oggz_has_metrics (OGGZ * oggz);
 
 int oggz_purge (OGGZ * oggz);
 
+void oggz_seek_cache_clear (OGGZ * oggz);
+
+ogg_int64_t oggz_index_read_page (OGGZ * oggz, oggz_stream_t * stream,
+                                  const ogg_page * og,
+                                  oggz_off_t offset);
+
 /* metric_internal */
 
+int oggz_scale_init (oggz_scale_t * scale, ogg_int64_t mult, ogg_int64_t div);
+ogg_int64_t oggz_scale (const oggz_scale_t * scale, ogg_int64_t x);
+ogg_int64_t oggz_stream_granule_frames (oggz_stream_t * stream,
+                                        ogg_int64_t granulepos);
+
 int
 oggz_set_granulerate (OGGZ * oggz, long serialno, 
                                     ogg_int64_t granule_rate_numerator,
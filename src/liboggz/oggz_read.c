@@ -75,7 +75,7 @@ oggz_read_init (OGGZ * oggz)
 {
   OggzReader * reader = &oggz->x.reader;
 
-  ogg_sync_init (&reader->ogg_sync);
+  oggz_sync_init (&reader->sync);
   ogg_stream_init (&reader->ogg_stream, (int)-1);
   reader->current_serialno = -1;
 
@@ -92,6 +92,14 @@ oggz_read_init (OGGZ * oggz)
   reader->current_packet_begin_page_offset = 0;
   reader->current_packet_pages = 0;
 
+  reader->page_direct = 0;
+
+  oggz_sync_init (&reader->seek_sync);
+  reader->seek_io_offset = -1;
+  reader->seek_read_size = 0;
+  reader->seek_reads = 0;
+  oggz_seek_cache_clear (oggz);
+
   return oggz;
 }
 
@@ -101,7 +109,8 @@ oggz_read_close (OGGZ * oggz)
   OggzReader * reader = &oggz->x.reader;
 
   ogg_stream_clear (&reader->ogg_stream);
-  ogg_sync_clear (&reader->ogg_sync);
+  oggz_sync_clear (&reader->sync);
+  oggz_sync_clear (&reader->seek_sync);
 
   return oggz;
 }
@@ -194,9 +203,11 @@ oggz_read_get_next_page (OGGZ * oggz, ogg_page * og)
           oggz->offset, reader->current_page_bytes);
 #endif
   oggz->offset += reader->current_page_bytes;
+  reader->current_page_bytes = 0;
 
   do {
-    more = ogg_sync_pageseek (&reader->ogg_sync, og);
+    more = oggz_sync_pageseek (&reader->sync, og,
+                               !(oggz->flags & OGGZ_NOCRC));
 
     if (more == 0) {
       /* No page available */
@@ -206,11 +217,13 @@ oggz_read_get_next_page (OGGZ * oggz, ogg_page * og)
   printf ("%s: skipping; incrementing oggz->offset by 0x%lx bytes\n", __func__, -more);
 #endif
       oggz->offset += (-more);
+      OGGZ_STATS_ADD (oggz, bytes_skipped, -more);
     } else {
 #ifdef DEBUG_VERBOSE
       printf ("get_next_page: page has %ld bytes\n", more);
 #endif
       reader->current_page_bytes = more;
+      OGGZ_STATS_ADD (oggz, pages_read, 1);
       found = 1;
     }
 
@@ -245,6 +258,9 @@ oggz_read_new_pbuffer_entry(OGGZ *oggz, oggz_packet * zp,
   }
   memcpy(p->zp.op.packet, op->packet, op->bytes);
 
+  OGGZ_STATS_ADD (oggz, allocs, 2);
+  OGGZ_STATS_ADD (oggz, packets_buffered, 1);
+
   p->stream = stream;
   p->serialno = serialno;
   p->reader = reader;
@@ -313,7 +329,8 @@ oggz_read_deliver_packet(void *elem) {
   p->reader->current_granulepos = p->zp.pos.calc_granulepos;
 
   p->reader->current_unit =
-    oggz_get_unit (p->oggz, p->serialno, p->zp.pos.calc_granulepos);
+    oggz_stream_get_unit (p->oggz, p->stream, p->serialno,
+                          p->zp.pos.calc_granulepos);
 
   if (p->stream->read_packet) {
     if ((cb_ret = p->stream->read_packet(p->oggz, &(p->zp), p->serialno, 
@@ -339,6 +356,123 @@ oggz_read_deliver_packet(void *elem) {
   return DLIST_ITER_CONTINUE;
 }
 
+/*
+ * Whether the packets of a page can be skipped, delivering only the page:
+ * no packet callback would receive them, and the header packets, from
+ * which OGGZ_AUTO reads metrics and comments, have all been read.
+ * Skeleton packets describe the other streams, so are always read.
+ */
+static int
+oggz_read_page_only (OGGZ * oggz, oggz_stream_t * stream)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (stream->read_packet != NULL || reader->read_packet != NULL)
+    return 0;
+
+  if (stream->packetno < stream->numheaders - 1)
+    return 0;
+
+  if (stream->content == OGGZ_CONTENT_SKELETON)
+    return 0;
+
+  return 1;
+}
+
+/*
+ * Whether the packets of a page can be delivered straight from the page:
+ * the page holds only whole packets, none of which began on an earlier
+ * page, the stream has no partial packet held, and the page is the next
+ * in sequence. Otherwise libogg assembles the packets, and deals with
+ * any gap in the sequence.
+ */
+static int
+oggz_read_page_direct_start (OGGZ * oggz, ogg_stream_state * os,
+                             ogg_page * og)
+{
+  OggzReader * reader = &oggz->x.reader;
+  int nsegments = og->header[26];
+
+  if (nsegments == 0 || ogg_page_continued (og)) return 0;
+  if (og->header[27 + nsegments - 1] == 255) return 0;
+  if (ogg_page_version (og) != 0) return 0;
+
+  if (os->lacing_fill != os->lacing_returned ||
+      os->body_fill != os->body_returned)
+    return 0;
+
+  if (os->pageno != -1 && os->pageno != ogg_page_pageno (og)) return 0;
+
+  reader->page_direct_og = *og;
+  if (oggz_page_packets_init (&reader->page_direct_iter,
+                              &reader->page_direct_og) != 0)
+    return 0;
+
+  reader->page_direct = 1;
+  reader->page_direct_packetno = os->packetno;
+  reader->page_direct_delivered = 0;
+
+  return 1;
+}
+
+/*
+ * Get the next packet of the page being delivered directly, as
+ * ogg_stream_packetout() would. When the page is finished, bring the
+ * stream state up to date as if the page had been passed through it.
+ */
+static int
+oggz_read_page_direct_packetout (OGGZ * oggz, ogg_stream_state * os,
+                                 ogg_packet * op)
+{
+  OggzReader * reader = &oggz->x.reader;
+  ogg_page * og = &reader->page_direct_og;
+  OggzPagePacket pp;
+
+  if (oggz_page_packets_next (&reader->page_direct_iter, &pp) == 1) {
+    op->packet = pp.data;
+    op->bytes = pp.bytes;
+    /* Flag values as set by libogg */
+    op->b_o_s = (pp.segment == 0 && ogg_page_bos (og)) ? 0x100 : 0;
+    op->e_o_s = (pp.segment + pp.segments == og->header[26] &&
+                 ogg_page_eos (og)) ? 0x200 : 0;
+    op->granulepos = (pp.segment + pp.segments == og->header[26]) ?
+      ogg_page_granulepos (og) : -1;
+    op->packetno = reader->page_direct_packetno++;
+
+    reader->page_direct_delivered++;
+
+    return 1;
+  }
+
+  os->packetno = reader->page_direct_packetno;
+  os->pageno = ogg_page_pageno (og) + 1;
+  if (ogg_page_eos (og)) os->e_o_s = 1;
+
+  reader->page_direct = 0;
+
+  return 0;
+}
+
+/*
+ * Reading stopped part way through a page being delivered directly.
+ * Pass the page through the stream state, and drop the packets already
+ * delivered, so that the rest are read from there.
+ */
+static void
+oggz_read_page_direct_stop (OGGZ * oggz, ogg_stream_state * os)
+{
+  OggzReader * reader = &oggz->x.reader;
+  int i;
+
+  if (!reader->page_direct) return;
+
+  reader->page_direct = 0;
+
+  ogg_stream_pagein (os, &reader->page_direct_og);
+  for (i = 0; i < reader->page_direct_delivered; i++)
+    ogg_stream_packetout (os, NULL);
+}
+
 static int
 oggz_read_sync (OGGZ * oggz)
 {
@@ -349,6 +483,7 @@ oggz_read_sync (OGGZ * oggz)
   ogg_packet * op;
   oggz_position * pos;
   long serialno;
+  ogg_int64_t packets;
 
   oggz_packet packet;
   ogg_page og;
@@ -383,7 +518,11 @@ oggz_read_sync (OGGZ * oggz)
         }
         os = &stream->ogg_stream;
 
-        result = ogg_stream_packetout(os, op);
+        if (reader->page_direct) {
+          result = oggz_read_page_direct_packetout (oggz, os, op);
+        } else {
+          result = ogg_stream_packetout(os, op);
+        }
 
         /* libogg flags "holes in the data" (which are really inconsistencies
          * in the page sequence number) by returning -1. */
@@ -449,7 +588,8 @@ oggz_read_sync (OGGZ * oggz)
           /* Set unit on last packet of page */
           if ((oggz->metric || stream->metric) && reader->current_granulepos != -1) {
             reader->current_unit =
-              oggz_get_unit (oggz, serialno, reader->current_granulepos);
+              oggz_stream_get_unit (oggz, stream, serialno,
+                                    reader->current_granulepos);
           }
 
           if (stream->packetno == 1) {
@@ -463,6 +603,13 @@ oggz_read_sync (OGGZ * oggz)
           pos->pages = reader->current_packet_pages;
           pos->begin_segment_index = reader->current_packet_begin_segment_index;
 
+          /* Skip packets before one sought by oggz_seek_packets() */
+          if (stream->seek_packetno != -1) {
+            if (stream->packetno < stream->seek_packetno)
+              goto prepare_position;
+            stream->seek_packetno = -1;
+          }
+
           /* Handle reverse buffering */
           if (oggz->flags & OGGZ_AUTO) {
             /* While we are getting invalid granulepos values, store the 
@@ -486,6 +633,7 @@ oggz_read_sync (OGGZ * oggz)
               oggz_dlist_reverse_iter(oggz->packet_buffer, oggz_read_update_gp);
 	      oggz->cb_next = 0;
               if (oggz_dlist_deliter(oggz->packet_buffer, oggz_read_deliver_packet) == -1) {
+                oggz_read_page_direct_stop (oggz, os);
                 return OGGZ_ERR_HOLE_IN_DATA;
 	      }
 	      if (oggz->cb_next > 0) {
@@ -552,6 +700,14 @@ prepare_position:
       }
     }
 
+    if (reader->page_direct) {
+      stream = oggz_get_stream (oggz, reader->current_serialno);
+      if (stream != NULL)
+        oggz_read_page_direct_stop (oggz, &stream->ogg_stream);
+      else
+        reader->page_direct = 0;
+    }
+
     /* If we've got a stop already, don't read more data in */
     if (cb_ret == OGGZ_STOP_OK || 
 	cb_ret == OGGZ_STOP_ERR || 
@@ -594,7 +750,8 @@ prepare_position:
       stream->page_granulepos = granulepos;
 
       if ((oggz->metric || stream->metric) && granulepos != -1) {
-       reader->current_unit = oggz_get_unit (oggz, serialno, granulepos);
+       reader->current_unit =
+         oggz_stream_get_unit (oggz, stream, serialno, granulepos);
       } else if (granulepos == 0) {
        reader->current_unit = 0;
       }
@@ -608,7 +765,50 @@ prepare_position:
         reader->read_page (oggz, &og, serialno, reader->read_page_user_data);
     }
 
-    ogg_stream_pagein(os, &og);
+    /* Recount packets from an indexed page after seeking */
+    packets = oggz_index_read_page (oggz, stream, &og, oggz->offset);
+    if (packets != -1) stream->packetno = packets - 1;
+
+    if (oggz_read_page_only (oggz, stream)) {
+      /* Track the stream from the page header alone; the page body is
+       * not copied into the stream state */
+      ogg_int64_t granulepos = ogg_page_granulepos (&og);
+
+      stream->page_only = 1;
+      stream->packetno += ogg_page_packets (&og);
+      if (granulepos != -1) {
+        reader->current_granulepos = granulepos;
+        stream->last_granulepos = granulepos;
+      }
+      if (!ogg_page_bos (&og)) stream->delivered_non_b_o_s = 1;
+      if (stream->seek_packetno != -1 &&
+          stream->packetno + 1 >= stream->seek_packetno)
+        stream->seek_packetno = -1;
+    } else {
+      if (stream->page_only || packets != -1) {
+        /* Drop any partial packet left from before pages were skipped.
+         * libogg also drops the end of a packet continued from a skipped
+         * page, or from before seeking; count it, so that packetno
+         * carries on from the pages. */
+        if (stream->page_only) {
+          ogg_stream_reset (os);
+          stream->page_only = 0;
+        }
+        if (ogg_page_continued (&og)) {
+          int i;
+          for (i = 0; i < og.header[26]; i++) {
+            if (og.header[27+i] < 255) {
+              stream->packetno++;
+              break;
+            }
+          }
+        }
+        os->packetno = stream->packetno + 1;
+      }
+      if (!oggz_read_page_direct_start (oggz, os, &og))
+        ogg_stream_pagein(os, &og);
+    }
+
     if (ogg_page_continued(&og)) {
       if (reader->current_packet_pages != -1)
         reader->current_packet_pages++;
@@ -630,7 +830,7 @@ long
 oggz_read (OGGZ * oggz, long n)
 {
   OggzReader * reader;
-  char * buffer;
+  unsigned char * buffer;
   long bytes, bytes_read = 1, remaining = n, nread = 0;
   int cb_ret = 0;
 
@@ -654,14 +854,16 @@ oggz_read (OGGZ * oggz, long n)
   while (cb_ret != OGGZ_STOP_ERR && cb_ret != OGGZ_STOP_OK &&
          bytes_read > 0 && remaining > 0) {
     bytes = MIN (remaining, CHUNKSIZE);
-    buffer = ogg_sync_buffer (&reader->ogg_sync, bytes);
+    buffer = oggz_sync_buffer (&reader->sync, bytes);
+    if (buffer == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
     bytes_read = (long) oggz_io_read (oggz, buffer, bytes);
     if (bytes_read == OGGZ_ERR_SYSTEM) {
       return OGGZ_ERR_SYSTEM;
     }
 
     if (bytes_read > 0) {
-      ogg_sync_wrote (&reader->ogg_sync, bytes_read);
+      oggz_sync_wrote (&reader->sync, bytes_read);
       
       remaining -= bytes_read;
       nread += bytes_read;
@@ -703,7 +905,7 @@ long
 oggz_read_input (OGGZ * oggz, unsigned char * buf, long n)
 {
   OggzReader * reader;
-  char * buffer;
+  unsigned char * buffer;
   long bytes, remaining = n, nread = 0;
   int cb_ret = 0;
 
@@ -726,16 +928,29 @@ oggz_read_input (OGGZ * oggz, unsigned char * buf, long n)
 
   while (cb_ret != OGGZ_STOP_ERR && cb_ret != OGGZ_STOP_OK  &&
          /* !oggz->eos && */ remaining > 0) {
-    bytes = MIN (remaining, 4096);
-    buffer = ogg_sync_buffer (&reader->ogg_sync, bytes);
-    memcpy (buffer, buf, bytes);
-    ogg_sync_wrote (&reader->ogg_sync, bytes);
+    if (oggz_sync_attach (&reader->sync, buf, remaining)) {
+      /* Nothing is buffered, so read pages straight out of buf */
+      bytes = remaining;
+    } else {
+      /* Copy in only what is needed to complete the buffered page, so
+       * that the buffer empties and later pages can be read in place */
+      bytes = MIN (remaining, oggz_sync_wanted (&reader->sync));
+      if ((buffer = oggz_sync_buffer (&reader->sync, bytes)) == NULL)
+        return OGGZ_ERR_OUT_OF_MEMORY;
+      memcpy (buffer, buf, bytes);
+      oggz_sync_wrote (&reader->sync, bytes);
+    }
 
     buf += bytes;
     remaining -= bytes;
     nread += bytes;
 
     cb_ret = oggz_read_sync (oggz);
+
+    /* Retain any unread data before returning to the caller */
+    if (oggz_sync_detach (&reader->sync) != 0)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+
     if (cb_ret == OGGZ_ERR_OUT_OF_MEMORY)
       return cb_ret;
   }
@@ -0,0 +1,379 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_rewrite.c
+ *
+ * In-place rewriting of page headers, in parallel over a memory-mapped
+ * file where possible.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#define OGGZ_REWRITE_MMAP 1
+#include <sys/mman.h>
+#endif
+
+#if defined(OGGZ_REWRITE_MMAP) && defined(HAVE_PTHREAD)
+#define OGGZ_REWRITE_THREADS 1
+#include <pthread.h>
+#endif
+
+#include <ogg/ogg.h>
+
+#include "oggz_private.h"
+
+#include "oggz/oggz_page.h"
+
+/* #define DEBUG */
+
+/* Largest possible page header: fixed fields and a full segment table */
+#define OGGZ_PAGE_HEADER_MAX (27 + 255)
+
+typedef struct {
+  unsigned char * map; /* the mapped file, or NULL to use stdio */
+  FILE * file;
+  oggz_off_t size;
+
+  const OggzPageEdit ** edits; /* sorted by page offset */
+  long start;
+  long end;
+
+  long applied;
+  int error;
+} oggz_rewrite_job_t;
+
+static int
+oggz_rewrite_cmp (const void * a, const void * b)
+{
+  const OggzPageEdit * ea = *(const OggzPageEdit **)a;
+  const OggzPageEdit * eb = *(const OggzPageEdit **)b;
+
+  if (ea->offset != eb->offset)
+    return (ea->offset < eb->offset) ? -1 : 1;
+
+  /* Keep the edits of each page in the order given */
+  if (ea != eb)
+    return (ea < eb) ? -1 : 1;
+
+  return 0;
+}
+
+/*
+ * Set up og for the page whose header is in buf, which holds avail
+ * bytes. The page must end within size bytes of the start of buf.
+ */
+static int
+oggz_rewrite_page_init (ogg_page * og, unsigned char * buf, long avail,
+                        oggz_off_t size)
+{
+  long i, body_len = 0;
+
+  if (avail < 27 || memcmp (buf, "OggS", 4) != 0) return OGGZ_ERR_INVALID;
+  if (avail < 27 + buf[26]) return OGGZ_ERR_INVALID;
+
+  for (i = 0; i < buf[26]; i++)
+    body_len += buf[27 + i];
+
+  if (27 + buf[26] + body_len > size) return OGGZ_ERR_INVALID;
+
+  og->header = buf;
+  og->header_len = 27 + buf[26];
+  og->body = buf + og->header_len;
+  og->body_len = body_len;
+
+  return 0;
+}
+
+static int
+oggz_rewrite_apply (ogg_page * og, const OggzPageEdit * edit)
+{
+  switch (edit->type) {
+  case OGGZ_PAGE_EDIT_GRANULEPOS:
+    return oggz_page_set_granulepos (og, edit->value);
+  case OGGZ_PAGE_EDIT_EOS:
+    return oggz_page_set_eos (og, edit->value != 0);
+  case OGGZ_PAGE_EDIT_BYTES:
+    if (edit->length > (long)sizeof (edit->data)) return OGGZ_ERR_INVALID;
+    return oggz_page_patch_header (og, edit->header_offset, edit->data,
+                                   edit->length);
+  default:
+    return OGGZ_ERR_INVALID;
+  }
+}
+
+/*
+ * Seek the stdio file to a page. The stdio path is taken for files too
+ * large to map, so offsets may not fit in a long.
+ */
+static int
+oggz_rewrite_seek (FILE * file, oggz_off_t offset)
+{
+#ifdef HAVE_FSEEKO
+  if ((oggz_off_t)(off_t)offset != offset) return -1;
+  return fseeko (file, (off_t)offset, SEEK_SET);
+#else
+  if (offset > LONG_MAX) return -1;
+  return fseek (file, (long)offset, SEEK_SET);
+#endif
+}
+
+/*
+ * Make the edits of the pages in [job->start, job->end). Edits are
+ * made through the mapping if there is one, or else by reading each
+ * page header, changing it and writing it back.
+ */
+static void
+oggz_rewrite_job (oggz_rewrite_job_t * job)
+{
+  unsigned char header[OGGZ_PAGE_HEADER_MAX];
+  const OggzPageEdit * edit;
+  ogg_page og;
+  oggz_off_t offset;
+  long i, j, n;
+  int err;
+
+  for (i = job->start; i < job->end; i = j) {
+    offset = job->edits[i]->offset;
+
+    /* Edits [i, j) are of the page at offset */
+    for (j = i+1; j < job->end && job->edits[j]->offset == offset; j++);
+
+    if (offset < 0 || offset >= job->size) {
+      job->error = OGGZ_ERR_INVALID;
+      continue;
+    }
+
+    if (job->map != NULL) {
+      n = (long) MIN (job->size - offset, OGGZ_PAGE_HEADER_MAX);
+      err = oggz_rewrite_page_init (&og, job->map + offset, n,
+                                    job->size - offset);
+    } else {
+      if (oggz_rewrite_seek (job->file, offset) == -1) {
+        job->error = OGGZ_ERR_SYSTEM;
+        return;
+      }
+      n = (long) fread (header, 1, OGGZ_PAGE_HEADER_MAX, job->file);
+      err = oggz_rewrite_page_init (&og, header, n, job->size - offset);
+    }
+
+    if (err != 0) {
+#ifdef DEBUG
+      printf ("oggz_rewrite_job: no page at offset %lld\n", (long long)offset);
+#endif
+      job->error = err;
+      continue;
+    }
+
+    for (; i < j; i++) {
+      edit = job->edits[i];
+      if ((err = oggz_rewrite_apply (&og, edit)) != 0) {
+        job->error = err;
+      } else {
+        job->applied++;
+      }
+    }
+
+    if (job->map == NULL) {
+      if (oggz_rewrite_seek (job->file, offset) == -1 ||
+          fwrite (header, 1, og.header_len, job->file) != (size_t)og.header_len) {
+        job->error = OGGZ_ERR_SYSTEM;
+        return;
+      }
+    }
+  }
+}
+
+#ifdef OGGZ_REWRITE_THREADS
+static void *
+oggz_rewrite_worker (void * arg)
+{
+  oggz_rewrite_job (arg);
+  return NULL;
+}
+#endif
+
+long
+oggz_page_rewrite (const char * filename, const OggzPageEdit * edits,
+                   long nedits, int nthreads)
+{
+  oggz_rewrite_job_t * jobs;
+  const OggzPageEdit ** sorted;
+  unsigned char * map = NULL;
+  FILE * file = NULL;
+  struct stat statbuf;
+  long i, per_job, applied = 0;
+  int njobs, err = 0;
+#ifdef OGGZ_REWRITE_MMAP
+  int fd;
+#endif
+#ifdef OGGZ_REWRITE_THREADS
+  pthread_t * threads;
+  int nstarted = 1; /* the first job is run in the calling thread */
+#endif
+
+  if (filename == NULL || nedits < 0) return OGGZ_ERR_INVALID;
+  if (nedits > 0 && edits == NULL) return OGGZ_ERR_INVALID;
+  if (nedits == 0) return 0;
+
+  if (stat (filename, &statbuf) == -1) return OGGZ_ERR_SYSTEM;
+
+  sorted = oggz_malloc (nedits * sizeof (OggzPageEdit *));
+  if (sorted == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  for (i = 0; i < nedits; i++)
+    sorted[i] = &edits[i];
+  qsort (sorted, nedits, sizeof (OggzPageEdit *), oggz_rewrite_cmp);
+
+#ifdef OGGZ_REWRITE_MMAP
+  if ((fd = open (filename, O_RDWR)) == -1) {
+    oggz_free (sorted);
+    return OGGZ_ERR_SYSTEM;
+  }
+
+  if (statbuf.st_size > 0 && (off_t)(size_t)statbuf.st_size == statbuf.st_size) {
+    map = mmap (NULL, (size_t)statbuf.st_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) map = NULL;
+  }
+
+  /* Fall back to stdio if the file cannot be mapped, eg. if it is too
+   * large for the address space */
+  if (map == NULL) {
+    file = fdopen (fd, "r+b");
+    if (file == NULL) close (fd);
+  }
+#else
+  file = fopen (filename, "r+b");
+#endif
+
+  if (map == NULL && file == NULL) {
+    oggz_free (sorted);
+    return OGGZ_ERR_SYSTEM;
+  }
+
+#ifndef OGGZ_REWRITE_THREADS
+  nthreads = 1;
+#endif
+  if (map == NULL || nthreads < 1) nthreads = 1;
+  if (nthreads > nedits) nthreads = (int)nedits;
+
+  jobs = oggz_malloc (nthreads * sizeof (oggz_rewrite_job_t));
+  if (jobs == NULL) {
+    err = OGGZ_ERR_OUT_OF_MEMORY;
+    goto out;
+  }
+
+  /* Divide the edits evenly between jobs, moving each boundary on past
+   * any further edits of the same page */
+  per_job = (nedits + nthreads - 1) / nthreads;
+  i = 0;
+  for (njobs = 0; njobs < nthreads && i < nedits; njobs++) {
+    jobs[njobs].map = map;
+    jobs[njobs].file = file;
+    jobs[njobs].size = (oggz_off_t)statbuf.st_size;
+    jobs[njobs].edits = sorted;
+    jobs[njobs].start = i;
+
+    i = MIN (i + per_job, nedits);
+    while (i < nedits && sorted[i]->offset == sorted[i-1]->offset) i++;
+
+    jobs[njobs].end = i;
+    jobs[njobs].applied = 0;
+    jobs[njobs].error = 0;
+  }
+
+#ifdef OGGZ_REWRITE_THREADS
+  threads = NULL;
+  if (njobs > 1) {
+    threads = oggz_malloc (njobs * sizeof (pthread_t));
+  }
+
+  if (threads != NULL) {
+    for (; nstarted < njobs; nstarted++) {
+      if (pthread_create (&threads[nstarted], NULL, oggz_rewrite_worker,
+                          &jobs[nstarted]) != 0)
+        break;
+    }
+  }
+
+  /* Run any jobs which could not be given a thread here */
+  for (i = nstarted; i < njobs; i++)
+    oggz_rewrite_job (&jobs[i]);
+  oggz_rewrite_job (&jobs[0]);
+
+  while (nstarted > 1) pthread_join (threads[--nstarted], NULL);
+  if (threads != NULL) oggz_free (threads);
+#else
+  for (i = 0; i < njobs; i++)
+    oggz_rewrite_job (&jobs[i]);
+#endif
+
+  for (i = 0; i < njobs; i++) {
+    applied += jobs[i].applied;
+    if (err == 0) err = jobs[i].error;
+  }
+
+  oggz_free (jobs);
+
+out:
+#ifdef OGGZ_REWRITE_MMAP
+  if (map != NULL) {
+    if (munmap (map, (size_t)statbuf.st_size) == -1 && err == 0)
+      err = OGGZ_ERR_SYSTEM;
+    if (close (fd) == -1 && err == 0)
+      err = OGGZ_ERR_SYSTEM;
+  }
+#endif
+  if (file != NULL && fclose (file) != 0 && err == 0)
+    err = OGGZ_ERR_SYSTEM;
+
+  oggz_free (sorted);
+
+  return err ? err : applied;
+}
@@ -0,0 +1,577 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_scan.c
+ *
+ * Parallel page scanning of seekable inputs.
+ */
+
+#include "config.h"
+
+#if OGGZ_CONFIG_READ
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <ogg/ogg.h>
+
+#include "oggz_compat.h"
+#include "oggz_private.h"
+
+#if defined(HAVE_PTHREAD) && defined(HAVE_PREAD)
+#define OGGZ_SCAN_THREADS 1
+#include <pthread.h>
+#endif
+
+/* #define DEBUG */
+
+/* Largest possible page: a full header, segment table and body */
+#define OGGZ_PAGE_MAX (27 + 255 + 255*255)
+
+#define OGGZ_SCAN_CHUNK_MIN (128*1024)
+#define OGGZ_SCAN_CHUNK_MAX (4*1024*1024)
+
+typedef struct {
+  long pos; /* offset of page within chunk data */
+  long header_len;
+  long body_len;
+} oggz_scan_page_t;
+
+/*
+ * A chunk holds the pages which start in [start, end). Its data runs on
+ * past end far enough to complete the last of those pages, and to find
+ * the page after it.
+ */
+typedef struct {
+  oggz_off_t start;
+  oggz_off_t end;
+  oggz_off_t next; /* offset of the first page at or after end, or -1 */
+
+  unsigned char * data;
+  long data_len;
+
+  oggz_scan_page_t * pages;
+  long npages;
+  long max_pages;
+
+  long reads; /* calls to pread() */
+
+  int done;
+  int error;
+} oggz_scan_chunk_t;
+
+typedef struct {
+  OGGZ * oggz;
+  int fd; /* file descriptor for pread(), or -1 to use oggz_io */
+  oggz_off_t size;
+
+  oggz_scan_chunk_t * chunks;
+  long nchunks;
+
+  long next_chunk; /* next chunk to be read by a worker */
+  long delivered; /* chunks delivered to the callback */
+  long window; /* chunks allowed between delivered and next_chunk */
+  int abort;
+
+#ifdef OGGZ_SCAN_THREADS
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+#endif
+} oggz_scan_t;
+
+/*
+ * Read n bytes at offset. Returns the number of bytes short of n that
+ * the input ended, or a negative error.
+ */
+static long
+oggz_scan_read_at (oggz_scan_t * scan, unsigned char * buf, long n,
+                   oggz_off_t offset, long * reads)
+{
+  long bytes;
+
+  while (n > 0) {
+#ifdef HAVE_PREAD
+    if (scan->fd != -1) {
+      bytes = (long) pread (scan->fd, buf, n, offset);
+      if (bytes < 0) return OGGZ_ERR_SYSTEM;
+      (*reads)++;
+    } else
+#endif
+    {
+      if (oggz_io_seek (scan->oggz, (long)offset, SEEK_SET) != 0)
+        return OGGZ_ERR_SYSTEM;
+      bytes = (long) oggz_io_read (scan->oggz, buf, n);
+      if (bytes < 0) return OGGZ_ERR_SYSTEM;
+    }
+
+    /* The input has been truncated */
+    if (bytes == 0) break;
+
+    buf += bytes;
+    n -= bytes;
+    offset += bytes;
+  }
+
+  return n;
+}
+
+static int
+oggz_scan_add_page (oggz_scan_chunk_t * chunk, long pos, ogg_page * og)
+{
+  oggz_scan_page_t * pages;
+  long max_pages;
+
+  if (chunk->npages == chunk->max_pages) {
+    max_pages = chunk->max_pages ? chunk->max_pages * 2 : 64;
+    pages = oggz_realloc (chunk->pages, max_pages * sizeof (oggz_scan_page_t));
+    if (pages == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+    chunk->pages = pages;
+    chunk->max_pages = max_pages;
+  }
+
+  pages = &chunk->pages[chunk->npages++];
+  pages->pos = pos;
+  pages->header_len = og->header_len;
+  pages->body_len = og->body_len;
+
+  return 0;
+}
+
+/*
+ * Find the pages of a chunk, starting the search at pos within its data.
+ */
+static int
+oggz_scan_frame (oggz_scan_t * scan, oggz_scan_chunk_t * chunk, long pos)
+{
+  OggzSync sync;
+  ogg_page og;
+  oggz_off_t offset;
+  long n;
+  int err = 0;
+
+  chunk->npages = 0;
+  chunk->next = -1;
+
+  oggz_sync_init (&sync);
+  oggz_sync_attach (&sync, chunk->data + pos, chunk->data_len - pos);
+
+  /* Checksums are always verified, as a chunk may start anywhere */
+  while ((n = oggz_sync_pageseek (&sync, &og, 1)) != 0) {
+    if (n < 0) {
+      pos += -n;
+      continue;
+    }
+
+    offset = chunk->start + pos;
+    if (offset >= chunk->end) {
+      chunk->next = offset;
+      break;
+    }
+
+    if ((err = oggz_scan_add_page (chunk, pos, &og)) != 0) break;
+
+    pos += n;
+  }
+
+  /* No page follows the last one */
+  if (chunk->next == -1 && chunk->start + chunk->data_len == scan->size)
+    chunk->next = scan->size;
+
+  oggz_sync_clear (&sync);
+
+  return err;
+}
+
+static int
+oggz_scan_chunk (oggz_scan_t * scan, oggz_scan_chunk_t * chunk)
+{
+  oggz_off_t data_end;
+  long remaining;
+
+  data_end = MIN (chunk->end + OGGZ_PAGE_MAX, scan->size);
+  chunk->data_len = (long)(data_end - chunk->start);
+
+  chunk->data = oggz_malloc (chunk->data_len);
+  if (chunk->data == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  remaining = oggz_scan_read_at (scan, chunk->data, chunk->data_len,
+                                 chunk->start, &chunk->reads);
+  if (remaining < 0) return (int)remaining;
+
+  /* If the input shrank, treat what was read as the end of it */
+  chunk->data_len -= remaining;
+
+  return oggz_scan_frame (scan, chunk, 0);
+}
+
+static void
+oggz_scan_chunk_free (oggz_scan_chunk_t * chunk)
+{
+  if (chunk->data) oggz_free (chunk->data);
+  if (chunk->pages) oggz_free (chunk->pages);
+  chunk->data = NULL;
+  chunk->pages = NULL;
+}
+
+/*
+ * Check that the pages of a chunk continue from the preceding chunk,
+ * whose last page ends at expected. A chunk which synchronised on a
+ * capture pattern and checksum inside the data of a page is framed
+ * again from expected.
+ *
+ * returns the index of the first page of the chunk to deliver
+ */
+static long
+oggz_scan_align (oggz_scan_t * scan, oggz_scan_chunk_t * chunk,
+                 oggz_off_t expected)
+{
+  long i;
+
+  /* The preceding chunk could not find its next page; take this chunk's
+   * pages as found, as a sequential read resynchronising would */
+  if (expected == -1) return 0;
+
+  /* A page of the preceding chunk covers all of this chunk */
+  if (expected >= chunk->end) return chunk->npages;
+
+  for (i = 0; i < chunk->npages; i++) {
+    if (chunk->start + chunk->pages[i].pos == expected) return i;
+    if (chunk->start + chunk->pages[i].pos > expected) break;
+  }
+
+#ifdef DEBUG
+  printf ("oggz_scan_align: chunk at %" PRI_OGGZ_OFF_T "d misaligned, "
+          "reframing from %" PRI_OGGZ_OFF_T "d\n", chunk->start, expected);
+#endif
+
+  if (oggz_scan_frame (scan, chunk, (long)(expected - chunk->start)) != 0)
+    return -1;
+
+  return 0;
+}
+
+static int
+oggz_scan_deliver_page (OGGZ * oggz, unsigned char * data,
+                        oggz_scan_page_t * page, oggz_off_t offset,
+                        OggzReadPage read_page, void * user_data)
+{
+  oggz_stream_t * stream;
+  ogg_page og;
+  ogg_packet op;
+  long serialno;
+
+  og.header = data + page->pos;
+  og.header_len = page->header_len;
+  og.body = og.header + page->header_len;
+  og.body_len = page->body_len;
+
+  serialno = ogg_page_serialno (&og);
+
+  if ((stream = oggz_get_stream (oggz, serialno)) == NULL) {
+    if ((stream = oggz_add_stream (oggz, serialno)) == NULL)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+
+    oggz_auto_identify_page (oggz, &og, serialno);
+
+    if (oggz->flags & OGGZ_AUTO) {
+      oggz_auto_read_bos_page (oggz, &og, serialno, NULL);
+
+      /* A bos page holds only the bos packet */
+      if (ogg_page_bos (&og) && ogg_page_packets (&og) == 1) {
+        op.packet = og.body;
+        op.bytes = og.body_len;
+        op.b_o_s = 1;
+        op.e_o_s = ogg_page_eos (&og);
+        op.granulepos = ogg_page_granulepos (&og);
+        op.packetno = 0;
+        oggz_auto_read_bos_packet (oggz, &op, serialno, NULL);
+      }
+    }
+  }
+
+  oggz->offset = offset;
+  OGGZ_STATS_ADD (oggz, pages_read, 1);
+
+  return read_page (oggz, &og, serialno, user_data);
+}
+
+/*
+ * Pass the pages of a chunk to the callback, and return the offset of
+ * the page following them, or a negative error.
+ */
+static oggz_off_t
+oggz_scan_deliver (oggz_scan_t * scan, oggz_scan_chunk_t * chunk,
+                   oggz_off_t expected, OggzReadPage read_page,
+                   void * user_data, long * npages)
+{
+  long i;
+  int cb_ret;
+
+  if ((i = oggz_scan_align (scan, chunk, expected)) < 0)
+    return OGGZ_ERR_OUT_OF_MEMORY;
+
+  if (i == chunk->npages && expected >= chunk->end) return expected;
+
+  for (; i < chunk->npages; i++) {
+    cb_ret = oggz_scan_deliver_page (scan->oggz, chunk->data,
+                                     &chunk->pages[i],
+                                     chunk->start + chunk->pages[i].pos,
+                                     read_page, user_data);
+    if (cb_ret != OGGZ_CONTINUE)
+      return oggz_map_return_value_to_error (cb_ret);
+    (*npages)++;
+  }
+
+  return chunk->next;
+}
+
+#ifdef OGGZ_SCAN_THREADS
+static void *
+oggz_scan_worker (void * arg)
+{
+  oggz_scan_t * scan = (oggz_scan_t *)arg;
+  oggz_scan_chunk_t * chunk;
+  int err;
+
+  pthread_mutex_lock (&scan->mutex);
+
+  while (!scan->abort && scan->next_chunk < scan->nchunks) {
+    /* Don't read too far ahead of delivery */
+    if (scan->next_chunk - scan->delivered >= scan->window) {
+      pthread_cond_wait (&scan->cond, &scan->mutex);
+      continue;
+    }
+
+    chunk = &scan->chunks[scan->next_chunk++];
+    pthread_mutex_unlock (&scan->mutex);
+
+    err = oggz_scan_chunk (scan, chunk);
+
+    pthread_mutex_lock (&scan->mutex);
+    chunk->error = err;
+    chunk->done = 1;
+    pthread_cond_broadcast (&scan->cond);
+  }
+
+  pthread_mutex_unlock (&scan->mutex);
+
+  return NULL;
+}
+#endif
+
+static oggz_off_t
+oggz_scan_get_size (OGGZ * oggz, int * fd)
+{
+  struct stat statbuf;
+  long saved, size;
+
+  *fd = -1;
+
+  if (oggz->file != NULL) {
+    if (fstat (fileno (oggz->file), &statbuf) == -1) return OGGZ_ERR_SYSTEM;
+    if (!S_ISREG (statbuf.st_mode)) return OGGZ_ERR_NOSEEK;
+    *fd = fileno (oggz->file);
+    return statbuf.st_size;
+  }
+
+  if ((saved = oggz_io_tell (oggz)) == -1) return OGGZ_ERR_NOSEEK;
+  if (oggz_io_seek (oggz, 0, SEEK_END) != 0) return OGGZ_ERR_NOSEEK;
+  size = oggz_io_tell (oggz);
+  if (oggz_io_seek (oggz, saved, SEEK_SET) != 0) return OGGZ_ERR_SYSTEM;
+
+  return size == -1 ? OGGZ_ERR_NOSEEK : size;
+}
+
+long
+oggz_scan_pages (OGGZ * oggz, int nthreads, OggzReadPage read_page,
+                 void * user_data)
+{
+  oggz_scan_t scan;
+  oggz_scan_chunk_t * chunk;
+  oggz_off_t offset_saved, expected = 0, chunk_size;
+  long io_saved = -1, npages = 0, i;
+  int err = 0;
+#ifdef OGGZ_SCAN_THREADS
+  pthread_t * threads = NULL;
+  int nstarted = 0;
+#endif
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if (read_page == NULL) return OGGZ_ERR_INVALID;
+
+  memset (&scan, 0, sizeof (scan));
+  scan.oggz = oggz;
+
+  if ((scan.size = oggz_scan_get_size (oggz, &scan.fd)) < 0)
+    return (long)scan.size;
+
+#ifdef HAVE_PREAD
+  if (scan.fd == -1)
+#endif
+  {
+    nthreads = 1;
+    scan.fd = -1;
+    io_saved = oggz_io_tell (oggz);
+  }
+
+#ifndef OGGZ_SCAN_THREADS
+  nthreads = 1;
+#endif
+
+  if (nthreads < 1) nthreads = 1;
+
+  chunk_size = scan.size / (nthreads * 4);
+  if (chunk_size < OGGZ_SCAN_CHUNK_MIN) chunk_size = OGGZ_SCAN_CHUNK_MIN;
+  if (chunk_size > OGGZ_SCAN_CHUNK_MAX) chunk_size = OGGZ_SCAN_CHUNK_MAX;
+
+  scan.nchunks = (long)((scan.size + chunk_size - 1) / chunk_size);
+  if (scan.nchunks == 0) return 0;
+
+  scan.chunks = oggz_malloc (scan.nchunks * sizeof (oggz_scan_chunk_t));
+  if (scan.chunks == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+  memset (scan.chunks, 0, scan.nchunks * sizeof (oggz_scan_chunk_t));
+
+  for (i = 0; i < scan.nchunks; i++) {
+    scan.chunks[i].start = i * chunk_size;
+    scan.chunks[i].end = MIN ((i+1) * chunk_size, scan.size);
+  }
+
+  scan.window = nthreads * 2;
+  offset_saved = oggz->offset;
+
+#ifdef OGGZ_SCAN_THREADS
+  if (nthreads > 1) {
+    threads = oggz_malloc (nthreads * sizeof (pthread_t));
+  }
+
+  if (threads != NULL) {
+    pthread_mutex_init (&scan.mutex, NULL);
+    pthread_cond_init (&scan.cond, NULL);
+
+    for (nstarted = 0; nstarted < nthreads; nstarted++) {
+      if (pthread_create (&threads[nstarted], NULL, oggz_scan_worker,
+                          &scan) != 0)
+        break;
+    }
+  }
+
+  /* Scan in this thread if no worker could be started */
+  if (nstarted == 0) nthreads = 1;
+#endif
+
+  for (i = 0; err == 0 && i < scan.nchunks; i++) {
+    chunk = &scan.chunks[i];
+
+#ifdef OGGZ_SCAN_THREADS
+    if (nthreads > 1) {
+      pthread_mutex_lock (&scan.mutex);
+      while (!chunk->done) pthread_cond_wait (&scan.cond, &scan.mutex);
+      pthread_mutex_unlock (&scan.mutex);
+    } else
+#endif
+    {
+      chunk->error = oggz_scan_chunk (&scan, chunk);
+    }
+
+    if ((err = chunk->error) == 0) {
+      /* Reads through oggz_io are counted there */
+      if (scan.fd != -1) {
+        OGGZ_STATS_ADD (oggz, io_reads, chunk->reads);
+        OGGZ_STATS_ADD (oggz, bytes_read, chunk->data_len);
+      }
+
+      expected = oggz_scan_deliver (&scan, chunk, expected, read_page,
+                                    user_data, &npages);
+      if (expected < -1) err = (int)expected;
+    }
+
+    oggz_scan_chunk_free (chunk);
+
+#ifdef OGGZ_SCAN_THREADS
+    if (nthreads > 1) {
+      pthread_mutex_lock (&scan.mutex);
+      scan.delivered = i+1;
+      if (err != 0) scan.abort = 1;
+      pthread_cond_broadcast (&scan.cond);
+      pthread_mutex_unlock (&scan.mutex);
+    }
+#endif
+  }
+
+#ifdef OGGZ_SCAN_THREADS
+  if (threads != NULL) {
+    pthread_mutex_lock (&scan.mutex);
+    scan.abort = 1;
+    pthread_cond_broadcast (&scan.cond);
+    pthread_mutex_unlock (&scan.mutex);
+
+    while (nstarted > 0) pthread_join (threads[--nstarted], NULL);
+
+    pthread_cond_destroy (&scan.cond);
+    pthread_mutex_destroy (&scan.mutex);
+    oggz_free (threads);
+  }
+#endif
+
+  for (i = 0; i < scan.nchunks; i++)
+    oggz_scan_chunk_free (&scan.chunks[i]);
+  oggz_free (scan.chunks);
+
+  oggz->offset = offset_saved;
+  if (io_saved != -1) oggz_io_seek (oggz, io_saved, SEEK_SET);
+
+  return err ? err : npages;
+}
+
+#else /* OGGZ_CONFIG_READ */
+
+#include <ogg/ogg.h>
+#include "oggz_private.h"
+
+long
+oggz_scan_pages (OGGZ * oggz, int nthreads, OggzReadPage read_page,
+                 void * user_data)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+#endif
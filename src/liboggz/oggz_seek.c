@@ -65,6 +65,19 @@
 
 #define CHUNKSIZE 4096
 
+/* Limits on the size of seek probe reads */
+#define OGGZ_SEEK_PROBE_MIN CHUNKSIZE
+#define OGGZ_SEEK_PROBE_MAX 65536
+
+/* Probe data kept for later probes to land in */
+#define OGGZ_SEEK_KEEP (4 * OGGZ_SEEK_PROBE_MAX)
+
+/* Distance beyond which a search back for a page bisects rather than walks */
+#define OGGZ_SEEK_WALK_MAX (4 * OGGZ_SEEK_PROBE_MAX)
+
+/* Most pages kept in the packet index of a stream; a power of two */
+#define OGGZ_INDEX_MAX 4096
+
 /*
  * The typical usage is:
  *
@@ -98,7 +111,11 @@ oggz_tell_raw (OGGZ * oggz)
 
 int
 oggz_seek_reset_stream(void *data) {
-  ((oggz_stream_t *)data)->last_granulepos = -1L;
+  oggz_stream_t * stream = (oggz_stream_t *)data;
+
+  stream->last_granulepos = -1L;
+  stream->index_next_pageno = -1;
+  stream->seek_packetno = -1;
   return 0;
 }
 
@@ -116,7 +133,11 @@ oggz_seek_raw (OGGZ * oggz, oggz_off_t offset, int whence)
 
   oggz->offset = offset_at;
 
-  ogg_sync_reset (&reader->ogg_sync);
+  oggz_sync_reset (&reader->sync, offset_at);
+  reader->current_page_bytes = 0;
+
+  /* The io position no longer follows the last seek probe */
+  reader->seek_io_offset = -1;
 
   oggz_vector_foreach(oggz->streams, oggz_seek_reset_stream);
   
@@ -188,376 +209,943 @@ oggz_purge (OGGZ * oggz)
 }
 
 /*
- * oggz_get_next_page (oggz, og, do_read)
+ * Packet index.
+ *
+ * Each stream keeps an index of the pages on which its packets begin,
+ * collected as pages are read in sequence from its bos page and
+ * extended by oggz_seek_packets() as needed. Packet counts depend on
+ * every earlier page, so a page is only indexed if it directly follows
+ * the last one indexed, which is checked by its page sequence number.
+ *
+ * Only handles which can seek keep an index. It holds at most
+ * OGGZ_INDEX_MAX pages: when full, every other page is dropped, and
+ * from then on only every index_stride'th page on which a packet begins
+ * is kept. Seeking then lands on an earlier page and skips packets.
+ */
+
+static int
+oggz_index_clear (void * data)
+{
+  oggz_stream_t * stream = (oggz_stream_t *) data;
+
+  if (stream->index != NULL) oggz_free (stream->index);
+
+  stream->index = NULL;
+  stream->index_nr = 0;
+  stream->index_max = 0;
+  stream->index_stride = 1;
+  stream->index_candidates = 0;
+  stream->index_end_pageno = -1;
+  stream->index_end_offset = 0;
+  stream->index_end_packets = 0;
+  stream->index_eos = 0;
+
+  if (stream->index_next_pageno >= 0) stream->index_next_pageno = -1;
+
+  return 0;
+}
+
+/*
+ * Index a page of a stream, if it is the next page following the index.
+ * returns 0 on success, -1 if the page does not follow the index
+ */
+static int
+oggz_index_append (OGGZ * oggz, oggz_stream_t * stream, const ogg_page * og,
+                   oggz_off_t offset)
+{
+  oggz_packet_index_t * new_index, * entry;
+  long pageno, new_max;
+  int nsegs, segment = 0, packets = 0, i;
+
+  if (stream->index_eos) return -1;
+
+  pageno = ogg_page_pageno ((ogg_page *)og);
+
+  if (stream->index_end_pageno == -1) {
+    if (!ogg_page_bos ((ogg_page *)og)) return -1;
+  } else if (pageno != stream->index_end_pageno ||
+             offset < stream->index_end_offset) {
+    return -1;
+  }
+
+  nsegs = og->header[26];
+
+  /* Skip the end of a packet continued from the previous page */
+  if (ogg_page_continued ((ogg_page *)og)) {
+    while (segment < nsegs && og->header[27+segment] == 255) segment++;
+    segment++;
+  }
+
+  for (i = 0; i < nsegs; i++) {
+    if (og->header[27+i] < 255) packets++;
+  }
+
+  if (segment < nsegs && stream->index_nr == OGGZ_INDEX_MAX) {
+    /* Keep every other page; their candidate numbers are multiples of
+     * the doubled stride */
+    for (i = 1; i < OGGZ_INDEX_MAX / 2; i++)
+      stream->index[i] = stream->index[2*i];
+    stream->index_nr = OGGZ_INDEX_MAX / 2;
+    stream->index_stride *= 2;
+    OGGZ_STATS_ADD (oggz, index_entries, -(OGGZ_INDEX_MAX / 2));
+  }
+
+  if (segment < nsegs &&
+      stream->index_candidates++ % stream->index_stride == 0) {
+    if (stream->index_nr == stream->index_max) {
+      new_max = stream->index_max ? stream->index_max * 2 : 64;
+      new_index = oggz_realloc (stream->index,
+                                new_max * sizeof (oggz_packet_index_t));
+      if (new_index == NULL) return -1;
+      stream->index = new_index;
+      stream->index_max = new_max;
+    }
+
+    entry = &stream->index[stream->index_nr++];
+    entry->offset = offset;
+    entry->packetno = stream->index_end_packets + (segment > 0 ? 1 : 0);
+    entry->pageno = pageno;
+    entry->segment = segment;
+    OGGZ_STATS_ADD (oggz, index_entries, 1);
+  }
+
+  stream->index_end_pageno = pageno + 1;
+  stream->index_end_offset = offset + og->header_len + og->body_len;
+  stream->index_end_packets += packets;
+
+  if (ogg_page_eos ((ogg_page *)og)) stream->index_eos = 1;
+
+  return 0;
+}
+
+/*
+ * Find the indexed page at offset.
+ */
+static oggz_packet_index_t *
+oggz_index_lookup_offset (oggz_stream_t * stream, oggz_off_t offset)
+{
+  long lo = 0, hi = stream->index_nr - 1, mid;
+
+  while (lo <= hi) {
+    mid = lo + (hi - lo) / 2;
+    if (stream->index[mid].offset == offset)
+      return &stream->index[mid];
+    else if (stream->index[mid].offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+
+  return NULL;
+}
+
+/*
+ * Find the indexed page on which packet packetno begins, ie. the last
+ * indexed page on which an earlier or the same packet begins.
+ */
+static oggz_packet_index_t *
+oggz_index_lookup_packet (oggz_stream_t * stream, ogg_int64_t packetno)
+{
+  long lo = 0, hi = stream->index_nr - 1, mid;
+
+  if (stream->index_nr == 0 || stream->index[0].packetno > packetno)
+    return NULL;
+
+  while (lo < hi) {
+    mid = hi - (hi - lo) / 2;
+    if (stream->index[mid].packetno <= packetno)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  return &stream->index[lo];
+}
+
+static int
+oggz_index_seekable (OGGZ * oggz)
+{
+  return (oggz->file != NULL || (oggz->io != NULL && oggz->io->seek != NULL));
+}
+
+/*
+ * Index a page as it is read, following the reader's position.
+ * returns the number of packets of the stream completed before this
+ * page if the reader has found its place in the index again on this
+ * page after seeking, or -1 otherwise.
+ */
+ogg_int64_t
+oggz_index_read_page (OGGZ * oggz, oggz_stream_t * stream,
+                      const ogg_page * og, oggz_off_t offset)
+{
+  oggz_packet_index_t * entry;
+  ogg_int64_t packets = -1;
+  long pageno;
+
+  pageno = ogg_page_pageno ((ogg_page *)og);
+
+  if (stream->index_next_pageno == -1) {
+    if ((entry = oggz_index_lookup_offset (stream, offset)) != NULL) {
+      packets = entry->packetno - (entry->segment > 0 ? 1 : 0);
+    } else if (pageno == stream->index_end_pageno &&
+               offset >= stream->index_end_offset) {
+      packets = stream->index_end_packets;
+    } else if (stream->index_end_pageno == -1 &&
+               ogg_page_bos ((ogg_page *)og)) {
+      packets = 0;
+    } else {
+      /* Not indexed, or dropped from a sparse index; lose count until
+       * the next seek rather than picking it up part way through */
+      stream->index_next_pageno = -2;
+      return -1;
+    }
+  } else if (pageno != stream->index_next_pageno) {
+    /* Pages are missing; lose count until the next seek */
+    stream->index_next_pageno = -2;
+    return -1;
+  }
+
+  /* An index is no use if the input cannot seek, eg. a live stream */
+  if ((pageno == stream->index_end_pageno || stream->index_end_pageno == -1)
+      && oggz_index_seekable (oggz))
+    oggz_index_append (oggz, stream, og, offset);
+
+  stream->index_next_pageno = pageno + 1;
+
+  return packets;
+}
+
+/*
+ * Seek probes.
+ *
+ * Pages are located during a seek by reading through reader->seek_sync,
+ * which is kept apart from the sync state used for demuxing. Data read
+ * for one probe is kept and reused by later probes which land inside it,
+ * and every page found is remembered in reader->seek_cache, so that
+ * seeking repeatedly around the same point need not do any I/O.
+ */
+
+void
+oggz_seek_cache_clear (OGGZ * oggz)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  memset (reader->seek_cache, 0, sizeof (reader->seek_cache));
+  reader->seek_cache_next = 0;
+
+  memset (&reader->seek_last_page, 0, sizeof (reader->seek_last_page));
+  reader->seek_last_size = -1;
+
+  oggz_sync_reset (&reader->seek_sync, 0);
+  reader->seek_sync.keep = OGGZ_SEEK_KEEP;
+
+  oggz_vector_foreach (oggz->streams, oggz_index_clear);
+  OGGZ_STATS_SET (oggz, index_entries, 0);
+}
+
+static oggz_seek_page_t *
+oggz_seek_cache_lookup (OggzReader * reader, oggz_off_t offset)
+{
+  oggz_seek_page_t * page;
+  int i;
+
+  for (i = 0; i < OGGZ_SEEK_CACHE_SIZE; i++) {
+    page = &reader->seek_cache[i];
+    if (page->bytes > 0 &&
+        page->gap_start <= offset && offset <= page->offset)
+      return page;
+  }
+
+  return NULL;
+}
+
+static void
+oggz_seek_cache_add (OggzReader * reader, oggz_seek_page_t * page)
+{
+  oggz_seek_page_t * cached;
+  int i;
+
+  for (i = 0; i < OGGZ_SEEK_CACHE_SIZE; i++) {
+    cached = &reader->seek_cache[i];
+    if (cached->bytes > 0 && cached->offset == page->offset) {
+      /* Already known; widen the known gap before it */
+      if (page->gap_start < cached->gap_start)
+        cached->gap_start = page->gap_start;
+      return;
+    }
+  }
+
+  reader->seek_cache[reader->seek_cache_next] = *page;
+  reader->seek_cache_next =
+    (reader->seek_cache_next + 1) % OGGZ_SEEK_CACHE_SIZE;
+}
+
+/*
+ * Begin a seek. Record the io position so that the reader can continue
+ * undisturbed if the seek fails.
+ */
+static oggz_off_t
+oggz_seek_probe_begin (OGGZ * oggz)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  reader->seek_io_offset = -1;
+  reader->seek_read_size = OGGZ_SEEK_PROBE_MIN;
+
+  return oggz_tell_raw (oggz);
+}
+
+static int
+oggz_seek_probe_abort (OGGZ * oggz, oggz_off_t io_offset)
+{
+  OggzReader * reader = &oggz->x.reader;
+
+  if (io_offset == -1) return -1;
+
+  if (reader->seek_io_offset != io_offset) {
+    if (oggz_io_seek (oggz, io_offset, SEEK_SET) == -1) return -1;
+  }
+
+  reader->seek_io_offset = -1;
+
+  return 0;
+}
+
+/*
+ * Scale the size of probe reads with the width of the search interval:
+ * early bisection steps are far apart and can afford larger reads,
+ * which then often contain the pages needed by later steps.
+ */
+static void
+oggz_seek_probe_size (OGGZ * oggz, oggz_off_t interval)
+{
+  OggzReader * reader = &oggz->x.reader;
+  oggz_off_t size = interval / 16;
+
+  if (size < OGGZ_SEEK_PROBE_MIN) size = OGGZ_SEEK_PROBE_MIN;
+  if (size > OGGZ_SEEK_PROBE_MAX) size = OGGZ_SEEK_PROBE_MAX;
+
+  reader->seek_read_size = (long)size;
+}
+
+static long
+oggz_seek_probe_read (OGGZ * oggz, long size)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzSync * sync = &reader->seek_sync;
+  oggz_off_t offset_end;
+  unsigned char * buffer;
+  long bytes;
+
+  offset_end = sync->offset + sync->fill;
+
+  if (reader->seek_io_offset != offset_end) {
+    if (oggz_io_seek (oggz, offset_end, SEEK_SET) == -1) return -1;
+    reader->seek_io_offset = offset_end;
+  }
+
+  if ((buffer = oggz_sync_buffer (sync, size)) == NULL) return -1;
+
+  bytes = (long) oggz_io_read (oggz, buffer, size);
+
+  if (bytes == OGGZ_ERR_SYSTEM) {
+    reader->seek_io_offset = -1;
+    return -1;
+  }
+
+  if (bytes <= 0) {
+    if (oggz->file && feof (oggz->file)) clearerr (oggz->file);
+    return 0;
+  }
+
+  oggz_sync_wrote (sync, bytes);
+  reader->seek_io_offset += bytes;
+  reader->seek_reads++;
+  OGGZ_STATS_ADD (oggz, seek_reads, 1);
+
+  return bytes;
+}
+
+static oggz_seek_page_t *
+oggz_seek_cache_lookup_prev (OggzReader * reader, oggz_off_t offset)
+{
+  oggz_seek_page_t * page;
+  int i;
+
+  for (i = 0; i < OGGZ_SEEK_CACHE_SIZE; i++) {
+    page = &reader->seek_cache[i];
+    if (page->bytes > 0 && page->offset + page->bytes == offset)
+      return page;
+  }
+
+  return NULL;
+}
+
+/*
+ * Extend the probe buffer back to offset or earlier when it begins within
+ * [offset, offset_stop], so that searching backwards reads only data
+ * not already held.
+ * returns 0 if the probe buffer now covers offset, -1 otherwise
+ */
+static int
+oggz_seek_probe_read_front (OGGZ * oggz, oggz_off_t offset,
+                            oggz_off_t offset_stop)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzSync * sync = &reader->seek_sync;
+  unsigned char * buffer;
+  long size, bytes;
+
+  if (sync->fill == 0 || offset >= sync->offset || sync->offset > offset_stop)
+    return -1;
+
+  /* Read back at least a full probe, as further steps back may follow */
+  if (sync->offset - offset < reader->seek_read_size)
+    offset = sync->offset - reader->seek_read_size;
+  if (offset < 0) offset = 0;
+
+  size = (long)(sync->offset - offset);
+  if (sync->fill + size > sync->keep) return -1;
+
+  if ((buffer = oggz_sync_buffer_front (sync, size)) == NULL) return -1;
+
+  reader->seek_io_offset = -1;
+  if (oggz_io_seek (oggz, offset, SEEK_SET) == -1) {
+    oggz_sync_reset (sync, offset);
+    return -1;
+  }
+
+  bytes = (long) oggz_io_read (oggz, buffer, size);
+  reader->seek_reads++;
+  OGGZ_STATS_ADD (oggz, seek_reads, 1);
+
+  if (bytes != size) {
+    oggz_sync_reset (sync, offset);
+    return -1;
+  }
+
+  reader->seek_io_offset = offset + size;
+
+  return 0;
+}
+
+/*
+ * oggz_seek_probe_sync_page (oggz, offset, page, og, chained)
  *
- * retrieves the next page.
+ * Find the first page starting at or after offset, reading as needed.
+ * The page itself is returned in og, which remains valid until the
+ * next probe.
+ * If chained is set, offset is known to be the end of a page which has
+ * already been verified, so a page found exactly there without a
+ * granulepos is taken on the strength of its capture pattern without
+ * checking its CRC; the reader checks it again in any case if it is read.
+ * A page with a granulepos is always checked, as its granulepos steers
+ * the seek and may be kept as the reader's position.
  * returns >= 0 if found; return value is offset of page start
  * returns -1 on error
  * returns -2 if EOF was encountered
  */
+/* Whether the page at the sync position is known to have no granulepos */
+static int
+oggz_seek_sync_no_granulepos (OggzSync * sync)
+{
+  const unsigned char * header = sync->data + sync->returned;
+  int i;
+
+  if (sync->fill - sync->returned < 14) return 0;
+
+  for (i = 6; i < 14; i++)
+    if (header[i] != 0xff) return 0;
+
+  return 1;
+}
+
 static oggz_off_t
-oggz_get_next_page (OGGZ * oggz, ogg_page * og)
+oggz_seek_probe_sync_page (OGGZ * oggz, oggz_off_t offset,
+                           oggz_seek_page_t * page, ogg_page * og,
+                           int chained)
 {
   OggzReader * reader = &oggz->x.reader;
-  char * buffer;
-  long bytes = 0, more;
-  oggz_off_t page_offset = 0, ret;
-  int found = 0;
+  OggzSync * sync = &reader->seek_sync;
+  long more, bytes, size;
+  int verify_crc;
 
-  do {
-    more = ogg_sync_pageseek (&reader->ogg_sync, og);
+  if (oggz_sync_seek (sync, offset) == -1)
+    oggz_sync_reset (sync, offset);
 
-    if (more == 0) {
-      page_offset = 0;
+  size = reader->seek_read_size;
 
-      buffer = ogg_sync_buffer (&reader->ogg_sync, CHUNKSIZE);
-      if ((bytes = (long) oggz_io_read (oggz, buffer, CHUNKSIZE)) == 0) {
-	if (oggz->file && feof (oggz->file)) {
-#ifdef DEBUG_VERBOSE
-	  printf ("get_next_page: feof (oggz->file), returning -2\n");
-#endif
-	  clearerr (oggz->file);
-	  return -2;
-	}
-      }
-      if (bytes == OGGZ_ERR_SYSTEM) {
-	  /*oggz_set_error (oggz, OGGZ_ERR_SYSTEM);*/
-	  return -1;
-      }
+  for ( ; ; ) {
+    verify_crc = !(oggz->flags & OGGZ_NOCRC) &&
+      !(chained && sync->offset + sync->returned == offset &&
+        oggz_seek_sync_no_granulepos (sync));
+
+    if ((more = oggz_sync_pageseek (sync, og, verify_crc)) > 0) break;
 
+    if (more == 0) {
+      if ((bytes = oggz_seek_probe_read (oggz, size)) < 0) return -1;
       if (bytes == 0) {
 #ifdef DEBUG_VERBOSE
-	printf ("get_next_page: bytes == 0, returning -2\n");
+        printf ("oggz_seek_probe_scan: EOF after @%" PRI_OGGZ_OFF_T "d\n",
+                offset);
 #endif
-	return -2;
+        return -2;
       }
 
-      ogg_sync_wrote(&reader->ogg_sync, bytes);
-
-    } else if (more < 0) {
-#ifdef DEBUG_VERBOSE
-      printf ("get_next_page: skipped %ld bytes\n", -more);
-#endif
-      page_offset -= more;
-    } else {
-#ifdef DEBUG_VERBOSE
-      printf ("get_next_page: page has %ld bytes\n", more);
-#endif
-      found = 1;
+      /* Grow reads within a probe, eg. when landing amongst large pages */
+      if (size < OGGZ_SEEK_PROBE_MAX) size *= 2;
     }
+  }
 
-  } while (!found);
+  OGGZ_STATS_ADD (oggz, pages_read, 1);
 
-  /* Calculate the byte offset of the page which was found */
-  if (bytes > 0) {
-    oggz->offset = oggz_tell_raw (oggz) - bytes + page_offset;
-  } else {
-    /* didn't need to do any reading -- accumulate the page_offset */
-    oggz->offset += page_offset;
+  page->gap_start = offset;
+  page->offset = sync->offset + (og->header - sync->data);
+  page->bytes = more;
+  page->serialno = ogg_page_serialno (og);
+  page->granulepos = ogg_page_granulepos (og);
+
+  return page->offset;
+}
+
+static oggz_off_t
+oggz_seek_probe_scan_page (OGGZ * oggz, oggz_off_t offset,
+                           oggz_seek_page_t * page, ogg_page * og)
+{
+  return oggz_seek_probe_sync_page (oggz, offset, page, og, 0);
+}
+
+static oggz_off_t
+oggz_seek_probe_scan (OGGZ * oggz, oggz_off_t offset, oggz_seek_page_t * page)
+{
+  ogg_page og;
+
+  return oggz_seek_probe_scan_page (oggz, offset, page, &og);
+}
+
+/*
+ * As oggz_seek_probe_scan(), but answer from and remember pages in
+ * the seek cache.
+ */
+static oggz_off_t
+oggz_seek_probe_page (OGGZ * oggz, oggz_off_t offset, oggz_seek_page_t * page)
+{
+  OggzReader * reader = &oggz->x.reader;
+  oggz_seek_page_t * cached;
+  oggz_off_t page_offset;
+
+  if ((cached = oggz_seek_cache_lookup (reader, offset)) != NULL) {
+    *page = *cached;
+    return page->offset;
   }
-  
-  ret = oggz->offset + more;
 
-  return ret;
+  page_offset = oggz_seek_probe_scan (oggz, offset, page);
+  if (page_offset >= 0)
+    oggz_seek_cache_add (reader, page);
+
+  return page_offset;
 }
 
+/*
+ * Find the first page starting at or after offset on which a packet
+ * finishes, ie. which has a granulepos.
+ */
 static oggz_off_t
-oggz_get_next_start_page (OGGZ * oggz, ogg_page * og)
+oggz_seek_probe_start_page (OGGZ * oggz, oggz_off_t offset,
+                            oggz_seek_page_t * page)
 {
   oggz_off_t page_offset;
-  int found = 0;
 
-  do {
-    page_offset = oggz_get_next_page (oggz, og);
+  for ( ; ; ) {
+    page_offset = oggz_seek_probe_page (oggz, offset, page);
 
     /* Return this value if one of the following conditions is met:
      *
      *   page_offset < 0     : error or EOF
      *   page_offset == 0    : start of stream
-     *   !ogg_page_continued : page contains start of a packet
-     *   ogg_page_packets > 1: page contains start of a packet
+     *   granulepos > -1     : a packet finishes on this page
      */
-    /*if (page_offset <= 0 || !ogg_page_continued (og) ||
-	ogg_page_packets (og) > 1)*/
-    if (page_offset <= 0 || ogg_page_granulepos(og) > -1)
-      found = 1;
+    if (page_offset <= 0 || page->granulepos > -1)
+      return page_offset;
+
+    offset = page->offset + page->bytes;
   }
-  while (!found);
+}
 
-  return page_offset;
+static int
+oggz_seek_page_wanted (oggz_seek_page_t * page, long serialno,
+                       ogg_int64_t granulepos_max)
+{
+  if (serialno == -1) {
+    if (page->offset == 0) return 1;
+  } else if (page->serialno != serialno) {
+    return 0;
+  }
+
+  if (page->granulepos == -1) return 0;
+
+  return (granulepos_max == -1 || page->granulepos < granulepos_max);
 }
 
+/*
+ * Find the last page starting before offset_at on which a packet
+ * finishes, searching backwards in growing steps. If serialno is not -1,
+ * only pages of that logical bitstream are considered; if granulepos_max
+ * is not -1, only pages with a granulepos less than it.
+ * returns >= 0 if found; return value is offset of page start
+ * returns -1 if no such page was found, or on error
+ */
 static oggz_off_t
-oggz_get_prev_start_page (OGGZ * oggz, ogg_page * og,
-			 ogg_int64_t * granule, long * serialno)
+oggz_seek_probe_prev_page (OGGZ * oggz, oggz_off_t offset_at, long serialno,
+                           ogg_int64_t granulepos_max,
+                           oggz_seek_page_t * page)
 {
-  oggz_off_t offset_at, offset_start;
-  oggz_off_t page_offset, found_offset = 0;
-  ogg_int64_t unit_at;
-  ogg_int64_t granule_at = -1;
-
-#if 0
-  offset_at = oggz_tell_raw (oggz);
-  if (offset_at == -1) return -1;
-#else
-  offset_at = oggz->offset;
-#endif
+  OggzReader * reader = &oggz->x.reader;
+  oggz_off_t offset_start, offset, page_offset = 0, found_offset = -1;
+  oggz_off_t offset_stop, offset_next_stop;
+  oggz_seek_page_t probe, * cached;
+  long step = reader->seek_read_size, read_size = reader->seek_read_size;
+
+  /* The page just before offset_at may be known from an earlier seek */
+  cached = oggz_seek_cache_lookup_prev (reader, offset_at);
+  if (cached != NULL &&
+      oggz_seek_page_wanted (cached, serialno, granulepos_max)) {
+    *page = *cached;
+    return page->offset;
+  }
 
   offset_start = offset_at;
+  offset_stop = offset_at;
 
-  do {
-
-    offset_start = offset_start - CHUNKSIZE;
+  while (found_offset == -1 && offset_start > 0) {
+    offset_start -= step;
     if (offset_start < 0) offset_start = 0;
+    offset_next_stop = offset_stop;
 
-    offset_start = oggz_seek_raw (oggz, offset_start, SEEK_SET);
-    if (offset_start == -1) return -1;
+    if (step < OGGZ_SEEK_PROBE_MAX) step *= 2;
 
 #ifdef DEBUG
-
-    printf ("get_prev_start_page: [A] offset_at: @%" PRI_OGGZ_OFF_T "d\toffset_start: @%" PRI_OGGZ_OFF_T "d\n",
+    printf ("get_prev_start_page: offset_at: @%" PRI_OGGZ_OFF_T "d\toffset_start: @%" PRI_OGGZ_OFF_T "d\n",
 	    offset_at, offset_start);
-
-    printf ("get_prev_start_page: seeked to %" PRI_OGGZ_OFF_T "d\n", offset_start);
 #endif
 
-    page_offset = 0;
+    /* Fetch each window with a single read, adding to data already
+     * held after it if possible */
+    oggz_seek_probe_size (oggz, (offset_stop - offset_start) * 16);
+    oggz_seek_probe_read_front (oggz, offset_start, offset_stop);
 
-    do {
-      page_offset = oggz_get_next_start_page (oggz, og);
+    /* Walk the pages of this window without caching them all, keeping
+     * the last wanted one. Pages from offset_stop on were seen already. */
+    for (offset = offset_start; offset < offset_stop; ) {
+      page_offset = oggz_seek_probe_scan (oggz, offset, &probe);
       if (page_offset == -1) {
-#ifdef DEBUG
-	printf ("get_prev_start_page: page_offset = -1\n");
-#endif
-	return -1;
+        found_offset = -1;
+        break;
       }
-      if (page_offset == -2) {
-#ifdef DEBUG
-	printf ("*** get_prev_start_page: page_offset = -2\n");
-#endif
-	break;
-      }
-
-      granule_at = ogg_page_granulepos (og);
+      if (page_offset == -2 || page_offset >= offset_stop) break;
 
-#ifdef DEBUG_VERBOSE
-      printf ("get_prev_start_page: GOT page (%lld) @%" PRI_OGGZ_OFF_T "d\tat @%" PRI_OGGZ_OFF_T  "d\n",
-	      granule_at, page_offset, offset_at);
-#endif
+      if (offset == offset_start) offset_next_stop = page_offset;
 
-      /* Need to stash the granule and serialno of this page because og
-       * will be overwritten by the time we realise this was the desired
-       * prev page */
-      if (page_offset >= 0 && page_offset < offset_at) {
-	found_offset = page_offset;
-	*granule = granule_at;
-	*serialno = ogg_page_serialno (og);
+      if (oggz_seek_page_wanted (&probe, serialno, granulepos_max)) {
+        found_offset = page_offset;
+        *page = probe;
       }
 
-    } while (page_offset >= 0 && page_offset < offset_at);
+      offset = probe.offset + probe.bytes;
+    }
 
-#ifdef DEBUG
-    printf ("get_prev_start_page: [B] offset_at: @%" PRI_OGGZ_OFF_T "d\toffset_start: @%" PRI_OGGZ_OFF_T "d\n"
-	    "found_offset: @%" PRI_OGGZ_OFF_T "d\tpage_offset: @%" PRI_OGGZ_OFF_T "d\n",
-	    offset_at, offset_start, found_offset, page_offset);
-#endif
-    /* reset the file offset */
-    /*offset_at = offset_start;*/
+    offset_stop = offset_next_stop;
+
+    if (page_offset == -1) break;
+  }
 
-  } while (found_offset == 0 && offset_start > 0);
+  reader->seek_read_size = read_size;
 
-  unit_at = oggz_get_unit (oggz, *serialno, *granule);
-  offset_at = oggz_reset (oggz, found_offset, unit_at, SEEK_SET);
+  if (found_offset != -1)
+    oggz_seek_cache_add (reader, page);
 
 #ifdef DEBUG
-    printf ("get_prev_start_page: [C] offset_at: @%" PRI_OGGZ_OFF_T "d\t"
-	    "found_offset: @%" PRI_OGGZ_OFF_T "d\tunit_at: %lld\n",
-	    offset_at, found_offset, unit_at);
+  printf ("get_prev_start_page: found_offset: @%" PRI_OGGZ_OFF_T "d\n",
+          found_offset);
 #endif
 
-  if (offset_at == -1) return -1;
-
-  if (offset_at >= 0)
-    return found_offset;
-  else
-    return -1;
+  return found_offset;
 }
 
 static oggz_off_t
-oggz_scan_for_page (OGGZ * oggz, ogg_page * og, ogg_int64_t unit_target,
-		   oggz_off_t offset_begin, oggz_off_t offset_end)
+oggz_seek_probe_prev_start_page (OGGZ * oggz, oggz_off_t offset_at,
+                                 oggz_seek_page_t * page)
 {
-  oggz_off_t offset_at, offset_next;
-  oggz_off_t offset_prev = -1;
-  ogg_int64_t granule_at;
-  ogg_int64_t unit_at;
-  long serialno;
-
-#ifdef DEBUG
-  printf (" SCANNING from %" PRI_OGGZ_OFF_T "d...", offset_begin);
-#endif
-
-  for ( ; ; ) {
-    offset_at = oggz_seek_raw (oggz, offset_begin, SEEK_SET);
-    if (offset_at == -1) return -1;
-
-#ifdef DEBUG
-    printf (" scan @%" PRI_OGGZ_OFF_T "d\n", offset_at);
-#endif
-
-    offset_next = oggz_get_next_start_page (oggz, og);
-
-    if (offset_next < 0) {
-      return offset_next;
-    }
-
-    if (offset_next == 0 && offset_begin != 0) {
-#ifdef DEBUG
-      printf (" ... scanned past EOF\n");
-#endif
-      return -1;
-    }
-    if (offset_next > offset_end) {
-#ifdef DEBUG
-      printf (" ... scanned to page %ld\n", (long)ogg_page_granulepos (og));
-#endif
+  return oggz_seek_probe_prev_page (oggz, offset_at, -1, -1, page);
+}
 
-#if 0
-      if (offset_prev != -1) {
-	offset_at = oggz_seek_raw (oggz, offset_prev, SEEK_SET);
-	if (offset_at == -1) return -1;
+/*
+ * Find the last page on which a packet finishes in an input of size
+ * offset_end. The answer is remembered until the input changes size;
+ * if it has shrunk, everything remembered about it is discarded.
+ */
+static oggz_off_t
+oggz_seek_probe_last_page (OGGZ * oggz, oggz_off_t offset_end,
+                           oggz_seek_page_t * page)
+{
+  OggzReader * reader = &oggz->x.reader;
+  oggz_off_t page_offset;
 
-	offset_next = oggz_get_next_start_page (oggz, og);
-	if (offset_next < 0) return offset_next;
+  if (reader->seek_last_size == offset_end &&
+      reader->seek_last_page.bytes > 0) {
+    *page = reader->seek_last_page;
+    return page->offset;
+  }
 
-	serialno = ogg_page_serialno (og);
-	granule_at = ogg_page_granulepos (og);
-	unit_at = oggz_get_unit (oggz, serialno, granule_at);
+  if (offset_end < reader->seek_last_size)
+    oggz_seek_cache_clear (oggz);
 
-	return offset_at;
-      } else {
-	return -1;
-      }
-#else
-      serialno = ogg_page_serialno (og);
-      granule_at = ogg_page_granulepos (og);
-      unit_at = oggz_get_unit (oggz, serialno, granule_at);
-      
-      return offset_at;
-#endif
-    }
+  page_offset = oggz_seek_probe_prev_start_page (oggz, offset_end, page);
 
-    offset_at = offset_next;
+  if (page_offset >= 0) {
+    reader->seek_last_page = *page;
+    reader->seek_last_size = offset_end;
+  }
 
-    serialno = ogg_page_serialno (og);
-    granule_at = ogg_page_granulepos (og);
-    unit_at = oggz_get_unit (oggz, serialno, granule_at);
+  return page_offset;
+}
 
-    if (unit_at < unit_target) {
-#ifdef DEBUG
-      printf (" scan: (%lld) < (%lld)\n", unit_at, unit_target);
-#endif
-      offset_prev = offset_next;
-      offset_begin = offset_next+1;
-    } else if (unit_at > unit_target) {
-#ifdef DEBUG
-      printf (" scan: (%lld) > (%lld)\n", unit_at, unit_target);
-#endif
-#if 0
-      /* hole ? */
-      offset_at = oggz_seek_raw (oggz, offset_begin, SEEK_SET);
-      if (offset_at == -1) return -1;
+/*
+ * Position the reader at a page found by seeking. Data remaining in
+ * the probe buffer from that page on is handed over to the reader,
+ * saving a read of data which has already been fetched.
+ */
+static oggz_off_t
+oggz_seek_probe_commit (OGGZ * oggz, oggz_off_t offset, ogg_int64_t unit)
+{
+  OggzReader * reader = &oggz->x.reader;
+  OggzSync * seek_sync = &reader->seek_sync;
+  oggz_off_t offset_at;
+  unsigned char * buffer;
+  long bytes = 0;
 
-      offset_next = oggz_get_next_start_page (oggz, og);
-      if (offset_next < 0) return offset_next;
+  if (oggz_sync_seek (seek_sync, offset) == 0 &&
+      reader->seek_io_offset == seek_sync->offset + seek_sync->fill) {
+    bytes = seek_sync->fill - seek_sync->returned;
+  }
 
-      serialno = ogg_page_serialno (og);
-      granule_at = ogg_page_granulepos (og);
-      unit_at = oggz_get_unit (oggz, serialno, granule_at);
+  oggz_reset_streams (oggz);
 
-      break;
-#else
-      do {
-        offset_at = oggz_get_prev_start_page(oggz, og, &granule_at, &serialno);
-        if (offset_at < 0)
-          break;
-        unit_at = oggz_get_unit(oggz, serialno, granule_at);
-      } while (unit_at > unit_target);
-      return offset_at;
-#endif
-    } else if (unit_at == unit_target) {
-#ifdef DEBUG
-      printf (" scan: (%lld) == (%lld)\n", unit_at, unit_target);
-#endif
-      break;
+  if (bytes > 0) {
+    /* The io position is already at the end of the probe data */
+    oggz->offset = offset;
+    oggz_sync_reset (&reader->sync, offset);
+    reader->current_page_bytes = 0;
+    oggz_vector_foreach (oggz->streams, oggz_seek_reset_stream);
+
+    if ((buffer = oggz_sync_buffer (&reader->sync, bytes)) != NULL) {
+      memcpy (buffer, seek_sync->data + seek_sync->returned, bytes);
+      oggz_sync_wrote (&reader->sync, bytes);
+      reader->seek_io_offset = -1;
+      reader->current_unit = unit;
+      return offset;
     }
   }
 
+  offset_at = oggz_reset_seek (oggz, offset, unit, SEEK_SET);
+
   return offset_at;
 }
 
 #define GUESS_MULTIPLIER (1<<16)
 
+/*
+ * Guess the offset of unit_target within [offset_begin, offset_end] by
+ * interpolating between the units found at each end, ie. a secant step
+ * through the last probes made on either side of the target. An end
+ * which has been left stale by consecutive probes landing on the other
+ * side has its distance from the target halved for each further probe
+ * (the Illinois variant of regula falsi), so that the bracket still
+ * collapses quickly where the bitrate changes sharply within it.
+ */
 static oggz_off_t
-guess (ogg_int64_t unit_at, ogg_int64_t unit_target,
-       ogg_int64_t unit_begin, ogg_int64_t unit_end,
-       oggz_off_t offset_begin, oggz_off_t offset_end)
+oggz_seek_guess (ogg_int64_t unit_target,
+		 ogg_int64_t unit_begin, ogg_int64_t unit_end,
+		 oggz_off_t offset_begin, oggz_off_t offset_end,
+		 int stale_begin, int stale_end)
 {
-  ogg_int64_t guess_ratio;
+  ogg_int64_t below, above, guess_ratio;
   oggz_off_t offset_guess;
 
-  if (unit_at == unit_begin) return offset_begin;
+  if (unit_end <= unit_begin) {
+#ifdef DEBUG
+    printf ("oggz_seek_guess: unit_end <= unit_begin (ERROR)\n");
+#endif
+    return -1;
+  }
+
+  below = unit_target - unit_begin;
+  above = unit_end - unit_target;
+
+  if (stale_begin > 1) below >>= MIN (stale_begin - 1, 16);
+  if (stale_end > 1) above >>= MIN (stale_end - 1, 16);
 
-  if (unit_end != -1) {
-    guess_ratio =
-      GUESS_MULTIPLIER * (unit_target - unit_begin) /
-      (unit_end - unit_begin);
+  if (below + above <= 0) {
+    guess_ratio = GUESS_MULTIPLIER / 2;
   } else {
-    guess_ratio =
-      GUESS_MULTIPLIER * (unit_target - unit_begin) /
-      (unit_at - unit_begin);
+    guess_ratio = GUESS_MULTIPLIER * below / (below + above);
   }
 
-#ifdef DEBUG
-  printf ("oggz_seek::guess: guess_ratio %lld = (%lld - %lld) / (%lld - %lld)\n",
-	  guess_ratio, unit_target, unit_begin, unit_at, unit_begin);
-#endif
-  
   offset_guess = offset_begin +
     (oggz_off_t)(((offset_end - offset_begin) * guess_ratio) /
 		 GUESS_MULTIPLIER);
-  
+
+#ifdef DEBUG
+  printf ("oggz_seek_guess: guess_ratio %lld = %lld / (%lld + %lld), "
+          "guessed %" PRI_OGGZ_OFF_T "d\n",
+          guess_ratio, below, below, above, offset_guess);
+#endif
+
   return offset_guess;
 }
 
+/*
+ * Find the last page of serialno starting before offset_end with a
+ * granulepos less than granulepos_max. Its distance back from offset_end
+ * is estimated from the units at each end of the range. While that is too
+ * far to walk, the range is narrowed by probing at twice the estimated
+ * distance, falling back to halving when the probe overshoots, so that
+ * the final backward search covers only a short distance however far
+ * back the page lies.
+ */
 static oggz_off_t
-oggz_seek_guess (ogg_int64_t unit_at, ogg_int64_t unit_target,
-		 ogg_int64_t unit_begin, ogg_int64_t unit_end,
-		 oggz_off_t offset_at,
-		 oggz_off_t offset_begin, oggz_off_t offset_end)
+oggz_seek_probe_prev_granule (OGGZ * oggz, long serialno,
+                              ogg_int64_t granulepos_max,
+                              oggz_off_t offset_begin, ogg_int64_t unit_begin,
+                              oggz_off_t offset_end, ogg_int64_t unit_end,
+                              oggz_seek_page_t * page)
 {
-  oggz_off_t offset_guess;
+  oggz_seek_page_t probe;
+  oggz_off_t offset_guess, offset, offset_found, distance;
+  ogg_int64_t unit_target;
+  int overshot = 0;
+
+  unit_target = oggz_get_unit (oggz, serialno, granulepos_max);
+
+  while (offset_end - offset_begin > OGGZ_SEEK_WALK_MAX) {
+    if (overshot || unit_end <= unit_begin || unit_target < unit_begin) {
+      offset_guess = offset_begin + (offset_end - offset_begin) / 2;
+    } else {
+      distance = (oggz_off_t)((offset_end - offset_begin) *
+                              (unit_end - unit_target) /
+                              (unit_end - unit_begin));
+      if (2 * distance < OGGZ_SEEK_WALK_MAX) break;
+
+      offset_guess = offset_end - 2 * distance;
+      if (offset_guess <= offset_begin)
+        offset_guess = offset_begin + (offset_end - offset_begin) / 2;
+    }
+
+    OGGZ_STATS_ADD (oggz, seek_iterations, 1);
+    OGGZ_STATS_ADD (oggz, seek_iterations_last, 1);
+
+    /* The first page of this track after the guess */
+    offset_found = -1;
+    for (offset = offset_guess; ; offset = probe.offset + probe.bytes) {
+      if (oggz_seek_probe_page (oggz, offset, &probe) < 0 ||
+          probe.offset >= offset_end)
+        break;
+      if (probe.serialno == serialno && probe.granulepos != -1) {
+        offset_found = probe.offset;
+        break;
+      }
+    }
 
-  if (unit_at == unit_begin) {
-    offset_guess = offset_begin + (offset_end - offset_begin)/2;
-  } else if (unit_end == -1) {
-    offset_guess = guess (unit_at, unit_target, unit_begin, unit_end,
-			  offset_begin, offset_at);
-  } else if (unit_end <= unit_begin) {
 #ifdef DEBUG
-    printf ("oggz_seek_guess: unit_end <= unit_begin (ERROR)\n");
+    printf ("oggz_seek_probe_prev_granule: [@%" PRI_OGGZ_OFF_T "d - @%"
+            PRI_OGGZ_OFF_T "d] guess @%" PRI_OGGZ_OFF_T "d found @%"
+            PRI_OGGZ_OFF_T "d\n",
+            offset_begin, offset_end, offset_guess, offset_found);
 #endif
-    offset_guess = -1;
-  } else {
-    offset_guess = guess (unit_at, unit_target, unit_begin, unit_end,
-			  offset_begin, offset_end);
+
+    if (offset_found == -1) {
+      offset_end = offset_guess;
+      overshot = 1;
+    } else if (probe.granulepos < granulepos_max) {
+      if (offset_found == offset_begin) break;
+      offset_begin = offset_found;
+      unit_begin = oggz_get_unit (oggz, serialno, probe.granulepos);
+      overshot = 0;
+    } else {
+      offset_end = offset_found;
+      unit_end = oggz_get_unit (oggz, serialno, probe.granulepos);
+      overshot = 1;
+    }
   }
 
-#ifdef DEBUG
-    printf ("oggz_seek_guess: guessed %" PRI_OGGZ_OFF_T "d\n", offset_guess);
-#endif
+  return oggz_seek_probe_prev_page (oggz, offset_end, serialno,
+                                    granulepos_max, page);
+}
 
-  return offset_guess;
+/*
+ * Estimate the distance in bytes from the read cursor forward to
+ * unit_target, from the bitrate observed between the start of data and
+ * the read cursor.
+ * returns -1 if no estimate can be made, or if the target is more than
+ * a few times further on than the data read so far
+ */
+static oggz_off_t
+oggz_seek_forward_distance (OGGZ * oggz, ogg_int64_t unit_target)
+{
+  OggzReader * reader = &oggz->x.reader;
+  ogg_int64_t unit_at = reader->current_unit, ratio;
+  oggz_off_t bytes;
+
+  bytes = oggz->offset - oggz->offset_data_begin;
+  if (unit_at <= 0 || bytes <= 0 || unit_target <= unit_at) return -1;
+
+  if (unit_target - unit_at > 16 * unit_at) return -1;
+
+  ratio = GUESS_MULTIPLIER * (unit_target - unit_at) / unit_at;
+
+  return (oggz_off_t)((bytes * ratio) / GUESS_MULTIPLIER);
+}
+
+/*
+ * Read forward from offset_start for the latest page ending at or before
+ * unit_target, stopping at the first page which ends beyond it. This is
+ * cheaper than bisecting for short distances, as a single read covers
+ * many pages. offset_found and unit_found give the best page known so
+ * far, or -1.
+ * returns >= 0 if found; return value is offset of page start, and its
+ * unit is returned in unit_found
+ * returns -1 if no page ending beyond the target was found before
+ * offset_max, or if no page at or before it was found
+ */
+static oggz_off_t
+oggz_seek_probe_forward (OGGZ * oggz, oggz_off_t offset_start,
+                         oggz_off_t offset_max, ogg_int64_t unit_target,
+                         oggz_off_t offset_found, ogg_int64_t * unit_found)
+{
+  oggz_seek_page_t probe;
+  ogg_page og;
+  oggz_off_t offset;
+  ogg_int64_t unit;
+
+  for (offset = offset_start; ; offset = probe.offset + probe.bytes) {
+    if (oggz_seek_probe_sync_page (oggz, offset, &probe, &og,
+                                   offset != offset_start) < 0 ||
+        probe.offset >= offset_max)
+      return -1;
+
+    if (probe.granulepos == -1) continue;
+
+    unit = oggz_get_unit (oggz, probe.serialno, probe.granulepos);
+    if (unit == -1) continue;
+
+    if (unit > unit_target) return offset_found;
+
+    /* Keep the first of several pages ending at the same time */
+    if (offset_found == -1 || unit > *unit_found) {
+      offset_found = probe.offset;
+      *unit_found = unit;
+    }
+  }
 }
 
 static oggz_off_t
@@ -619,12 +1207,10 @@ oggz_bounded_seek_set (OGGZ * oggz,
 {
   OggzReader * reader;
   oggz_off_t offset_orig, offset_at, offset_guess;
-  oggz_off_t offset_next;
-  ogg_int64_t granule_at;
+  oggz_off_t offset_next, offset_page, io_orig, distance;
   ogg_int64_t unit_at, unit_begin = -1, unit_end = -1, unit_last_iter = -1;
-  long serialno;
-  ogg_page * og;
-  int hit_eof = 0;
+  oggz_seek_page_t page;
+  int at_eof, stale_begin = 0, stale_end = 0;
 
   if (oggz == NULL) {
     return -1;
@@ -637,7 +1223,8 @@ oggz_bounded_seek_set (OGGZ * oggz,
     return -1;
   }
   
-  if (offset_end == -1 && (offset_end = oggz_offset_end (oggz)) == -1) {
+  if ((at_eof = (offset_end == -1)) &&
+      (offset_end = oggz_offset_end (oggz)) == -1) {
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: oggz_offset_end == -1, FAIL\n");
 #endif
@@ -646,6 +1233,9 @@ oggz_bounded_seek_set (OGGZ * oggz,
 
   reader = &oggz->x.reader;
 
+  OGGZ_STATS_ADD (oggz, seeks, 1);
+  OGGZ_STATS_SET (oggz, seek_iterations_last, 0);
+
   if (unit_target == reader->current_unit) {
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: unit_target == reader->current_unit, SKIP\n");
@@ -659,35 +1249,58 @@ oggz_bounded_seek_set (OGGZ * oggz,
     return 0;
   }
 
-  offset_at = oggz_tell_raw (oggz);
-  if (offset_at == -1) return -1;
+  io_orig = oggz_seek_probe_begin (oggz);
 
   offset_orig = oggz->offset;
-
+  offset_at = offset_orig;
   unit_at = reader->current_unit;
 
-  og = &oggz->current_page;
+  /* If the target looks to be a short way ahead, read forward to it */
+  if (offset_at >= offset_begin && offset_at < offset_end &&
+      (distance = oggz_seek_forward_distance (oggz, unit_target)) != -1 &&
+      distance <= OGGZ_SEEK_WALK_MAX) {
+    OGGZ_STATS_ADD (oggz, seek_iterations, 1);
+    OGGZ_STATS_ADD (oggz, seek_iterations_last, 1);
 
-  if (unit_end == -1 && oggz_seek_raw (oggz, offset_end, SEEK_SET) >= 0) {
-    ogg_int64_t granulepos;
+#ifdef DEBUG
+    printf ("oggz_bounded_seek_set: want u%lld, reading forward ~%"
+            PRI_OGGZ_OFF_T "d bytes from @%" PRI_OGGZ_OFF_T "d\n",
+            unit_target, distance, offset_at);
+#endif
 
-    if (oggz_get_prev_start_page (oggz, og, &granulepos, &serialno) >= 0) {
-      unit_end = oggz_get_unit (oggz, serialno, granulepos);
+    oggz_seek_probe_size (oggz, 32 * distance);
+    offset_page = oggz_seek_probe_forward (oggz, offset_at,
+                                           MIN (offset_end, offset_at +
+                                                2 * OGGZ_SEEK_WALK_MAX),
+                                           unit_target, offset_at, &unit_at);
+    if (offset_page >= 0) {
+      offset_at = oggz_seek_probe_commit (oggz, offset_page, unit_at);
+      if (offset_at == -1) return -1;
+      return (long)reader->current_unit;
     }
+
+    unit_at = reader->current_unit;
   }
 
-  if (unit_begin == -1 && oggz_seek_raw (oggz, offset_begin, SEEK_SET) >= 0) {
-    ogg_int64_t granulepos;
-    if (oggz_get_next_start_page (oggz, og) >= 0) {
-      serialno = ogg_page_serialno (og);
-      granulepos = ogg_page_granulepos (og);
-      unit_begin = oggz_get_unit (oggz, serialno, granulepos);
-    }
+  oggz_seek_probe_size (oggz, offset_end - offset_begin);
+
+  if (at_eof)
+    offset_page = oggz_seek_probe_last_page (oggz, offset_end, &page);
+  else
+    offset_page = oggz_seek_probe_prev_start_page (oggz, offset_end, &page);
+  if (offset_page >= 0) {
+    unit_end = oggz_get_unit (oggz, page.serialno, page.granulepos);
+  }
+
+  if (oggz_seek_probe_start_page (oggz, offset_begin, &page) >= 0) {
+    unit_begin = oggz_get_unit (oggz, page.serialno, page.granulepos);
   }
 
   /* Fail if target isn't in specified range. */
-  if (unit_target < unit_begin || unit_target > unit_end)
+  if (unit_target < unit_begin || unit_target > unit_end) {
+    oggz_seek_probe_abort (oggz, io_orig);
     return -1;
+  }
 
   /* Reduce the search range if possible using read cursor position. */
   if (unit_at > unit_begin && unit_at < unit_end) {
@@ -700,22 +1313,36 @@ oggz_bounded_seek_set (OGGZ * oggz,
     }
   }
 
-  og = &oggz->current_page;
-
   for ( ; ; ) {
 
     unit_last_iter = unit_at;
-    hit_eof = 0;
+
+    OGGZ_STATS_ADD (oggz, seek_iterations, 1);
+    OGGZ_STATS_ADD (oggz, seek_iterations_last, 1);
 
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: [A] want u%lld: (u%lld - u%lld) [@%" PRI_OGGZ_OFF_T "d - @%" PRI_OGGZ_OFF_T "d]\n",
 	    unit_target, unit_begin, unit_end, offset_begin, offset_end);
 #endif
 
-    offset_guess = oggz_seek_guess (unit_at, unit_target,
-				    unit_begin, unit_end,
-				    offset_at,
-				    offset_begin, offset_end);
+    /* Once the range fits in a probe read, read through it */
+    if (offset_end - offset_begin <= OGGZ_SEEK_PROBE_MAX) {
+      oggz_seek_probe_size (oggz, 16 * (offset_end - offset_begin +
+                                        OGGZ_SEEK_PROBE_MIN));
+      offset_next = oggz_seek_probe_forward (oggz, offset_begin,
+                                             offset_end + OGGZ_SEEK_PROBE_MAX,
+                                             unit_target, -1, &unit_at);
+      if (offset_next >= 0) {
+        offset_at = oggz_seek_probe_commit (oggz, offset_next, unit_at);
+        if (offset_at == -1) return -1;
+        return (long)reader->current_unit;
+      }
+      break;
+    }
+
+    offset_guess = oggz_seek_guess (unit_target, unit_begin, unit_end,
+				    offset_begin, offset_end,
+				    stale_begin, stale_end);
     if (offset_guess == -1) break;
 
     if (offset_guess == offset_at) {
@@ -723,53 +1350,65 @@ oggz_bounded_seek_set (OGGZ * oggz,
       break;
     }
 
+    oggz_seek_probe_size (oggz, offset_end - offset_begin);
+
     if (offset_guess > offset_end) {
       offset_guess = offset_end;
-      offset_at = oggz_seek_raw (oggz, offset_guess, SEEK_SET);
-      offset_next = oggz_get_prev_start_page (oggz, og, &granule_at, &serialno);
+      offset_next = oggz_seek_probe_prev_start_page (oggz, offset_guess,
+                                                     &page);
     } else {
-      offset_at = oggz_seek_raw (oggz, offset_guess, SEEK_SET);
-      offset_next = oggz_get_next_start_page (oggz, og);
-      serialno = ogg_page_serialno (og);
-      granule_at = ogg_page_granulepos (og);
+      offset_next = oggz_seek_probe_start_page (oggz, offset_guess, &page);
     }
 
-    unit_at = oggz_get_unit (oggz, serialno, granule_at);
-
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: offset_next %" PRI_OGGZ_OFF_T "d\n", offset_next);
 #endif
+
+    if (offset_next < 0) break;
+
+    offset_at = offset_guess;
+    offset_page = offset_next;
+
+    unit_at = oggz_get_unit (oggz, page.serialno, page.granulepos);
+
     if (unit_at == unit_last_iter) break;
 
 #ifdef DEBUG
     printf ("oggz_bounded_seek_set: [D] want u%lld, got page u%lld @%" PRI_OGGZ_OFF_T "d g%lld\n",
-	    unit_target, unit_at, offset_at, granule_at);
+	    unit_target, unit_at, offset_at, page.granulepos);
 #endif
 
     if (unit_at < unit_target) {
       offset_begin = offset_at;
       unit_begin = unit_at;
+      stale_begin = 0;
+      stale_end++;
       if (unit_end == unit_begin) break;
     } else if (unit_at > unit_target) {
       offset_end = offset_at-1;
       unit_end = unit_at;
+      stale_end = 0;
+      stale_begin++;
       if (unit_end == unit_begin) break;
     } else {
       break;
     }
   }
 
+  /* Step back to the last page which ends at or before the target */
   do {
-    offset_at = oggz_get_prev_start_page (oggz, og, &granule_at, &serialno);
-    unit_at = oggz_get_unit (oggz, serialno, granule_at);
+    offset_page = oggz_seek_probe_prev_start_page (oggz, offset_page, &page);
+    if (offset_page < 0) break;
+    unit_at = oggz_get_unit (oggz, page.serialno, page.granulepos);
   } while (unit_at > unit_target);
 
-  if (offset_at < 0) {
-    oggz_reset (oggz, offset_orig, -1, SEEK_SET);
+  if (offset_page < 0) {
+    if (oggz_seek_probe_abort (oggz, io_orig) == -1)
+      oggz_reset (oggz, offset_orig, -1, SEEK_SET);
     return -1;
   }
 
-  offset_at = oggz_reset (oggz, offset_at, unit_at, SEEK_SET);
+  offset_at = oggz_seek_probe_commit (oggz, offset_page, unit_at);
   if (offset_at == -1) return -1;
 
 #ifdef DEBUG
@@ -782,33 +1421,34 @@ oggz_bounded_seek_set (OGGZ * oggz,
 static ogg_int64_t
 oggz_seek_end (OGGZ * oggz, ogg_int64_t unit_offset)
 {
-  oggz_off_t offset_orig, offset_at, offset_end;
-  ogg_int64_t granulepos;
+  oggz_off_t offset_end, io_orig;
   ogg_int64_t unit_end;
-  long serialno;
-  ogg_page * og;
+  oggz_seek_page_t page;
 
-  og = &oggz->current_page;
+  io_orig = oggz_seek_probe_begin (oggz);
 
-  offset_orig = oggz->offset;
+  if ((offset_end = oggz_offset_end (oggz)) == -1) return -1;
 
-  offset_at = oggz_seek_raw (oggz, 0, SEEK_END);
-  if (offset_at == -1) return -1;
+  oggz_seek_probe_size (oggz, offset_end);
 
-  offset_end = oggz_get_prev_start_page (oggz, og, &granulepos, &serialno);
+  offset_end = oggz_seek_probe_last_page (oggz, offset_end, &page);
 
   if (offset_end < 0) {
-    oggz_reset (oggz, offset_orig, -1, SEEK_SET);
+    oggz_seek_probe_abort (oggz, io_orig);
     return -1;
   }
 
-  unit_end = oggz_get_unit (oggz, serialno, granulepos);
+  unit_end = oggz_get_unit (oggz, page.serialno, page.granulepos);
 
 #ifdef DEBUG
   printf ("*** oggz_seek_end: found packet (%lld) at @%" PRI_OGGZ_OFF_T "d [%lld]\n",
-	  unit_end, offset_end, granulepos);
+	  unit_end, offset_end, page.granulepos);
 #endif
 
+  /* Hand the io position back before seeking; the last page is
+   * remembered for bounding the seek */
+  if (oggz_seek_probe_abort (oggz, io_orig) == -1) return -1;
+
   return oggz_bounded_seek_set (oggz, unit_end + unit_offset, 0, -1);
 }
 
@@ -887,15 +1527,440 @@ oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
   return r;
 }
 
+/*
+ * Double seek for keyframes: having found the page before the target,
+ * look back in each track with a granuleshift for the last page ending
+ * before the target, and decode its keyframe number from the granulepos.
+ * The keyframe packet starts after the last page of that track on which
+ * an earlier frame finishes, so the reader is moved back to the earliest
+ * such page over all tracks.
+ */
+ogg_int64_t
+oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t unit_target, long * reads)
+{
+  OggzReader * reader;
+  oggz_stream_t * stream;
+  oggz_seek_page_t page, probe, key_page;
+  oggz_off_t offset_at, offset_key, offset, io_orig;
+  ogg_int64_t unit_at, unit_key, keygranule;
+  long serialno, reads_orig;
+  int i, size;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if (!oggz_has_metrics (oggz)) return -1;
+
+  reader = &oggz->x.reader;
+  reads_orig = reader->seek_reads;
+
+  unit_at = oggz_bounded_seek_set (oggz, unit_target, 0, -1);
+
+  if (unit_at != -1) {
+    offset_at = oggz->offset;
+    offset_key = offset_at;
+    unit_key = -1;
+
+    io_orig = oggz_seek_probe_begin (oggz);
+    oggz_seek_probe_size (oggz, offset_at - oggz->offset_data_begin);
+
+    size = oggz_vector_size (oggz->streams);
+    for (i = 0; i < size; i++) {
+      stream = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+      if (stream->granuleshift == 0) continue;
+
+      serialno = stream->ogg_stream.serialno;
+
+      /* The last page of this track at or before the reader position */
+      if (oggz_seek_probe_prev_page (oggz, offset_at + 1, serialno, -1,
+                                     &page) < 0)
+        continue;
+
+      /* The reader stops short of pages ending exactly at the target;
+       * take any of this track up to the first page beyond it */
+      for (offset = offset_at; ; offset = probe.offset + probe.bytes) {
+        if (oggz_seek_probe_page (oggz, offset, &probe) < 0) break;
+        if (probe.granulepos == -1) continue;
+        if (oggz_get_unit (oggz, probe.serialno, probe.granulepos) >
+            unit_target) break;
+        if (probe.serialno == serialno) page = probe;
+      }
+
+      keygranule = (page.granulepos >> stream->granuleshift)
+        << stream->granuleshift;
+
+      unit_at = oggz_get_unit (oggz, serialno, keygranule);
+      if (unit_key == -1 || unit_at < unit_key) unit_key = unit_at;
+
+#ifdef DEBUG
+      printf ("oggz_seek_keyframe: serialno %010lu page g%lld @%"
+              PRI_OGGZ_OFF_T "d, keyframe g%lld (u%lld)\n",
+              serialno, page.granulepos, page.offset, keygranule, unit_at);
+#endif
+
+      if (oggz_seek_probe_prev_granule (oggz, serialno, keygranule,
+                                        oggz->offset_data_begin, 0,
+                                        page.offset,
+                                        oggz_get_unit (oggz, serialno,
+                                                       page.granulepos),
+                                        &key_page) < 0) {
+        /* No earlier frames; the keyframe starts the track */
+        offset_key = oggz->offset_data_begin;
+      } else if (key_page.offset < offset_key) {
+        offset_key = key_page.offset;
+      }
+    }
+
+    if (offset_key < oggz->offset_data_begin)
+      offset_key = oggz->offset_data_begin;
+
+    if (unit_key == -1) unit_key = reader->current_unit;
+
+    if (offset_key < offset_at) {
+      if (oggz_seek_probe_commit (oggz, offset_key, unit_key) == -1)
+        unit_key = -1;
+    } else {
+      oggz_seek_probe_abort (oggz, io_orig);
+    }
+
+    reader->current_granulepos = -1;
+    unit_at = unit_key;
+  }
+
+  if (reads != NULL) *reads = reader->seek_reads - reads_orig;
+
+  return unit_at;
+}
+
+ogg_int64_t
+oggz_get_duration (OGGZ * oggz)
+{
+  oggz_off_t offset_end, io_orig;
+  oggz_seek_page_t page;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if (!oggz_has_metrics (oggz)) return -1;
+
+  if ((offset_end = oggz_offset_end (oggz)) == -1) return -1;
+
+  io_orig = oggz_seek_probe_begin (oggz);
+
+  oggz_seek_probe_size (oggz, offset_end);
+
+  offset_end = oggz_seek_probe_last_page (oggz, offset_end, &page);
+
+  if (oggz_seek_probe_abort (oggz, io_orig) == -1 || offset_end < 0)
+    return -1;
+
+  return oggz_get_unit (oggz, page.serialno, page.granulepos);
+}
+
+/*
+ * Compare with target the first packet beginning on a page of a stream
+ * with an OggzOrder, searching from offset for pages starting before
+ * offset_end. Pages on which no packet begins, and packets whose order
+ * with respect to target is undefined, are passed over. The packet is
+ * assembled in os, as it may continue on later pages.
+ * returns >= 0 if found; return value is offset of page start, with the
+ *   result of the OggzOrder in cmp
+ * returns -1 if no such page was found, or on error
+ */
+static oggz_off_t
+oggz_seek_probe_order (OGGZ * oggz, ogg_stream_state * os,
+                       oggz_off_t offset, oggz_off_t offset_end,
+                       void * target, int * cmp, oggz_seek_page_t * page)
+{
+  oggz_stream_t * stream;
+  oggz_seek_page_t next;
+  oggz_off_t page_offset, next_offset;
+  ogg_page og;
+  ogg_packet op;
+  OggzPagePackets iter;
+  OggzPagePacket pp;
+  int ret;
+
+  for ( ; ; offset = page_offset + page->bytes) {
+    page_offset = oggz_seek_probe_scan_page (oggz, offset, page, &og);
+    if (page_offset < 0 || page_offset >= offset_end) return -1;
+
+    stream = oggz_get_stream (oggz, page->serialno);
+    if (stream == NULL || (stream->order == NULL && oggz->order == NULL))
+      continue;
+
+    oggz_page_packets_init (&iter, &og);
+    do {
+      ret = oggz_page_packets_next (&iter, &pp);
+    } while (ret == 1 && pp.continued);
+    if (ret != 1) continue;
+
+    ogg_stream_reset_serialno (os, (int)page->serialno);
+    ogg_stream_pagein (os, &og);
+
+    next_offset = page_offset + page->bytes;
+    while ((ret = ogg_stream_packetout (os, &op)) == 0) {
+      next_offset = oggz_seek_probe_scan_page (oggz, next_offset, &next, &og);
+      if (next_offset < 0) break;
+      if (next.serialno == page->serialno) ogg_stream_pagein (os, &og);
+      next_offset += next.bytes;
+    }
+    if (ret != 1) continue;
+
+    OGGZ_STATS_ADD (oggz, seek_iterations, 1);
+    OGGZ_STATS_ADD (oggz, seek_iterations_last, 1);
+
+    if (stream->order) {
+      *cmp = stream->order (oggz, &op, target, stream->order_user_data);
+    } else {
+      *cmp = oggz->order (oggz, &op, target, oggz->order_user_data);
+    }
+
+#ifdef DEBUG
+    printf ("oggz_seek_probe_order: page @%" PRI_OGGZ_OFF_T "d serialno %010lu"
+            " packet of %ld bytes: %d\n",
+            page_offset, page->serialno, op.bytes, *cmp);
+#endif
+
+    if (*cmp != 2) return page_offset;
+  }
+}
+
+static int
+oggz_has_order (OGGZ * oggz)
+{
+  oggz_stream_t * stream;
+  int i, size;
+
+  if (oggz->order) return 1;
+
+  size = oggz_vector_size (oggz->streams);
+  for (i = 0; i < size; i++) {
+    stream = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+    if (stream->order) return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Bisect for the last page whose first packet orders before target,
+ * consulting the OggzOrder once per page probed. The reader is positioned
+ * at that page, so that reading delivers every packet ordered at or
+ * after target.
+ */
 long
 oggz_seek_byorder (OGGZ * oggz, void * target)
 {
-  return -1;
+  ogg_stream_state os;
+  oggz_seek_page_t page;
+  oggz_off_t offset_begin, offset_end, offset_guess, offset_found;
+  oggz_off_t offset_at, io_orig;
+  int cmp;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if (!oggz_has_order (oggz)) return -1;
+
+  if ((offset_end = oggz_offset_end (oggz)) == -1) return -1;
+
+  OGGZ_STATS_ADD (oggz, seeks, 1);
+  OGGZ_STATS_SET (oggz, seek_iterations_last, 0);
+
+  io_orig = oggz_seek_probe_begin (oggz);
+  ogg_stream_init (&os, 0);
+
+  offset_begin = oggz->offset_data_begin;
+  offset_at = offset_begin;
+
+  /* Halve the range until it fits in a single probe read */
+  while (offset_end - offset_begin > OGGZ_SEEK_PROBE_MAX) {
+    offset_guess = offset_begin + (offset_end - offset_begin) / 2;
+
+    oggz_seek_probe_size (oggz, offset_end - offset_begin);
+    offset_found = oggz_seek_probe_order (oggz, &os, offset_guess,
+                                          offset_end, target, &cmp, &page);
+
+#ifdef DEBUG
+    printf ("oggz_seek_byorder: [@%" PRI_OGGZ_OFF_T "d - @%" PRI_OGGZ_OFF_T
+            "d] guess @%" PRI_OGGZ_OFF_T "d found @%" PRI_OGGZ_OFF_T "d\n",
+            offset_begin, offset_end, offset_guess, offset_found);
+#endif
+
+    if (offset_found == -1 || cmp >= 0) {
+      offset_end = offset_guess;
+    } else {
+      offset_at = offset_found;
+      offset_begin = offset_found + page.bytes;
+    }
+  }
+
+  /* Walk the remaining pages, reading them all at once */
+  oggz_seek_probe_size (oggz, 16 * (offset_end - offset_begin));
+  for ( ; ; offset_begin = offset_found + page.bytes) {
+    offset_found = oggz_seek_probe_order (oggz, &os, offset_begin,
+                                          offset_end, target, &cmp, &page);
+    if (offset_found == -1 || cmp >= 0) break;
+    offset_at = offset_found;
+  }
+
+  ogg_stream_clear (&os);
+
+  if (oggz_seek_probe_commit (oggz, offset_at, -1) == -1) {
+    oggz_seek_probe_abort (oggz, io_orig);
+    return -1;
+  }
+
+  oggz->x.reader.current_granulepos = -1;
+
+  return (long)offset_at;
+}
+
+/*
+ * Extend the packet index of a stream by walking forward over the pages
+ * following it, until packet packetno begins within the index, or to
+ * the end of the stream if packetno is -1.
+ * returns 0 on success, -1 on error
+ */
+static int
+oggz_index_extend (OGGZ * oggz, oggz_stream_t * stream, ogg_int64_t packetno)
+{
+  oggz_seek_page_t page;
+  ogg_page og;
+  oggz_off_t offset, page_offset;
+  long serialno = stream->ogg_stream.serialno;
+
+  offset = stream->index_end_offset;
+
+  while (!stream->index_eos &&
+         (packetno == -1 || packetno >= stream->index_end_packets)) {
+    page_offset = oggz_seek_probe_scan_page (oggz, offset, &page, &og);
+    if (page_offset == -2) break;
+    if (page_offset < 0) return -1;
+
+    if (page.serialno == serialno) {
+      /* Stop at a missing page; packets after it cannot be counted */
+      if (oggz_index_append (oggz, stream, &og, page_offset) == -1) break;
+    }
+
+    offset = page_offset + page.bytes;
+  }
+
+  return 0;
+}
+
+/*
+ * Whether the reader will reach packet packetno of a stream, which is
+ * no earlier than its next packet, by reading on for no more than
+ * OGGZ_SEEK_WALK_MAX bytes. Beyond the index, the distance is estimated
+ * from the average size of the packets indexed.
+ */
+static int
+oggz_index_near (OGGZ * oggz, oggz_stream_t * stream, ogg_int64_t packetno)
+{
+  oggz_packet_index_t * entry;
+  oggz_off_t distance;
+
+  if (packetno < stream->index_end_packets) {
+    entry = oggz_index_lookup_packet (stream, packetno);
+    if (entry == NULL) return 0;
+    distance = entry->offset - oggz->offset;
+  } else {
+    if (stream->index_nr == 0 || stream->index_next_pageno < 0 ||
+        stream->index_next_pageno != stream->index_end_pageno)
+      return 0;
+    distance = (stream->index_end_offset - stream->index[0].offset) *
+      (packetno - stream->index_end_packets + 1) /
+      (stream->index_end_packets + 1);
+  }
+
+  return (distance <= OGGZ_SEEK_WALK_MAX);
 }
 
 long
 oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence)
 {
+  OggzReader * reader;
+  oggz_stream_t * stream;
+  oggz_packet_index_t * entry;
+  oggz_off_t io_orig = -1;
+  ogg_int64_t packetno_at = -1, packetno;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (oggz->flags & OGGZ_WRITE) return OGGZ_ERR_INVALID;
+
+  if ((stream = oggz_get_stream (oggz, serialno)) == NULL)
+    return OGGZ_ERR_BAD_SERIALNO;
+
+  reader = &oggz->x.reader;
+
+  /* The next packet of this stream the reader will deliver, if known */
+  if (stream->seek_packetno != -1)
+    packetno_at = stream->seek_packetno;
+  else if (stream->index_next_pageno >= 0)
+    packetno_at = stream->packetno + 1;
+
+  switch (whence) {
+  case SEEK_SET:
+    packetno = packets;
+    break;
+  case SEEK_CUR:
+    if (packetno_at == -1) return -1;
+    packetno = packetno_at + packets;
+    break;
+  case SEEK_END:
+    io_orig = oggz_seek_probe_begin (oggz);
+    oggz_seek_probe_size (oggz, 16 * OGGZ_SEEK_PROBE_MAX);
+    if (oggz_index_extend (oggz, stream, -1) == -1) goto fail;
+    packetno = stream->index_end_packets + packets;
+    break;
+  default:
+    return -1;
+  }
+
+  if (packetno < 0) goto fail;
+
+  /* Close enough ahead to read on to, skipping packets on the way */
+  if (packetno_at != -1 && packetno >= packetno_at &&
+      oggz_index_near (oggz, stream, packetno)) {
+    oggz_seek_probe_abort (oggz, io_orig);
+    stream->seek_packetno = packetno;
+    return (long)packetno;
+  }
+
+  if (io_orig == -1) {
+    io_orig = oggz_seek_probe_begin (oggz);
+    oggz_seek_probe_size (oggz, 16 * OGGZ_SEEK_PROBE_MAX);
+  }
+
+  if (oggz_index_extend (oggz, stream, packetno) == -1) goto fail;
+
+  if (packetno >= stream->index_end_packets ||
+      (entry = oggz_index_lookup_packet (stream, packetno)) == NULL)
+    goto fail;
+
+#ifdef DEBUG
+  printf ("oggz_seek_packets: packet %lld begins on page %ld @%"
+          PRI_OGGZ_OFF_T "d (packet %lld, segment %d)\n",
+          packetno, entry->pageno, entry->offset, entry->packetno,
+          entry->segment);
+#endif
+
+  if (oggz_seek_probe_commit (oggz, entry->offset, -1) == -1) return -1;
+
+  /* The reader recounts packets from the indexed page */
+  stream->seek_packetno = packetno;
+  reader->current_granulepos = -1;
+
+  return (long)packetno;
+
+ fail:
+  oggz_seek_probe_abort (oggz, io_orig);
   return -1;
 }
 
@@ -904,6 +1969,11 @@ oggz_seek_packets (OGGZ * oggz, long serialno, long packets, int whence)
 #include <ogg/ogg.h>
 #include "oggz_private.h"
 
+void
+oggz_seek_cache_clear (OGGZ * oggz)
+{
+}
+
 off_t
 oggz_seek (OGGZ * oggz, oggz_off_t offset, int whence)
 {
@@ -916,6 +1986,18 @@ oggz_seek_units (OGGZ * oggz, ogg_int64_t units, int whence)
   return OGGZ_ERR_DISABLED;
 }
 
+ogg_int64_t
+oggz_seek_keyframe (OGGZ * oggz, ogg_int64_t unit_target, long * reads)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+ogg_int64_t
+oggz_get_duration (OGGZ * oggz)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_seek_byorder (OGGZ * oggz, void * target)
 {
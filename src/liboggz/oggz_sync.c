@@ -0,0 +1,341 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * oggz_sync.c
+ *
+ * Page synchronisation on the read path.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ogg/ogg.h>
+
+#include "oggz_private.h"
+#include "oggz_crc.h"
+#include "oggz_sync.h"
+
+/* #define DEBUG */
+
+#define OGGZ_PAGE_HEADER_MIN 27
+
+#define OGGZ_SYNC_MIN_STORAGE 4096
+
+int
+oggz_sync_init (OggzSync * sync)
+{
+  memset (sync, 0, sizeof (OggzSync));
+  return 0;
+}
+
+int
+oggz_sync_clear (OggzSync * sync)
+{
+  if (sync->storage != NULL) oggz_free (sync->storage);
+  memset (sync, 0, sizeof (OggzSync));
+  return 0;
+}
+
+void
+oggz_sync_reset (OggzSync * sync, oggz_off_t offset)
+{
+  sync->data = sync->storage;
+  sync->fill = 0;
+  sync->returned = 0;
+  sync->offset = offset;
+  sync->headerbytes = 0;
+  sync->bodybytes = 0;
+}
+
+int
+oggz_sync_seek (OggzSync * sync, oggz_off_t offset)
+{
+  if (sync->data != sync->storage) return -1;
+
+  if (offset < sync->offset || offset > sync->offset + sync->fill)
+    return -1;
+
+  sync->returned = (long)(offset - sync->offset);
+  sync->headerbytes = 0;
+  sync->bodybytes = 0;
+
+  return 0;
+}
+
+unsigned char *
+oggz_sync_buffer (OggzSync * sync, long size)
+{
+  unsigned char * new_storage;
+  long remaining, new_len;
+
+  /* Data cannot be appended to an attached buffer */
+  if (sync->data != sync->storage && oggz_sync_detach (sync) != 0)
+    return NULL;
+
+  remaining = sync->fill - sync->returned;
+
+  if (sync->fill + size <= sync->keep) {
+    /* Room to keep consumed data */
+  } else if (remaining == 0) {
+    /* Everything has been consumed; start again at the beginning */
+    sync->offset += sync->fill;
+    sync->fill = sync->returned = 0;
+  } else if (sync->fill + size > sync->storage_len && sync->returned > 0) {
+    /* Only move the unconsumed tail when there is no room after it */
+    memmove (sync->storage, sync->storage + sync->returned, remaining);
+    sync->offset += sync->returned;
+    sync->fill = remaining;
+    sync->returned = 0;
+  }
+
+  if (sync->fill + size > sync->storage_len) {
+    new_len = sync->fill + size;
+    if (new_len < OGGZ_SYNC_MIN_STORAGE) new_len = OGGZ_SYNC_MIN_STORAGE;
+    new_len += new_len/2;
+
+    new_storage = oggz_realloc (sync->storage, new_len);
+    if (new_storage == NULL) return NULL;
+
+    sync->storage = new_storage;
+    sync->storage_len = new_len;
+  }
+
+  sync->data = sync->storage;
+
+  return sync->storage + sync->fill;
+}
+
+int
+oggz_sync_wrote (OggzSync * sync, long bytes)
+{
+  if (sync->data != sync->storage || sync->fill + bytes > sync->storage_len)
+    return OGGZ_ERR_INVALID;
+
+  sync->fill += bytes;
+
+  return 0;
+}
+
+unsigned char *
+oggz_sync_buffer_front (OggzSync * sync, long size)
+{
+  unsigned char * new_storage;
+  long new_len;
+
+  if (sync->data != sync->storage) return NULL;
+
+  if (sync->fill + size > sync->storage_len) {
+    new_len = sync->fill + size;
+    if (new_len < OGGZ_SYNC_MIN_STORAGE) new_len = OGGZ_SYNC_MIN_STORAGE;
+    new_len += new_len/2;
+
+    new_storage = oggz_realloc (sync->storage, new_len);
+    if (new_storage == NULL) return NULL;
+
+    sync->storage = new_storage;
+    sync->storage_len = new_len;
+    sync->data = sync->storage;
+  }
+
+  memmove (sync->storage + size, sync->storage, sync->fill);
+  sync->fill += size;
+  sync->offset -= size;
+  sync->returned = 0;
+  sync->headerbytes = 0;
+  sync->bodybytes = 0;
+
+  return sync->storage;
+}
+
+int
+oggz_sync_attach (OggzSync * sync, unsigned char * buf, long n)
+{
+  if (sync->data != sync->storage || sync->fill > sync->returned)
+    return 0;
+
+  sync->offset += sync->fill;
+  sync->data = buf;
+  sync->fill = n;
+  sync->returned = 0;
+
+  return 1;
+}
+
+int
+oggz_sync_detach (OggzSync * sync)
+{
+  unsigned char * remainder, * buffer;
+  long remaining;
+
+  if (sync->data == sync->storage) return 0;
+
+  remainder = sync->data + sync->returned;
+  remaining = sync->fill - sync->returned;
+
+  sync->offset += sync->returned;
+  sync->data = sync->storage;
+  sync->fill = sync->returned = 0;
+
+  if (remaining > 0) {
+    if ((buffer = oggz_sync_buffer (sync, remaining)) == NULL)
+      return OGGZ_ERR_OUT_OF_MEMORY;
+
+    memcpy (buffer, remainder, remaining);
+    sync->fill += remaining;
+  }
+
+  return 0;
+}
+
+long
+oggz_sync_wanted (OggzSync * sync)
+{
+  unsigned char * page = sync->data + sync->returned;
+  long bytes = sync->fill - sync->returned;
+  long wanted;
+  int i;
+
+  if (bytes == 0) return 0;
+
+  if (sync->headerbytes > 0) {
+    wanted = sync->headerbytes + sync->bodybytes;
+  } else if (bytes >= OGGZ_PAGE_HEADER_MIN) {
+    wanted = OGGZ_PAGE_HEADER_MIN + page[26];
+    if (bytes >= wanted) {
+      for (i = 0; i < page[26]; i++)
+        wanted += page[OGGZ_PAGE_HEADER_MIN + i];
+    }
+  } else {
+    wanted = OGGZ_PAGE_HEADER_MIN;
+  }
+
+  return (wanted > bytes) ? wanted - bytes : 1;
+}
+
+static int
+oggz_sync_checksum_ok (const ogg_page * og)
+{
+  const unsigned char * c = og->header + 22;
+  ogg_uint32_t stored, crc;
+
+  stored = (ogg_uint32_t)c[0] | ((ogg_uint32_t)c[1] << 8) |
+    ((ogg_uint32_t)c[2] << 16) | ((ogg_uint32_t)c[3] << 24);
+
+  crc = oggz_crc32_page (og->header, og->header_len, og->body, og->body_len);
+
+  return (crc == stored);
+}
+
+/*
+ * Find the next possible capture pattern after the start of data.
+ * A trailing partial match is returned as a candidate, as the rest of
+ * the pattern may not have arrived yet.
+ */
+static unsigned char *
+oggz_sync_find_capture (unsigned char * data, unsigned char * end)
+{
+  unsigned char * next = data;
+
+  while ((next = memchr (next, 'O', end - next)) != NULL) {
+    long avail = end - next;
+
+    if (avail < 4) {
+      if (!memcmp (next, "OggS", avail)) return next;
+    } else if (!memcmp (next, "OggS", 4)) {
+      return next;
+    }
+
+    next++;
+  }
+
+  return end;
+}
+
+long
+oggz_sync_pageseek (OggzSync * sync, ogg_page * og, int verify_crc)
+{
+  unsigned char * page = sync->data + sync->returned;
+  unsigned char * next;
+  long bytes = sync->fill - sync->returned;
+  int i;
+
+  if (sync->headerbytes == 0) {
+    long headerbytes;
+
+    if (bytes < OGGZ_PAGE_HEADER_MIN) return 0;
+
+    if (memcmp (page, "OggS", 4)) goto sync_fail;
+
+    headerbytes = page[26] + OGGZ_PAGE_HEADER_MIN;
+    if (bytes < headerbytes) return 0;
+
+    sync->bodybytes = 0;
+    for (i = 0; i < page[26]; i++)
+      sync->bodybytes += page[OGGZ_PAGE_HEADER_MIN + i];
+    sync->headerbytes = headerbytes;
+  }
+
+  if (sync->headerbytes + sync->bodybytes > bytes) return 0;
+
+  og->header = page;
+  og->header_len = sync->headerbytes;
+  og->body = page + sync->headerbytes;
+  og->body_len = sync->bodybytes;
+
+  if (verify_crc && !oggz_sync_checksum_ok (og)) {
+#ifdef DEBUG
+    printf ("oggz_sync_pageseek: checksum mismatch\n");
+#endif
+    goto sync_fail;
+  }
+
+  bytes = sync->headerbytes + sync->bodybytes;
+
+  sync->returned += bytes;
+  sync->headerbytes = 0;
+  sync->bodybytes = 0;
+
+  return bytes;
+
+ sync_fail:
+
+  sync->headerbytes = 0;
+  sync->bodybytes = 0;
+
+  next = oggz_sync_find_capture (page + 1, sync->data + sync->fill);
+  sync->returned = next - sync->data;
+
+  return -(long)(next - page);
+}
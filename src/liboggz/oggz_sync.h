@@ -0,0 +1,155 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __OGGZ_SYNC_H__
+#define __OGGZ_SYNC_H__
+
+#include <ogg/ogg.h>
+#include <oggz/oggz_off_t.h>
+
+/*
+ * OggzSync: a page framer for the read and seek paths.
+ *
+ * Incoming data is appended to a single buffer which is only compacted
+ * when there is no room left at its end, so each byte is moved at most
+ * once per refill cycle rather than on every refill. Pages returned by
+ * oggz_sync_pageseek() are views into the buffer (or into an attached
+ * caller buffer), and remain valid until the next call that adds data.
+ */
+typedef struct {
+  unsigned char * data;    /* current window: storage, or an attached buffer */
+  long fill;               /* end of valid data in window */
+  long returned;           /* start of unconsumed data in window */
+  oggz_off_t offset;       /* input offset of data[0] */
+
+  unsigned char * storage; /* owned buffer */
+  long storage_len;
+
+  long headerbytes;        /* header length of partially received page */
+  long bodybytes;          /* body length of partially received page */
+
+  long keep;               /* keep consumed data up to this window size,
+                              for returning to it with oggz_sync_seek() */
+} OggzSync;
+
+int oggz_sync_init (OggzSync * sync);
+int oggz_sync_clear (OggzSync * sync);
+
+/*
+ * oggz_sync_reset (sync, offset)
+ *
+ * Discard all buffered data, eg. after seeking the underlying input.
+ * The next data written is taken to be from the given input offset.
+ */
+void oggz_sync_reset (OggzSync * sync, oggz_off_t offset);
+
+/*
+ * oggz_sync_seek (sync, offset)
+ *
+ * Reposition within buffered data, so that the next page search starts
+ * at the given input offset.
+ *
+ * returns 0 on success
+ * returns -1 if the offset is not within the buffered data
+ */
+int oggz_sync_seek (OggzSync * sync, oggz_off_t offset);
+
+/*
+ * oggz_sync_buffer (sync, size)
+ *
+ * Get a pointer to space for at least size bytes of new data, which
+ * must then be committed with oggz_sync_wrote().
+ *
+ * returns NULL if memory could not be allocated
+ */
+unsigned char * oggz_sync_buffer (OggzSync * sync, long size);
+
+int oggz_sync_wrote (OggzSync * sync, long bytes);
+
+/*
+ * oggz_sync_buffer_front (sync, size)
+ *
+ * Make room for size bytes of data preceding the buffered data, ie. from
+ * input offset sync->offset - size. The space is filled in place; the
+ * page search restarts at the new front.
+ *
+ * returns NULL if data is attached, or memory could not be allocated
+ */
+unsigned char * oggz_sync_buffer_front (OggzSync * sync, long size);
+
+/*
+ * oggz_sync_attach (sync, buf, n)
+ *
+ * Frame pages directly out of a caller buffer without copying, when no
+ * data is buffered. Pages returned while attached point into buf; the
+ * remainder must be taken into the sync buffer with oggz_sync_detach()
+ * before buf goes away.
+ *
+ * returns 1 if buf was attached
+ * returns 0 if data is already buffered; buf should be copied in instead
+ */
+int oggz_sync_attach (OggzSync * sync, unsigned char * buf, long n);
+
+/*
+ * oggz_sync_detach (sync)
+ *
+ * Copy any unconsumed data out of an attached buffer.
+ *
+ * returns 0 on success
+ * returns OGGZ_ERR_OUT_OF_MEMORY if the data could not be retained
+ */
+int oggz_sync_detach (OggzSync * sync);
+
+/*
+ * oggz_sync_wanted (sync)
+ *
+ * Estimate how many more bytes are needed to complete the partially
+ * received page at the start of the buffered data. This is exact once
+ * the page header has been received.
+ *
+ * returns 0 if no data is buffered
+ */
+long oggz_sync_wanted (OggzSync * sync);
+
+/*
+ * oggz_sync_pageseek (sync, og, verify_crc)
+ *
+ * Find the next page in the sync buffer. This follows the semantics of
+ * ogg_sync_pageseek(), but optionally skips checksum verification.
+ *
+ * returns n > 0 if a page of n bytes was found and placed in og
+ * returns 0 if more data is needed
+ * returns -n if n bytes were skipped while looking for a page
+ */
+long oggz_sync_pageseek (OggzSync * sync, ogg_page * og, int verify_crc);
+
+#endif /* __OGGZ_SYNC_H__ */
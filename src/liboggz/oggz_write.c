@@ -61,26 +61,13 @@
 
 #define OGGZ_WRITE_EMPTY (-707)
 
-/* #define ZPACKET_CMP */
-
-#ifdef ZPACKET_CMP
-static int
-oggz_zpacket_cmp (oggz_writer_packet_t * a, oggz_writer_packet_t * b,
-		  void * user_data)
-{
-  OGGZ * oggz = (OGGZ *)user_data;
-  long serialno_a, serialno_b;
-  ogg_int64_t unit_a, unit_b;
-
-  serialno_a = a->stream->ogg_stream.serialno;
-  serialno_b = b->stream->ogg_stream.serialno;
-
-  unit_a = oggz_get_unit (oggz, serialno_a, a->op.granulepos);
-  unit_b = oggz_get_unit (oggz, serialno_b, b->op.granulepos);
-
-  if (unit_a < unit_b) return -1;
-  else return (unit_a > unit_b);
-}
+#ifdef HAVE_ATOMIC_BUILTINS
+#define oggz_load_acquire(p) __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#define oggz_store_release(p,v) __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#else
+/* Producers cannot be set up; see oggz_write_set_producer() */
+#define oggz_load_acquire(p) (*(p))
+#define oggz_store_release(p,v) (*(p) = (v))
 #endif
 
 OGGZ *
@@ -93,11 +80,9 @@ oggz_write_init (OGGZ * oggz)
   writer->packet_queue = oggz_vector_new ();
   if (writer->packet_queue == NULL) return NULL;
 
-#ifdef ZPACKET_CMP
-  /* XXX: comparison function should only kick in when a metric is set */
-  oggz_vector_set_cmp (writer->packet_queue,
-		       (OggzCmpFunc)oggz_zpacket_cmp, oggz);
-#endif
+  writer->queue_bytes = 0;
+  writer->queue_max_packets = 0;
+  writer->queue_max_bytes = 0;
 
   writer->hungry = NULL;
   writer->hungry_user_data = NULL;
@@ -121,6 +106,16 @@ oggz_write_init (OGGZ * oggz)
 
   writer->current_stream = NULL;
 
+  writer->sort_heap = NULL;
+  writer->sort_heap_nr = 0;
+  writer->sort_heap_max = 0;
+  writer->sort_seq = 0;
+  writer->sort_out = NULL;
+
+  writer->producers = NULL;
+  writer->nr_producers = 0;
+  writer->next_producer = 0;
+
   return oggz;
 }
 
@@ -162,6 +157,10 @@ OGGZ *
 oggz_write_close (OGGZ * oggz)
 {
   OggzWriter * writer = &oggz->x.writer;
+  oggz_stream_t * stream;
+  oggz_sort_page_t * page;
+  oggz_producer_t * producer;
+  int i, size;
 
   oggz_write_flush (oggz);
 
@@ -172,6 +171,39 @@ oggz_write_close (OGGZ * oggz)
 		       (OggzFunc)oggz_writer_packet_free);
   oggz_vector_delete (writer->packet_queue);
 
+  /* Packets still queued by producers are discarded */
+  for (i = 0; i < writer->nr_producers; i++) {
+    producer = writer->producers[i]->producer;
+    while (producer->head != producer->tail) {
+      oggz_writer_packet_free (producer->ring[producer->head & producer->mask]);
+      producer->head++;
+    }
+    oggz_free (producer->ring);
+    oggz_free (producer);
+    writer->producers[i]->producer = NULL;
+  }
+  oggz_free (writer->producers);
+  writer->producers = NULL;
+  writer->nr_producers = 0;
+
+  /* Pages still held for sorting are discarded */
+  size = oggz_vector_size (oggz->streams);
+  for (i = 0; i < size; i++) {
+    stream = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+    while ((page = stream->sort_head) != NULL) {
+      stream->sort_head = page->next;
+      oggz_free (page);
+    }
+    stream->sort_tail = stream->sort_unkeyed = NULL;
+    stream->sort_heap_index = -1;
+  }
+
+  oggz_free (writer->sort_out);
+  writer->sort_out = NULL;
+  oggz_free (writer->sort_heap);
+  writer->sort_heap = NULL;
+  writer->sort_heap_nr = writer->sort_heap_max = 0;
+
   return oggz;
 }
 
@@ -198,6 +230,225 @@ oggz_write_set_hungry_callback (OGGZ * oggz, OggzWriteHungry hungry,
   return 0;
 }
 
+int
+oggz_write_set_queue_limits (OGGZ * oggz, long max_packets, long max_bytes)
+{
+  OggzWriter * writer;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE) || max_packets < 0 || max_bytes < 0) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  writer = &oggz->x.writer;
+
+  writer->queue_max_packets = max_packets;
+  writer->queue_max_bytes = max_bytes;
+
+  return 0;
+}
+
+int
+oggz_write_get_queue_space (OGGZ * oggz, long * packets, long * bytes)
+{
+  OggzWriter * writer;
+  long nr_packets;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE)) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  writer = &oggz->x.writer;
+  nr_packets = (long)oggz_vector_size (writer->packet_queue);
+
+  if (packets != NULL) {
+    if (writer->queue_max_packets == 0)
+      *packets = -1;
+    else
+      *packets = MAX (writer->queue_max_packets - nr_packets, 0);
+  }
+
+  if (bytes != NULL) {
+    if (writer->queue_max_bytes == 0)
+      *bytes = -1;
+    else
+      *bytes = MAX (writer->queue_max_bytes - writer->queue_bytes, 0);
+  }
+
+  return 0;
+}
+
+int
+oggz_write_set_producer (OGGZ * oggz, long serialno, long max_packets)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+  OggzWriter * writer;
+  oggz_stream_t * stream, ** new_producers;
+  oggz_producer_t * producer;
+  unsigned long size;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  if (!(oggz->flags & OGGZ_WRITE) || max_packets <= 0) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if ((long)((ogg_int32_t)serialno) != serialno || serialno == -1)
+    return OGGZ_ERR_BAD_SERIALNO;
+
+  writer = &oggz->x.writer;
+
+  stream = oggz_get_stream (oggz, serialno);
+  if (stream == NULL) {
+    if (!(oggz->flags & OGGZ_NONSTRICT) && !oggz_get_bos (oggz, -1))
+      return OGGZ_ERR_BOS;
+
+    stream = oggz_add_stream (oggz, serialno);
+    if (stream == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+  } else if (stream->producer != NULL || !stream->b_o_s) {
+    /* Already a producer, or packets have been fed directly */
+    return OGGZ_ERR_INVALID;
+  }
+
+  for (size = 1; size < (unsigned long)max_packets; size <<= 1);
+
+  new_producers = oggz_realloc (writer->producers,
+                                (writer->nr_producers + 1) *
+                                sizeof (oggz_stream_t *));
+  if (new_producers == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+  writer->producers = new_producers;
+
+  producer = oggz_malloc (sizeof (oggz_producer_t));
+  if (producer == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  producer->ring = oggz_malloc (size * sizeof (oggz_writer_packet_t *));
+  if (producer->ring == NULL) {
+    oggz_free (producer);
+    return OGGZ_ERR_OUT_OF_MEMORY;
+  }
+
+  producer->mask = size - 1;
+  producer->tail = producer->head_cache = 0;
+  producer->head = producer->tail_cache = 0;
+
+  stream->producer = producer;
+  writer->producers[writer->nr_producers++] = stream;
+
+  return 0;
+#else
+  return OGGZ_ERR_DISABLED;
+#endif
+}
+
+/*
+ * Check, from the producer's thread, whether its ring is full. Only the
+ * writing thread makes space, so a packet can be queued if this fails.
+ */
+static int
+oggz_producer_full (oggz_producer_t * producer)
+{
+  if (producer->tail - producer->head_cache <= producer->mask) return 0;
+
+  producer->head_cache = oggz_load_acquire (&producer->head);
+
+  return (producer->tail - producer->head_cache > producer->mask);
+}
+
+static void
+oggz_producer_push (oggz_producer_t * producer,
+                    oggz_writer_packet_t * zpacket)
+{
+  producer->ring[producer->tail & producer->mask] = zpacket;
+  oggz_store_release (&producer->tail, producer->tail + 1);
+}
+
+static oggz_writer_packet_t *
+oggz_producer_pop (oggz_producer_t * producer)
+{
+  oggz_writer_packet_t * zpacket;
+
+  if (producer->head == producer->tail_cache) {
+    producer->tail_cache = oggz_load_acquire (&producer->tail);
+    if (producer->head == producer->tail_cache) return NULL;
+  }
+
+  zpacket = producer->ring[producer->head & producer->mask];
+  oggz_store_release (&producer->head, producer->head + 1);
+
+  return zpacket;
+}
+
+/*
+ * Take the next packet queued by a producer, visiting the producers in
+ * turn so that none is starved.
+ */
+static oggz_writer_packet_t *
+oggz_writer_pop_producers (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  oggz_writer_packet_t * zpacket;
+  int i, n;
+
+  for (i = 0; i < writer->nr_producers; i++) {
+    n = writer->next_producer;
+    writer->next_producer = (n + 1) % writer->nr_producers;
+
+    zpacket = oggz_producer_pop (writer->producers[n]->producer);
+    if (zpacket != NULL) {
+      /* Allocations made in the producer's thread are counted here */
+      OGGZ_STATS_ADD (oggz, allocs, zpacket->guard ? 1 : 2);
+      return zpacket;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Check whether any producer has packets queued. This is called when
+ * the writing thread starts a write, to notice packets queued since it
+ * last ran out; packets fed directly instead reset no_more_packets.
+ */
+static int
+oggz_writer_producers_pending (OggzWriter * writer)
+{
+  oggz_producer_t * producer;
+  int i;
+
+  for (i = 0; i < writer->nr_producers; i++) {
+    producer = writer->producers[i]->producer;
+    if (producer->head != oggz_load_acquire (&producer->tail)) return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Check whether a packet of the given size may be queued. A packet is
+ * always accepted into an empty queue, so that a packet larger than the
+ * byte limit cannot block the writer forever.
+ */
+static int
+oggz_write_queue_full (OggzWriter * writer, long bytes)
+{
+  long nr_packets = (long)oggz_vector_size (writer->packet_queue);
+
+  if (nr_packets == 0) return 0;
+
+  if (writer->queue_max_packets > 0 &&
+      nr_packets >= writer->queue_max_packets)
+    return 1;
+
+  if (writer->queue_max_bytes > 0 &&
+      writer->queue_bytes + bytes > writer->queue_max_bytes)
+    return 1;
+
+  return 0;
+}
+
 int
 oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 		 int * guard)
@@ -205,6 +456,7 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
   OggzWriter * writer;
   oggz_stream_t * stream;
   oggz_writer_packet_t * packet;
+  oggz_producer_t * producer = NULL;
   ogg_packet * new_op;
   unsigned char * new_buf = NULL;
   int b_o_s, e_o_s, bos_auto;
@@ -224,6 +476,24 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 
   if (guard && *guard != 0) return OGGZ_ERR_BAD_GUARD;
 
+  /* Packets for a producer stream, which may be fed from another thread,
+   * touch only that stream and its own queue */
+  if (writer->nr_producers > 0) {
+    stream = oggz_get_stream (oggz, serialno);
+    if (stream != NULL) producer = stream->producer;
+  }
+
+  /* Refuse the packet before any stream state is updated for it */
+  if (producer != NULL) {
+    if (oggz_producer_full (producer)) return OGGZ_ERR_QUEUE_FULL;
+  } else if (oggz_write_queue_full (writer, op->bytes)) {
+#ifdef DEBUG
+    printf ("oggz_write_feed: queue full (%d packets, %ld bytes)\n",
+            oggz_vector_size (writer->packet_queue), writer->queue_bytes);
+#endif
+    return OGGZ_ERR_QUEUE_FULL;
+  }
+
   /* Check that the serialno is in the valid range for an Ogg page header,
    * ie. that it fits within 32 bits and does not equal the special value -1 */
   if ((long)((ogg_int32_t)serialno) != serialno || serialno == -1) {
@@ -264,7 +534,7 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
       return OGGZ_ERR_BAD_SERIALNO;
     }
   } else {
-    if (bos_auto) b_o_s = 0;
+    if (bos_auto) b_o_s = stream->b_o_s;
 
     if (!suffix && strict && stream->e_o_s)
       return OGGZ_ERR_EOS;
@@ -294,7 +564,9 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 
   /* OK -- Update stream's memory of packet details */
 
-  if (!stream->metric && (oggz->flags & OGGZ_AUTO)) {
+  /* For producer streams, this is left to the writing thread, which
+   * alone sets stream->metric for them */
+  if (producer == NULL && !stream->metric && (oggz->flags & OGGZ_AUTO)) {
     oggz_auto_read_bos_packet (oggz, op, serialno, NULL);
   }
 
@@ -312,6 +584,7 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
     if (new_buf == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
 
     memcpy (new_buf, op->packet, (size_t)op->bytes);
+    if (producer == NULL) OGGZ_STATS_ADD (oggz, allocs, 1);
   } else {
     new_buf = op->packet;
   }
@@ -321,6 +594,7 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
     if (guard == NULL && new_buf != NULL) oggz_free (new_buf);
     return OGGZ_ERR_OUT_OF_MEMORY;
   }
+  if (producer == NULL) OGGZ_STATS_ADD (oggz, allocs, 1);
 
   new_op = &packet->op;
   new_op->packet = new_buf;
@@ -339,12 +613,18 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
 	  new_op->b_o_s, new_op->e_o_s, new_op->bytes, packet->flush);
 #endif
 
+  if (producer != NULL) {
+    oggz_producer_push (producer, packet);
+    return 0;
+  }
+
   if (oggz_vector_insert_p (writer->packet_queue, packet) == NULL) {
     oggz_free (packet);
     if (!guard) oggz_free (new_buf);
     return -1;
   }
 
+  writer->queue_bytes += new_op->bytes;
   writer->no_more_packets = 0;
 
 #ifdef DEBUG
@@ -372,6 +652,284 @@ oggz_write_feed (OGGZ * oggz, ogg_packet * op, long serialno, int flush,
  */
 
 
+/*
+ * oggz_page_make (oggz)
+ *
+ * Makes the next page of the current stream into oggz->current_page.
+ *
+ * If this returns 0, no page is ready.
+ */
+static int
+oggz_page_make (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  int ret;
+
+  if (ALWAYS_FLUSH || writer->flushing) {
+#ifdef DEBUG
+    printf ("oggz_page_make: ATTEMPT FLUSH: ");
+#endif
+    ret = oggz_write_flush (oggz);
+  } else {
+#ifdef DEBUG
+    printf ("oggz_page_make: ATTEMPT pageout: ");
+#endif
+    ret = ogg_stream_pageout (writer->current_stream, &oggz->current_page);
+  }
+
+#ifdef DEBUG
+  printf ("%s\n", ret ? "OK" : "NO");
+#endif
+
+  return ret;
+}
+
+/******** Page sorting (OGGZ_SORT) ********/
+
+/*
+ * Pages are held per stream, in the order they were made. Once a page
+ * is keyed with its end time, so are all pages before it in its stream;
+ * the streams whose first held page is keyed form a heap on the key of
+ * that page, bos pages before others of the same time, then in the
+ * order they were made.
+ */
+
+static int
+oggz_sort_cmp (oggz_stream_t * a, oggz_stream_t * b)
+{
+  oggz_sort_page_t * pa = a->sort_head, * pb = b->sort_head;
+
+  if (pa->unit != pb->unit) return (pa->unit < pb->unit) ? -1 : 1;
+  if (pa->bos != pb->bos) return pa->bos ? -1 : 1;
+  return (pa->seq < pb->seq) ? -1 : 1;
+}
+
+static void
+oggz_sort_heap_set (OggzWriter * writer, int i, oggz_stream_t * stream)
+{
+  writer->sort_heap[i] = stream;
+  stream->sort_heap_index = i;
+}
+
+static void
+oggz_sort_sift_up (OggzWriter * writer, int i)
+{
+  oggz_stream_t * stream = writer->sort_heap[i];
+  int parent;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (oggz_sort_cmp (writer->sort_heap[parent], stream) < 0) break;
+    oggz_sort_heap_set (writer, i, writer->sort_heap[parent]);
+    i = parent;
+  }
+
+  oggz_sort_heap_set (writer, i, stream);
+}
+
+static void
+oggz_sort_sift_down (OggzWriter * writer, int i)
+{
+  oggz_stream_t * stream = writer->sort_heap[i];
+  int child;
+
+  while ((child = 2 * i + 1) < writer->sort_heap_nr) {
+    if (child + 1 < writer->sort_heap_nr &&
+        oggz_sort_cmp (writer->sort_heap[child+1],
+                       writer->sort_heap[child]) < 0)
+      child++;
+    if (oggz_sort_cmp (stream, writer->sort_heap[child]) < 0) break;
+    oggz_sort_heap_set (writer, i, writer->sort_heap[child]);
+    i = child;
+  }
+
+  oggz_sort_heap_set (writer, i, stream);
+}
+
+/* Room is kept in the heap for every stream, so insertion cannot fail */
+static int
+oggz_sort_heap_reserve (OggzWriter * writer, int nr_streams)
+{
+  oggz_stream_t ** new_heap;
+  int new_max;
+
+  if (writer->sort_heap_max >= nr_streams) return 0;
+
+  new_max = writer->sort_heap_max ? writer->sort_heap_max : 4;
+  while (new_max < nr_streams) new_max *= 2;
+
+  new_heap = oggz_realloc (writer->sort_heap,
+                           new_max * sizeof (oggz_stream_t *));
+  if (new_heap == NULL) return OGGZ_ERR_OUT_OF_MEMORY;
+
+  writer->sort_heap = new_heap;
+  writer->sort_heap_max = new_max;
+
+  return 0;
+}
+
+static void
+oggz_sort_heap_insert (OggzWriter * writer, oggz_stream_t * stream)
+{
+  writer->sort_heap[writer->sort_heap_nr] = stream;
+  oggz_sort_sift_up (writer, writer->sort_heap_nr++);
+}
+
+static int
+oggz_sort_has_metric (OGGZ * oggz, oggz_stream_t * stream)
+{
+  return (oggz->metric != NULL || stream->metric != NULL);
+}
+
+/*
+ * With OGGZ_AUTO, a producer stream is only identified when its first
+ * packet reaches the writing thread, so until its headers are done it
+ * must be waited for as though it had a metric.
+ */
+static int
+oggz_sort_may_have_metric (OGGZ * oggz, oggz_stream_t * stream)
+{
+  if (oggz_sort_has_metric (oggz, stream)) return 1;
+
+  return ((oggz->flags & OGGZ_AUTO) && !stream->delivered_non_b_o_s);
+}
+
+/*
+ * oggz_sort_hold (oggz)
+ *
+ * Takes a copy of oggz->current_page to hold until it can be output.
+ * Returns -1 if the page could not be held.
+ */
+static int
+oggz_sort_hold (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  ogg_page * og = &oggz->current_page;
+  oggz_stream_t * stream;
+  oggz_sort_page_t * page, * p;
+  long serialno;
+  ogg_int64_t granulepos, unit;
+
+  serialno = ogg_page_serialno (og);
+  stream = oggz_get_stream (oggz, serialno);
+  if (stream == NULL) return -1;
+
+  if (oggz_sort_heap_reserve (writer, oggz_vector_size (oggz->streams)) != 0)
+    return -1;
+
+  page = oggz_malloc (sizeof (oggz_sort_page_t) + og->header_len +
+                      og->body_len);
+  if (page == NULL) return -1;
+
+  page->og.header = (unsigned char *)(page + 1);
+  page->og.header_len = og->header_len;
+  page->og.body = page->og.header + og->header_len;
+  page->og.body_len = og->body_len;
+  memcpy (page->og.header, og->header, og->header_len);
+  memcpy (page->og.body, og->body, og->body_len);
+
+  page->next = NULL;
+  page->unit = -1;
+  page->seq = writer->sort_seq++;
+  page->bos = ogg_page_bos (og);
+  page->keyed = 0;
+
+  if (stream->sort_tail != NULL) stream->sort_tail->next = page;
+  else stream->sort_head = page;
+  stream->sort_tail = page;
+  if (stream->sort_unkeyed == NULL) stream->sort_unkeyed = page;
+
+  /* Key this page and those before it on which no packet ended. Streams
+   * without a metric cannot be ordered, so their pages go first. */
+  granulepos = ogg_page_granulepos (og);
+  if (!oggz_sort_has_metric (oggz, stream)) {
+    unit = -1;
+  } else if (granulepos != -1) {
+    unit = oggz_stream_get_unit (oggz, stream, serialno, granulepos);
+    if (unit > stream->sort_unit) stream->sort_unit = unit;
+  } else if (ogg_page_eos (og)) {
+    unit = stream->sort_unit;
+  } else {
+    return 0;
+  }
+
+  for (p = stream->sort_unkeyed; p != NULL; p = p->next) {
+    p->unit = unit;
+    p->keyed = 1;
+  }
+  stream->sort_unkeyed = NULL;
+
+  if (ogg_page_eos (og)) stream->sort_ended = 1;
+
+  if (stream->sort_heap_index == -1) oggz_sort_heap_insert (writer, stream);
+
+  return 0;
+}
+
+/*
+ * Check whether the first page of a stream can be output: every other
+ * stream that is still being written must either have a page of the
+ * same time or later already held, or have been output to that time.
+ */
+static int
+oggz_sort_ready (OGGZ * oggz, oggz_stream_t * stream)
+{
+  oggz_stream_t * other;
+  ogg_int64_t unit = stream->sort_head->unit;
+  int i, size;
+
+  size = oggz_vector_size (oggz->streams);
+  for (i = 0; i < size; i++) {
+    other = (oggz_stream_t *)oggz_vector_nth_p (oggz->streams, i);
+    if (other == stream || other->sort_ended ||
+        other->sort_heap_index != -1 || unit <= other->sort_unit ||
+        !oggz_sort_may_have_metric (oggz, other))
+      continue;
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * oggz_sort_next (oggz)
+ *
+ * Sets oggz->current_page to the earliest held page, if it is ready.
+ *
+ * If this returns 0, no page is ready.
+ */
+static int
+oggz_sort_next (OGGZ * oggz)
+{
+  OggzWriter * writer = &oggz->x.writer;
+  oggz_stream_t * stream;
+  oggz_sort_page_t * page;
+
+  if (writer->sort_heap_nr == 0) return 0;
+
+  stream = writer->sort_heap[0];
+  if (!oggz_sort_ready (oggz, stream)) return 0;
+
+  page = stream->sort_head;
+  stream->sort_head = page->next;
+  if (stream->sort_head == NULL) stream->sort_tail = NULL;
+
+  if (stream->sort_head != NULL && stream->sort_head->keyed) {
+    oggz_sort_sift_down (writer, 0);
+  } else {
+    stream->sort_heap_index = -1;
+    if (--writer->sort_heap_nr > 0) {
+      oggz_sort_heap_set (writer, 0, writer->sort_heap[writer->sort_heap_nr]);
+      oggz_sort_sift_down (writer, 0);
+    }
+  }
+
+  writer->sort_out = page;
+  oggz->current_page = page->og;
+
+  return 1;
+}
+
 /*
  * oggz_page_init (oggz)
  *
@@ -383,36 +941,36 @@ static long
 oggz_page_init (OGGZ * oggz)
 {
   OggzWriter * writer;
-  ogg_stream_state * os;
-  ogg_page * og;
   int ret;
 
   if (oggz == NULL) return -1;
 
   writer = &oggz->x.writer;
-  os = writer->current_stream;
-  og = &oggz->current_page;
 
-  if (ALWAYS_FLUSH || writer->flushing) {
-#ifdef DEBUG
-    printf ("oggz_page_init: ATTEMPT FLUSH: ");
-#endif
-    ret = oggz_write_flush (oggz);
+  if (oggz->flags & OGGZ_SORT) {
+    /* The held page last output is finished with */
+    oggz_free (writer->sort_out);
+    writer->sort_out = NULL;
+
+    ret = 0;
+    while (oggz_page_make (oggz)) {
+      if (oggz_sort_hold (oggz) == -1) {
+        /* Out of memory: output the page as made, out of order */
+        ret = 1;
+        break;
+      }
+    }
+
+    if (!ret) ret = oggz_sort_next (oggz);
   } else {
-#ifdef DEBUG
-    printf ("oggz_page_init: ATTEMPT pageout: ");
-#endif
-    ret = ogg_stream_pageout (os, og);
+    ret = oggz_page_make (oggz);
   }
 
   if (ret) {
     writer->page_offset = 0;
+    OGGZ_STATS_ADD (oggz, pages_written, 1);
   }
 
-#ifdef DEBUG
-  printf ("%s\n", ret ? "OK" : "NO");
-#endif
-
   return ret;
 }
 
@@ -428,6 +986,7 @@ oggz_packet_init (OGGZ * oggz, oggz_writer_packet_t * next_zpacket)
   oggz_stream_t * stream;
   ogg_stream_state * os;
   ogg_packet * op;
+  long serialno;
 
   if (oggz == NULL) return -1L;
 
@@ -441,6 +1000,14 @@ oggz_packet_init (OGGZ * oggz, oggz_writer_packet_t * next_zpacket)
 
   stream = next_zpacket->stream;
 
+  /* Identify producer streams here, rather than in the producer's thread */
+  if (stream->producer != NULL) {
+    serialno = stream->ogg_stream.serialno;
+    if (op->b_o_s) oggz_auto_identify_packet (oggz, op, serialno);
+    if (!stream->metric && (oggz->flags & OGGZ_AUTO))
+      oggz_auto_read_bos_packet (oggz, op, serialno, NULL);
+  }
+
   /* Mark this stream as having delivered a non b_o_s packet if so */
   if (!op->b_o_s) stream->delivered_non_b_o_s = 1;
 
@@ -569,6 +1136,17 @@ oggz_page_writeout (OGGZ * oggz, long n)
   return h + b;
 }
 
+static oggz_writer_packet_t *
+oggz_writer_pop (OggzWriter * writer)
+{
+  oggz_writer_packet_t * zpacket;
+
+  zpacket = oggz_vector_pop (writer->packet_queue);
+  if (zpacket != NULL) writer->queue_bytes -= zpacket->op.bytes;
+
+  return zpacket;
+}
+
 static int
 oggz_dequeue_packet (OGGZ * oggz, oggz_writer_packet_t ** next_zpacket)
 {
@@ -582,12 +1160,16 @@ oggz_dequeue_packet (OGGZ * oggz, oggz_writer_packet_t ** next_zpacket)
     *next_zpacket = writer->next_zpacket;
     writer->next_zpacket = NULL;
   } else {
-    *next_zpacket = oggz_vector_pop (writer->packet_queue);
+    *next_zpacket = oggz_writer_pop (writer);
+    if (*next_zpacket == NULL)
+      *next_zpacket = oggz_writer_pop_producers (oggz);
 
     if (*next_zpacket == NULL) {
       if (writer->hungry) {
         ret = writer->hungry (oggz, 1, writer->hungry_user_data);
-        *next_zpacket = oggz_vector_pop (writer->packet_queue);
+        *next_zpacket = oggz_writer_pop (writer);
+        if (*next_zpacket == NULL)
+          *next_zpacket = oggz_writer_pop_producers (oggz);
 #ifdef DEBUG
         printf ("oggz_dequeue_packet: called hungry and popped, new queue size %d\n",
   	        oggz_vector_size (writer->packet_queue));
@@ -701,6 +1283,8 @@ oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
     return oggz_map_return_value_to_error (cb_ret);
   }
 
+  if (oggz_writer_producers_pending (writer)) writer->no_more_packets = 0;
+
   while (active && remaining > 0) {
     bytes = MIN (remaining, 1024);
 
@@ -747,13 +1331,17 @@ oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
         active = 0;
         cb_ret = OGGZ_ERR_SYSTEM; /* XXX: catch next */
       } else if (bytes_written == 0) {
-        if (writer->no_more_packets) {
+        if (writer->no_more_packets && !(oggz->flags & OGGZ_SORT)) {
           active = 0;
           break;
         } else if (!oggz_page_init (oggz)) {
 #ifdef DEBUG
           printf ("oggz_write_output: bytes_written == 0, DONE\n");
 #endif
+          if (writer->no_more_packets) {
+            active = 0;
+            break;
+          }
           writer->state = OGGZ_MAKING_PACKETS;
         }
       }
@@ -781,6 +1369,101 @@ oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
   return nwritten;
 }
 
+long
+oggz_write_next_page (OGGZ * oggz, const ogg_page ** og)
+{
+  OggzWriter * writer;
+  ogg_page * page;
+  long bytes = 0;
+  int active = 1, cb_ret = 0;
+
+  if (oggz == NULL) return OGGZ_ERR_BAD_OGGZ;
+
+  writer = &oggz->x.writer;
+
+  if (!(oggz->flags & OGGZ_WRITE) || og == NULL) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  if (writer->writing) return OGGZ_ERR_RECURSIVE_WRITE;
+
+  page = &oggz->current_page;
+
+  /* The rest of a page partly output as bytes must be output that way */
+  if (writer->state == OGGZ_WRITING_PAGES && writer->page_offset > 0 &&
+      writer->page_offset < page->header_len + page->body_len) {
+    return OGGZ_ERR_INVALID;
+  }
+
+  writer->writing = 1;
+
+#ifdef DEBUG
+  printf ("oggz_write_next_page: IN\n");
+#endif
+
+  if ((cb_ret = oggz->cb_next) != OGGZ_CONTINUE) {
+    oggz->cb_next = 0;
+    writer->writing = 0;
+    writer->no_more_packets = 0;
+    if (cb_ret == OGGZ_WRITE_EMPTY) cb_ret = 0;
+    return oggz_map_return_value_to_error (cb_ret);
+  }
+
+  if (oggz_writer_producers_pending (writer)) writer->no_more_packets = 0;
+
+  while (active && bytes == 0) {
+    while (writer->state == OGGZ_MAKING_PACKETS) {
+      if ((cb_ret = oggz_writer_make_packet (oggz)) != OGGZ_CONTINUE) {
+#ifdef DEBUG
+        printf ("oggz_write_next_page: no packets (cb_ret is %d)\n", cb_ret);
+#endif
+        if (cb_ret == OGGZ_WRITE_EMPTY) {
+          writer->flushing = 1;
+          writer->no_more_packets = 1;
+        }
+        /* As for oggz_write_output(), break out unconditionally */
+        active = 0;
+        break;
+      }
+      if (oggz_page_init (oggz)) {
+        writer->state = OGGZ_WRITING_PAGES;
+      } else if (writer->no_more_packets) {
+        active = 0;
+        break;
+      }
+    }
+
+    if (writer->state == OGGZ_WRITING_PAGES) {
+      if (writer->page_offset < page->header_len + page->body_len) {
+        /* Hand out the whole page, and mark it as output */
+        bytes = page->header_len + page->body_len;
+        writer->page_offset = bytes;
+        *og = page;
+      } else if (writer->no_more_packets && !(oggz->flags & OGGZ_SORT)) {
+        active = 0;
+      } else if (!oggz_page_init (oggz)) {
+        if (writer->no_more_packets) active = 0;
+        else writer->state = OGGZ_MAKING_PACKETS;
+      }
+    }
+  }
+
+#ifdef DEBUG
+  printf ("oggz_write_next_page: OUT %ld\n", bytes);
+#endif
+
+  writer->writing = 0;
+
+  if (bytes == 0) {
+    if (cb_ret == OGGZ_WRITE_EMPTY) cb_ret = 0;
+    return oggz_map_return_value_to_error (cb_ret);
+  } else {
+    oggz->cb_next = cb_ret;
+  }
+
+  return bytes;
+}
+
 long
 oggz_write (OGGZ * oggz, long n)
 {
@@ -811,6 +1494,8 @@ oggz_write (OGGZ * oggz, long n)
     return oggz_map_return_value_to_error (cb_ret);
   }
 
+  if (oggz_writer_producers_pending (writer)) writer->no_more_packets = 0;
+
   while (active && remaining > 0) {
     bytes = MIN (remaining, 1024);
 
@@ -879,13 +1564,17 @@ oggz_write (OGGZ * oggz, long n)
          * we set active to 0, break out of the loop, pack up our things and
          * go home.
          */
-        if (writer->no_more_packets) {
+        if (writer->no_more_packets && !(oggz->flags & OGGZ_SORT)) {
           active = 0;
           break;
         } else if (!oggz_page_init (oggz)) {
 #ifdef DEBUG
           printf ("oggz_write: bytes_written == 0, DONE\n");
 #endif
+          if (writer->no_more_packets) {
+            active = 0;
+            break;
+          }
           writer->state = OGGZ_MAKING_PACKETS;
         }
       }
@@ -973,6 +1662,12 @@ oggz_write_output (OGGZ * oggz, unsigned char * buf, long n)
   return OGGZ_ERR_DISABLED;
 }
 
+long
+oggz_write_next_page (OGGZ * oggz, const ogg_page ** og)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 long
 oggz_write (OGGZ * oggz, long n)
 {
@@ -985,4 +1680,22 @@ oggz_write_get_next_page_size (OGGZ * oggz)
   return OGGZ_ERR_DISABLED;
 }
 
+int
+oggz_write_set_queue_limits (OGGZ * oggz, long max_packets, long max_bytes)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_write_set_producer (OGGZ * oggz, long serialno, long max_packets)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
+int
+oggz_write_get_queue_space (OGGZ * oggz, long * packets, long * bytes)
+{
+  return OGGZ_ERR_DISABLED;
+}
+
 #endif
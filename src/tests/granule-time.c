@@ -0,0 +1,197 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* Units are milliseconds, as for streams identified by OGGZ_AUTO */
+#define MULT 1000
+
+static unsigned char packet_buf[1];
+
+static long
+new_stream (OGGZ * oggz)
+{
+  ogg_packet op;
+  long serialno;
+
+  serialno = oggz_serialno_new (oggz);
+
+  op.packet = packet_buf;
+  op.bytes = 1;
+  op.b_o_s = 1;
+  op.e_o_s = 0;
+  op.granulepos = 0;
+  op.packetno = 0;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Could not feed OGGZ");
+
+  return serialno;
+}
+
+/* granules * 10^9 * d / n, where granules is split by n so that no
+ * intermediate product overflows for the rates tested */
+static ogg_int64_t
+expected_time (ogg_int64_t granules, ogg_int64_t n, ogg_int64_t d)
+{
+  ogg_int64_t mult = 1000000000 * d;
+
+  return (granules / n) * mult + (granules % n) * mult / n;
+}
+
+static void
+check_linear (OGGZ * oggz, ogg_int64_t n, ogg_int64_t d)
+{
+  long serialno;
+  ogg_int64_t granulepos, time;
+
+  serialno = new_stream (oggz);
+  oggz_set_granulerate (oggz, serialno, n, MULT * d);
+
+  /* Granuleposes of increasing size, up to times of around 2^62 ns */
+  for (granulepos = 1;
+       granulepos / n < ((ogg_int64_t)1 << 62) / (1000000000 * d);
+       granulepos = granulepos * 2 + 1) {
+    time = oggz_granulepos_to_time (oggz, serialno, granulepos);
+    if (time != expected_time (granulepos, n, d))
+      FAIL ("Incorrect time for linear granulepos");
+    if (granulepos / n < 9000000000LL / d &&
+        time / 1000000 != granulepos * MULT * d / n)
+      FAIL ("Time in nanoseconds does not agree with units");
+  }
+}
+
+#define BATCH_LEN 1000
+
+/* Compare a batch conversion, both into a separate array and in place,
+ * against single conversions */
+static void
+check_batch (OGGZ * oggz, long serialno)
+{
+  ogg_int64_t in[BATCH_LEN], out[BATCH_LEN], inplace[BATCH_LEN];
+  ogg_int64_t granulepos = 0;
+  int i;
+
+  for (i = 0; i < BATCH_LEN; i++) {
+    if (i % 7 == 3) {
+      in[i] = -1;
+    } else {
+      granulepos += (i * 7919) % 1000;
+      in[i] = granulepos;
+    }
+  }
+  memcpy (inplace, in, sizeof (in));
+
+  if (oggz_granulepos_to_time_batch (oggz, serialno, in, out, BATCH_LEN) != 0)
+    FAIL ("Batch conversion failed");
+  if (oggz_granulepos_to_time_batch (oggz, serialno, inplace, inplace,
+                                     BATCH_LEN) != 0)
+    FAIL ("In-place batch conversion failed");
+
+  for (i = 0; i < BATCH_LEN; i++) {
+    if (out[i] != oggz_granulepos_to_time (oggz, serialno, in[i]))
+      FAIL ("Batch conversion does not match single conversion");
+    if (inplace[i] != out[i])
+      FAIL ("In-place batch conversion does not match");
+  }
+}
+
+static ogg_int64_t
+double_metric (OGGZ * oggz, long serialno, ogg_int64_t granulepos,
+               void * user_data)
+{
+  return granulepos * 2;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * oggz;
+  long serialno;
+  ogg_int64_t time;
+
+  INFO ("Converting granulepos to nanoseconds");
+
+  oggz = oggz_new (OGGZ_WRITE);
+  if (oggz == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  /* High-rate audio, where millisecond units lose precision */
+  check_linear (oggz, 192000, 1);
+  check_linear (oggz, 44100, 1);
+  /* NTSC video */
+  check_linear (oggz, 30000, 1001);
+
+  serialno = new_stream (oggz);
+  oggz_set_granulerate (oggz, serialno, 44100, MULT);
+  check_batch (oggz, serialno);
+
+  /* 25fps video, with keyframes every 64 frames */
+  serialno = new_stream (oggz);
+  oggz_set_granulerate (oggz, serialno, 25, MULT);
+  oggz_set_granuleshift (oggz, serialno, 6);
+
+  time = oggz_granulepos_to_time (oggz, serialno, (128 << 6) | 5);
+  if (time != 133 * 40000000LL)
+    FAIL ("Incorrect time for granuleshift granulepos");
+
+  if (oggz_granulepos_to_time (oggz, serialno, -1) != -1)
+    FAIL ("Granulepos -1 did not return -1");
+
+  if (oggz_granulepos_to_time (oggz, serialno + 1, 0) !=
+      OGGZ_ERR_BAD_SERIALNO)
+    FAIL ("Bad serialno not detected");
+
+  check_batch (oggz, serialno);
+
+  /* Custom metrics are taken to return milliseconds */
+  serialno = new_stream (oggz);
+  oggz_set_metric (oggz, serialno, double_metric, NULL);
+  if (oggz_granulepos_to_time (oggz, serialno, 1000) != 2000000000)
+    FAIL ("Incorrect time for custom metric");
+  check_batch (oggz, serialno);
+
+  serialno = new_stream (oggz);
+  oggz_set_metric (oggz, serialno, NULL, NULL);
+  if (oggz_granulepos_to_time (oggz, serialno, 1000) != -1)
+    FAIL ("Time returned for a stream without a metric");
+
+  oggz_close (oggz);
+
+  exit (0);
+}
@@ -0,0 +1,310 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN (256*1024)
+#define NR_PACKETS 1000
+#define PACKET_LEN 200
+#define GARBAGE_LEN 100
+
+static long serialno;
+
+static unsigned char * data_buf;
+static int offset_end = 0;
+static int my_offset = 0;
+
+static int read_called = 0;
+static long read_bytes = 0;
+static int write_called = 0;
+static long write_bytes = 0;
+static int seek_called = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, 'a' + iter % 26, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static size_t
+my_io_write (void * user_handle, void * buf, size_t n)
+{
+  if (offset_end + (long)n > DATA_BUF_LEN)
+    FAIL ("Too much data generated by writer");
+
+  memcpy (&data_buf[offset_end], buf, n);
+  offset_end += n;
+
+  write_called++;
+  write_bytes += n;
+
+  return n;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+
+  read_called++;
+  read_bytes += len;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  seek_called++;
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  return OGGZ_CONTINUE;
+}
+
+static void
+get_stats (OGGZ * oggz, OggzStats * stats)
+{
+  if (oggz_get_stats (oggz, stats) != 0)
+    FAIL ("Could not get stats");
+
+#ifdef DEBUG
+  printf ("bytes_read %" PRId64 " bytes_written %" PRId64 "\n"
+          "io_reads %" PRId64 " io_writes %" PRId64 " io_seeks %" PRId64 "\n"
+          "pages_read %" PRId64 " pages_written %" PRId64
+          " bytes_skipped %" PRId64 "\n"
+          "seeks %" PRId64 " seek_iterations %" PRId64
+          " (last %" PRId64 ") seek_reads %" PRId64 "\n"
+          "allocs %" PRId64 "\n",
+          stats->bytes_read, stats->bytes_written,
+          stats->io_reads, stats->io_writes, stats->io_seeks,
+          stats->pages_read, stats->pages_written, stats->bytes_skipped,
+          stats->seeks, stats->seek_iterations, stats->seek_iterations_last,
+          stats->seek_reads, stats->allocs);
+#endif
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  OggzStats stats;
+  ogg_int64_t iterations;
+  long n;
+
+  INFO ("Testing instrumentation counters");
+
+  if (!OGGZ_CONFIG_STATS) {
+    writer = oggz_new (OGGZ_WRITE);
+    if (oggz_get_stats (writer, &stats) != OGGZ_ERR_DISABLED)
+      FAIL ("Counters available although disabled");
+    oggz_close (writer);
+    exit (0);
+  }
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  /* Start the data with some bytes that are not part of any page */
+  memset (data_buf, 'x', GARBAGE_LEN);
+  offset_end = GARBAGE_LEN;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  if (oggz_get_stats (writer, NULL) != OGGZ_ERR_INVALID)
+    FAIL("NULL stats accepted");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  oggz_io_set_write (writer, my_io_write, NULL);
+
+  while ((n = oggz_write (writer, 4096)) > 0);
+
+  get_stats (writer, &stats);
+
+  if (stats.io_writes != write_called)
+    FAIL("Incorrect count of writes");
+
+  if (stats.bytes_written != write_bytes)
+    FAIL("Incorrect count of bytes written");
+
+  /* Each packet was flushed onto a page of its own */
+  if (stats.pages_written != NR_PACKETS)
+    FAIL("Incorrect count of pages written");
+
+  if (stats.allocs < NR_PACKETS)
+    FAIL("Packet allocations not counted");
+
+  if (stats.bytes_read != 0 || stats.pages_read != 0)
+    FAIL("Writer counted reads");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, NULL);
+  oggz_io_set_seek (reader, my_io_seek, NULL);
+  oggz_io_set_tell (reader, my_io_tell, NULL);
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  get_stats (reader, &stats);
+
+  if (stats.io_reads != read_called)
+    FAIL("Incorrect count of reads");
+
+  if (stats.bytes_read != read_bytes || stats.bytes_read != offset_end)
+    FAIL("Incorrect count of bytes read");
+
+  if (stats.pages_read != NR_PACKETS)
+    FAIL("Incorrect count of pages read");
+
+  if (stats.bytes_skipped != GARBAGE_LEN)
+    FAIL("Incorrect count of bytes skipped");
+
+  if (stats.seeks != 0 || stats.seek_iterations != 0)
+    FAIL("Seeks counted when reading");
+
+  /* Count one granule per millisecond */
+  if (oggz_set_granulerate (reader, serialno, 1000, 1000) != 0)
+    FAIL("Could not set granulerate");
+
+  if (oggz_seek_units (reader, 600, SEEK_SET) == -1)
+    FAIL("Seek failure");
+
+  get_stats (reader, &stats);
+
+  if (stats.seeks != 1)
+    FAIL("Incorrect count of seeks");
+
+  if (stats.seek_iterations_last < 1 ||
+      stats.seek_iterations != stats.seek_iterations_last)
+    FAIL("Incorrect count of seek iterations");
+
+  if (stats.seek_reads < 1)
+    FAIL("Seek probe reads not counted");
+
+  if (stats.io_seeks != seek_called)
+    FAIL("Incorrect count of io seeks");
+
+  if (stats.io_reads != read_called || stats.bytes_read != read_bytes)
+    FAIL("Incorrect count of reads after seeking");
+
+  iterations = stats.seek_iterations;
+
+  if (oggz_seek_units (reader, 200, SEEK_SET) == -1)
+    FAIL("Seek failure");
+
+  get_stats (reader, &stats);
+
+  if (stats.seeks != 2)
+    FAIL("Incorrect count of seeks");
+
+  if (stats.seek_iterations != iterations + stats.seek_iterations_last)
+    FAIL("Incorrect total of seek iterations");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  free (data_buf);
+
+  exit (0);
+}
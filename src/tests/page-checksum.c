@@ -0,0 +1,181 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 40
+
+static unsigned char header_copy[282];
+static unsigned char body_copy[65536];
+
+static void
+page_copy (ogg_page * dest, const ogg_page * src)
+{
+  memcpy (header_copy, src->header, src->header_len);
+  memcpy (body_copy, src->body, src->body_len);
+
+  dest->header = header_copy;
+  dest->header_len = src->header_len;
+  dest->body = body_copy;
+  dest->body_len = src->body_len;
+}
+
+static void
+check_against_full_checksum (ogg_page * og)
+{
+  unsigned char crc[4];
+
+  if (!oggz_page_checksum_verify (og))
+    FAIL ("Patched page failed verification");
+
+  memcpy (crc, og->header + 22, 4);
+  ogg_page_checksum_set (og);
+
+  if (memcmp (crc, og->header + 22, 4))
+    FAIL ("Incremental checksum differs from full recalculation");
+}
+
+static void
+test_page (ogg_page * og)
+{
+  ogg_page og_copy;
+  unsigned char data[8];
+  long offset;
+  int i;
+
+  if (!oggz_page_checksum_verify (og))
+    FAIL ("Valid page failed verification");
+
+  page_copy (&og_copy, og);
+  if (oggz_page_set_granulepos (&og_copy, -1) != 0)
+    FAIL ("Could not set granulepos");
+  if (ogg_page_granulepos (&og_copy) != -1)
+    FAIL ("Granulepos not set");
+  check_against_full_checksum (&og_copy);
+
+  page_copy (&og_copy, og);
+  if (oggz_page_set_eos (&og_copy, 1) != 0)
+    FAIL ("Could not set eos");
+  if (!ogg_page_eos (&og_copy))
+    FAIL ("Eos not set");
+  check_against_full_checksum (&og_copy);
+
+  if (oggz_page_set_eos (&og_copy, 0) != 0)
+    FAIL ("Could not clear eos");
+  if (ogg_page_eos (&og_copy))
+    FAIL ("Eos not cleared");
+  check_against_full_checksum (&og_copy);
+
+  oggz_page_set_eos (&og_copy, ogg_page_eos (og));
+  if (memcmp (og_copy.header, og->header, og->header_len))
+    FAIL ("Restoring eos did not restore original header");
+
+  /* Patch the serialno and page sequence number together */
+  page_copy (&og_copy, og);
+  for (i = 0; i < 8; i++) data[i] = (unsigned char)(rand () & 0xff);
+  if (oggz_page_patch_header (&og_copy, 14, data, 8) != 0)
+    FAIL ("Could not patch header");
+  check_against_full_checksum (&og_copy);
+
+  /* Disallowed patches */
+  for (offset = 19; offset < 26; offset++) {
+    if (oggz_page_patch_header (&og_copy, offset, data, 4) == 0)
+      FAIL ("Allowed patch of checksum field");
+  }
+  if (oggz_page_patch_header (&og_copy, og_copy.header_len - 2, data, 4) == 0)
+    FAIL ("Allowed patch beyond end of header");
+
+  /* Corrupt the body */
+  if (og->body_len > 0) {
+    page_copy (&og_copy, og);
+    og_copy.body[og_copy.body_len / 2] ^= 0x01;
+    if (oggz_page_checksum_verify (&og_copy))
+      FAIL ("Corrupt page passed verification");
+  }
+}
+
+int
+main (int argc, char * argv[])
+{
+  ogg_stream_state os;
+  ogg_packet op;
+  ogg_page og;
+  unsigned char buf[9000];
+  int i, nr_pages = 0;
+
+  INFO ("Testing incremental page checksum updates");
+
+  ogg_stream_init (&os, 0x12345678);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    memset (buf, 'a' + (i % 26), sizeof (buf));
+
+    op.packet = buf;
+    op.bytes = (i * 997) % sizeof (buf);
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = i;
+    op.packetno = i;
+
+    ogg_stream_packetin (&os, &op);
+
+    while (ogg_stream_pageout (&os, &og) > 0) {
+      test_page (&og);
+      nr_pages++;
+    }
+  }
+
+  while (ogg_stream_flush (&os, &og) > 0) {
+    test_page (&og);
+    nr_pages++;
+  }
+
+  ogg_stream_clear (&os);
+
+#ifdef DEBUG
+  printf ("Tested %d pages\n", nr_pages);
+#endif
+
+  if (nr_pages < 2)
+    FAIL ("Too few pages generated");
+
+  exit (0);
+}
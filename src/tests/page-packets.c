@@ -0,0 +1,193 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 100
+#define MAX_PACKET 20000
+
+static unsigned char assembled[MAX_PACKET];
+static long assembled_bytes = 0;
+static long next_packetno = 0;
+
+static long
+packet_size (long packetno)
+{
+  /* Include empty packets, packets of multiples of 255 bytes, and
+   * packets spanning several pages */
+  switch (packetno % 7) {
+  case 0: return 0;
+  case 1: return 255;
+  case 2: return 510;
+  default: return (packetno * 4513) % MAX_PACKET;
+  }
+}
+
+static void
+check_packet (void)
+{
+  long i;
+
+  if (next_packetno >= NR_PACKETS)
+    FAIL ("Too many packets found");
+
+  if (assembled_bytes != packet_size (next_packetno))
+    FAIL ("Packet has incorrect size");
+
+  for (i = 0; i < assembled_bytes; i++) {
+    if (assembled[i] != (unsigned char)(next_packetno + i))
+      FAIL ("Packet contains incorrect data");
+  }
+
+  next_packetno++;
+  assembled_bytes = 0;
+}
+
+static void
+test_page (ogg_page * og)
+{
+  OggzPagePackets iter;
+  OggzPagePacket pp;
+  int ret, first = 1, segments = 0, last_complete = 1;
+
+  if (oggz_page_packets_init (&iter, og) != 0)
+    FAIL ("Could not iterate over page");
+
+  while ((ret = oggz_page_packets_next (&iter, &pp)) == 1) {
+#ifdef DEBUG
+    printf ("segment %d (%d): %ld bytes%s%s\n", pp.segment, pp.segments,
+            pp.bytes, pp.continued ? " continued" : "",
+            pp.complete ? " complete" : "");
+#endif
+
+    if (pp.segment != segments)
+      FAIL ("Packet does not follow previous packet");
+    segments += pp.segments;
+
+    if (pp.data < og->body || pp.data + pp.bytes > og->body + og->body_len)
+      FAIL ("Packet data is not within page body");
+
+    if (pp.continued != (first && ogg_page_continued (og)))
+      FAIL ("Packet has incorrect continued flag");
+
+    if (!pp.continued && assembled_bytes != 0)
+      FAIL ("Previous packet was not completed");
+
+    memcpy (assembled + assembled_bytes, pp.data, pp.bytes);
+    assembled_bytes += pp.bytes;
+
+    if (pp.complete) check_packet ();
+
+    last_complete = pp.complete;
+    first = 0;
+  }
+
+  if (ret != 0)
+    FAIL ("Error iterating over page");
+
+  if (segments != og->header[26])
+    FAIL ("Not all segments of page were visited");
+
+  if (og->header[26] > 0 &&
+      last_complete != (og->header[27 + og->header[26] - 1] < 255))
+    FAIL ("Last packet has incorrect complete flag");
+}
+
+int
+main (int argc, char * argv[])
+{
+  ogg_stream_state os;
+  ogg_packet op;
+  ogg_page og;
+  OggzPagePackets iter;
+  OggzPagePacket pp;
+  unsigned char buf[MAX_PACKET];
+  long i, j;
+  int nr_pages = 0;
+
+  INFO ("Testing iteration over the packets of a page");
+
+  ogg_stream_init (&os, 0x12345678);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    op.bytes = packet_size (i);
+    for (j = 0; j < op.bytes; j++)
+      buf[j] = (unsigned char)(i + j);
+
+    op.packet = buf;
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = i;
+    op.packetno = i;
+
+    ogg_stream_packetin (&os, &op);
+
+    while (ogg_stream_pageout (&os, &og) > 0) {
+      test_page (&og);
+      nr_pages++;
+    }
+  }
+
+  while (ogg_stream_flush (&os, &og) > 0) {
+    test_page (&og);
+    nr_pages++;
+  }
+
+  if (next_packetno != NR_PACKETS)
+    FAIL ("Not all packets found");
+
+  if (nr_pages < 10)
+    FAIL ("Too few pages generated");
+
+  INFO ("+ Rejecting a page whose segment table overruns its body");
+
+  /* Truncate the body of the last page */
+  og.body_len -= 1;
+  if (oggz_page_packets_init (&iter, &og) != 0)
+    FAIL ("Could not iterate over page");
+  while (oggz_page_packets_next (&iter, &pp) == 1);
+  if (oggz_page_packets_next (&iter, &pp) != OGGZ_ERR_INVALID)
+    FAIL ("Overrun of page body not detected");
+
+  ogg_stream_clear (&os);
+
+  exit (0);
+}
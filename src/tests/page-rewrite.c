@@ -0,0 +1,259 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 200
+#define MAX_PAGES 512
+
+#define FILENAME1 "page-rewrite-1.ogg"
+#define FILENAME2 "page-rewrite-2.ogg"
+
+static oggz_off_t page_offsets[MAX_PAGES];
+static int nr_pages = 0;
+
+static void
+write_page (FILE * file, ogg_page * og, oggz_off_t * offset)
+{
+  if (nr_pages >= MAX_PAGES)
+    FAIL ("Too many pages generated");
+
+  page_offsets[nr_pages++] = *offset;
+
+  if (fwrite (og->header, 1, og->header_len, file) != (size_t)og->header_len ||
+      fwrite (og->body, 1, og->body_len, file) != (size_t)og->body_len)
+    FAIL ("Could not write test file");
+
+  *offset += og->header_len + og->body_len;
+}
+
+static void
+write_file (const char * filename)
+{
+  ogg_stream_state os;
+  ogg_packet op;
+  ogg_page og;
+  unsigned char buf[3000];
+  oggz_off_t offset = 0;
+  FILE * file;
+  int i;
+
+  if ((file = fopen (filename, "wb")) == NULL)
+    FAIL ("Could not open test file");
+
+  nr_pages = 0;
+  ogg_stream_init (&os, 0x12345678);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    memset (buf, 'a' + (i % 26), sizeof (buf));
+
+    op.packet = buf;
+    op.bytes = (i * 997) % sizeof (buf);
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = i;
+    op.packetno = i;
+
+    ogg_stream_packetin (&os, &op);
+
+    while (ogg_stream_pageout (&os, &og) > 0)
+      write_page (file, &og, &offset);
+  }
+
+  while (ogg_stream_flush (&os, &og) > 0)
+    write_page (file, &og, &offset);
+
+  ogg_stream_clear (&os);
+  fclose (file);
+}
+
+/*
+ * Read back all the pages of a file, checking that each has a valid
+ * checksum and is where it was written
+ */
+static void
+check_file (const char * filename, ogg_page * pages, unsigned char * data,
+            long * len)
+{
+  ogg_sync_state oy;
+  char * buffer;
+  FILE * file;
+  long n, pos = 0;
+  int i = 0;
+
+  if ((file = fopen (filename, "rb")) == NULL)
+    FAIL ("Could not reopen test file");
+
+  *len = (long) fread (data, 1, 4*1024*1024, file);
+  fclose (file);
+
+  ogg_sync_init (&oy);
+  buffer = ogg_sync_buffer (&oy, *len);
+  memcpy (buffer, data, *len);
+  ogg_sync_wrote (&oy, *len);
+
+  while ((n = ogg_sync_pageseek (&oy, &pages[i])) != 0) {
+    if (n < 0)
+      FAIL ("Rewritten page failed checksum");
+    if (i >= nr_pages || pos != page_offsets[i])
+      FAIL ("Rewritten page moved");
+    pos += n;
+    i++;
+  }
+
+  /* Keep the pages valid after the sync state is freed */
+  for (n = 0; n < i; n++) {
+    pages[n].header = data + (pages[n].header - (unsigned char *)buffer);
+    pages[n].body = data + (pages[n].body - (unsigned char *)buffer);
+  }
+
+  ogg_sync_clear (&oy);
+
+  if (i != nr_pages)
+    FAIL ("Pages lost by rewrite");
+}
+
+static OggzPageEdit edits[3*MAX_PAGES];
+
+static long
+build_edits (void)
+{
+  long n = 0;
+  int i;
+
+  /* Edits are given in reverse file order, with several per page */
+  for (i = nr_pages - 1; i >= 0; i--) {
+    edits[n].offset = page_offsets[i];
+    edits[n].type = OGGZ_PAGE_EDIT_GRANULEPOS;
+    edits[n].value = 1000 + i;
+    n++;
+
+    if (i == nr_pages / 2) {
+      edits[n].offset = page_offsets[i];
+      edits[n].type = OGGZ_PAGE_EDIT_EOS;
+      edits[n].value = 1;
+      n++;
+    }
+
+    if (i % 3 == 0) {
+      /* Overwrite the page sequence number, then the granulepos again */
+      edits[n].offset = page_offsets[i];
+      edits[n].type = OGGZ_PAGE_EDIT_BYTES;
+      edits[n].header_offset = 18;
+      edits[n].length = 4;
+      edits[n].data[0] = (unsigned char)(i & 0xff);
+      edits[n].data[1] = 0xaa;
+      edits[n].data[2] = 0;
+      edits[n].data[3] = 0;
+      n++;
+
+      edits[n].offset = page_offsets[i];
+      edits[n].type = OGGZ_PAGE_EDIT_GRANULEPOS;
+      edits[n].value = 2000 + i;
+      n++;
+    }
+  }
+
+  return n;
+}
+
+static ogg_page pages1[MAX_PAGES], pages2[MAX_PAGES];
+static unsigned char data1[4*1024*1024], data2[4*1024*1024];
+
+int
+main (int argc, char * argv[])
+{
+  OggzPageEdit bad;
+  long nedits, len1, len2, ret;
+  int i;
+
+  INFO ("Testing in-place page header rewriting");
+
+  write_file (FILENAME1);
+  write_file (FILENAME2);
+
+  if (nr_pages < 16)
+    FAIL ("Too few pages generated");
+
+  nedits = build_edits ();
+
+  if ((ret = oggz_page_rewrite (FILENAME1, edits, nedits, 1)) != nedits)
+    FAIL ("Sequential rewrite failed");
+
+  if ((ret = oggz_page_rewrite (FILENAME2, edits, nedits, 4)) != nedits)
+    FAIL ("Parallel rewrite failed");
+
+  check_file (FILENAME1, pages1, data1, &len1);
+  check_file (FILENAME2, pages2, data2, &len2);
+
+  if (len1 != len2 || memcmp (data1, data2, len1))
+    FAIL ("Parallel rewrite differs from sequential rewrite");
+
+  for (i = 0; i < nr_pages; i++) {
+    if (ogg_page_granulepos (&pages1[i]) != (i % 3 ? 1000 : 2000) + i)
+      FAIL ("Granulepos not rewritten");
+    if (!ogg_page_eos (&pages1[i]) != !(i == nr_pages / 2 || i == nr_pages - 1))
+      FAIL ("Eos flag not rewritten");
+    if (i % 3 == 0 && ogg_page_pageno (&pages1[i]) != (0xaa00 | (i & 0xff)))
+      FAIL ("Page sequence number not rewritten");
+  }
+
+  /* An edit at an offset where there is no page */
+  memset (&bad, 0, sizeof (bad));
+  bad.offset = page_offsets[1] + 1;
+  bad.type = OGGZ_PAGE_EDIT_GRANULEPOS;
+  if (oggz_page_rewrite (FILENAME1, &bad, 1, 1) != OGGZ_ERR_INVALID)
+    FAIL ("Allowed edit of a page which does not exist");
+
+  /* An edit of the checksum field */
+  bad.offset = page_offsets[1];
+  bad.type = OGGZ_PAGE_EDIT_BYTES;
+  bad.header_offset = 22;
+  bad.length = 4;
+  if (oggz_page_rewrite (FILENAME1, &bad, 1, 1) != OGGZ_ERR_INVALID)
+    FAIL ("Allowed edit of checksum field");
+
+  remove (FILENAME1);
+  remove (FILENAME2);
+
+  exit (0);
+}
@@ -0,0 +1,293 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+/*
+ * A long track of one small packet per page, each marked with its
+ * number. Reading it must not grow the packet index without bound.
+ */
+
+#define DATA_BUF_LEN (4*1024*1024)
+#define NR_PACKETS 40000
+#define PACKET_LEN 20
+#define INDEX_MAX 4096
+
+static long serialno;
+
+static int offset_end = 0;
+static int my_offset = 0;
+
+static long found_packet;
+static long nr_read;
+
+static long
+generate (unsigned char * data_buf)
+{
+  OGGZ * writer;
+  ogg_packet op;
+  unsigned char buf[PACKET_LEN];
+  long i, n = 0, w;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  memset (buf, 'D', PACKET_LEN);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    buf[0] = (unsigned char)(i >> 8);
+    buf[1] = (unsigned char)(i & 0xff);
+
+    op.packet = buf;
+    op.bytes = PACKET_LEN;
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = i;
+    op.packetno = i;
+
+    if (oggz_write_feed (writer, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+      FAIL ("Oggz write failed");
+
+    while ((w = oggz_write_output (writer, data_buf + n,
+                                   DATA_BUF_LEN - n)) > 0)
+      n += w;
+  }
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  return n;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  long packetno;
+
+  packetno = (op->packet[0] << 8) | op->packet[1];
+
+  if (op->bytes != PACKET_LEN)
+    FAIL ("Packet has incorrect length");
+
+  if (op->packetno != packetno)
+    FAIL ("Packet has incorrect packetno");
+
+  found_packet = op->packetno;
+  nr_read++;
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+read_packet_stop (OGGZ * oggz, oggz_packet * zp, long serialno,
+                  void * user_data)
+{
+  read_packet (oggz, zp, serialno, user_data);
+  return OGGZ_STOP_OK;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static ogg_int64_t
+index_entries (OGGZ * oggz)
+{
+  OggzStats stats;
+
+  if (oggz_get_stats (oggz, &stats) != 0)
+    FAIL ("Could not get stats");
+
+#ifdef DEBUG
+  printf ("index_entries %" PRId64 "\n", stats.index_entries);
+#endif
+
+  return stats.index_entries;
+}
+
+static void
+read_all (OGGZ * reader)
+{
+  long n;
+
+  nr_read = 0;
+
+  while ((n = oggz_read (reader, 4096)) > 0);
+
+  if (n != 0)
+    FAIL ("Error reading track");
+
+  if (nr_read != NR_PACKETS)
+    FAIL ("Not all packets were read");
+}
+
+static void
+try_seek_packets (OGGZ * reader, long packetno)
+{
+  long n;
+
+  if (oggz_seek_packets (reader, serialno, packetno, SEEK_SET) != packetno)
+    FAIL ("Seek did not return the packet expected");
+
+  /* A stop is also reported by the read following it */
+  found_packet = -1;
+  while (found_packet == -1) {
+    n = oggz_read (reader, 4096);
+    if (n == 0 || (n < 0 && n != OGGZ_ERR_STOP_OK)) break;
+  }
+
+  if (found_packet != packetno)
+    FAIL ("Reading did not resume at the packet sought");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  unsigned char * data_buf;
+  long i;
+
+  INFO ("Testing the packet index stays bounded");
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  offset_end = generate (data_buf);
+
+  INFO ("+ Reading a long track which cannot seek");
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  my_offset = 0;
+  read_all (reader);
+
+  if (OGGZ_CONFIG_STATS && index_entries (reader) != 0)
+    FAIL ("Packets indexed although the input cannot seek");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  INFO ("+ Reading a long track which can seek");
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  my_offset = 0;
+  read_all (reader);
+
+  if (OGGZ_CONFIG_STATS &&
+      (index_entries (reader) == 0 || index_entries (reader) > INDEX_MAX))
+    FAIL ("Packet index is not bounded");
+
+  INFO ("+ Seeking by packet number in the sparse index");
+  oggz_set_read_callback (reader, -1, read_packet_stop, NULL);
+
+  try_seek_packets (reader, NR_PACKETS - 1);
+  try_seek_packets (reader, 0);
+  try_seek_packets (reader, 1);
+  for (i = 0; i < NR_PACKETS; i += 997) {
+    try_seek_packets (reader, (i * 7919) % NR_PACKETS);
+  }
+
+  if (OGGZ_CONFIG_STATS && index_entries (reader) > INDEX_MAX)
+    FAIL ("Packet index is not bounded after seeking");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  free (data_buf);
+
+  exit (0);
+}
@@ -0,0 +1,167 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 11
+#define CORRUPT_PAGE 5
+
+static long serialno;
+
+static unsigned char data[4096];
+static long data_len = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[64];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, 'a' + iter, sizeof (buf));
+
+  op.packet = buf;
+  op.bytes = sizeof (buf);
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  int * nr_pages = (int *)user_data;
+
+  (*nr_pages)++;
+
+  return 0;
+}
+
+static int
+count_pages (int flags)
+{
+  OGGZ * reader;
+  int nr_pages = 0;
+
+  reader = oggz_new (OGGZ_READ | flags);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, &nr_pages);
+
+  oggz_read_input (reader, data, data_len);
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+#ifdef DEBUG
+  printf ("flags 0x%x: read %d pages\n", flags, nr_pages);
+#endif
+
+  return nr_pages;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  long n, offset;
+  int i;
+
+  INFO ("Testing read with and without page checksum verification");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data + data_len,
+                                 sizeof (data) - data_len)) > 0) {
+    data_len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  if (count_pages (0) != NR_PACKETS)
+    FAIL ("Incorrect page count reading intact data");
+
+  if (count_pages (OGGZ_NOCRC) != NR_PACKETS)
+    FAIL ("Incorrect page count reading intact data with OGGZ_NOCRC");
+
+  /* Corrupt the last body byte of one page */
+  offset = 0;
+  for (i = 0; i <= CORRUPT_PAGE; i++) {
+    long header_len = 27 + data[offset + 26];
+    long body_len = 0;
+    int j;
+
+    for (j = 0; j < data[offset + 26]; j++)
+      body_len += data[offset + 27 + j];
+
+    offset += header_len + body_len;
+  }
+  data[offset - 1] ^= 0x20;
+
+  INFO ("+ Reading data containing a corrupt page");
+
+  if (count_pages (0) != NR_PACKETS - 1)
+    FAIL ("Corrupt page was not skipped");
+
+  if (count_pages (OGGZ_NOCRC) != NR_PACKETS)
+    FAIL ("Corrupt page was not delivered with OGGZ_NOCRC");
+
+  exit (0);
+}
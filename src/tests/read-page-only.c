@@ -0,0 +1,199 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 100
+#define BUF_SIZE 1000000
+
+static unsigned char data[BUF_SIZE];
+static long data_len = 0;
+static long nr_pages = 0;
+
+static long
+packet_size (long packetno)
+{
+  /* A mix of small packets and packets spanning several pages */
+  return (packetno * 2311) % 12000 + 1;
+}
+
+static int
+write_packets (long serialno)
+{
+  OGGZ * writer;
+  unsigned char buf[12000];
+  ogg_packet op;
+  long n, i;
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    op.bytes = packet_size (i);
+    memset (buf, 'a' + (i % 26), op.bytes);
+    op.packet = buf;
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = i;
+    op.packetno = i;
+
+    if (oggz_write_feed (writer, &op, serialno, 0, NULL) != 0)
+      FAIL ("Oggz write failed");
+  }
+
+  while ((n = oggz_write_output (writer, data + data_len,
+                                 BUF_SIZE - data_len)) > 0) {
+    data_len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL ("Could not close OGGZ writer");
+
+  return 0;
+}
+
+typedef struct {
+  long switch_page;
+  long pages;
+  long next_packetno;
+} PageOnlyData;
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  PageOnlyData * pod = (PageOnlyData *)user_data;
+  ogg_packet * op = &zp->op;
+
+#ifdef DEBUG
+  printf ("page %ld: packetno %" PRId64 " (%ld bytes)\n",
+          pod->pages, op->packetno, op->bytes);
+#endif
+
+  if (pod->next_packetno != -1 && op->packetno != pod->next_packetno)
+    FAIL ("Packet delivered out of sequence");
+
+  if (op->packetno < 0 || op->packetno >= NR_PACKETS)
+    FAIL ("Packet has incorrect packetno");
+
+  if (op->bytes != packet_size (op->packetno))
+    FAIL ("Packet has incorrect size");
+
+  if (op->packet[0] != 'a' + (op->packetno % 26) ||
+      op->packet[op->bytes-1] != 'a' + (op->packetno % 26))
+    FAIL ("Packet contains incorrect data");
+
+  if (op->granulepos != -1 && op->granulepos != op->packetno)
+    FAIL ("Packet has incorrect granulepos");
+
+  pod->next_packetno = op->packetno + 1;
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  PageOnlyData * pod = (PageOnlyData *)user_data;
+
+  pod->pages++;
+
+  /* Start assembling packets part way through the stream */
+  if (pod->pages == pod->switch_page)
+    oggz_set_read_callback (oggz, serialno, read_packet, pod);
+
+  return OGGZ_CONTINUE;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  PageOnlyData pod;
+  long serialno = 7;
+  long switch_page;
+
+  INFO ("Testing page-only reading");
+
+  write_packets (serialno);
+
+  /* Read pages only, to count them */
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    FAIL ("newly created OGGZ reader == NULL");
+
+  pod.switch_page = -1;
+  pod.pages = 0;
+  pod.next_packetno = -1;
+  oggz_set_read_page (reader, -1, read_page, &pod);
+
+  if (oggz_read_input (reader, data, data_len) != data_len)
+    FAIL ("Page-only read failed");
+
+  oggz_close (reader);
+
+  nr_pages = pod.pages;
+  if (nr_pages < 16)
+    FAIL ("Too few pages generated");
+
+  /* Switch to reading packets at each page in turn */
+  INFO ("+ Switching from page-only to packet reading");
+
+  for (switch_page = 1; switch_page <= nr_pages; switch_page++) {
+    if ((reader = oggz_new (OGGZ_READ)) == NULL)
+      FAIL ("newly created OGGZ reader == NULL");
+
+    pod.switch_page = switch_page;
+    pod.pages = 0;
+    pod.next_packetno = -1;
+    oggz_set_read_page (reader, -1, read_page, &pod);
+
+    if (oggz_read_input (reader, data, data_len) != data_len)
+      FAIL ("Read failed");
+
+    if (pod.pages != nr_pages)
+      FAIL ("Pages lost after switching to packet reading");
+
+    if (pod.next_packetno != NR_PACKETS)
+      FAIL ("Last packet not delivered");
+
+    oggz_close (reader);
+  }
+
+  exit (0);
+}
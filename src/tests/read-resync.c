@@ -0,0 +1,192 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 20
+
+static long serialno;
+
+static unsigned char pages[65536];
+static long pages_len = 0;
+
+static unsigned char data[131072];
+static long data_len = 0;
+
+static oggz_off_t page_offsets[NR_PACKETS];
+static int nr_pages_read = 0;
+
+/* Junk inserted between pages, including partial capture patterns */
+static const char * junk[] = {
+  "", "O", "Og", "Ogg", "OggOgg", "OOg", "xOgx", "OgOggOg", "zzzzOg"
+};
+#define NR_JUNK (sizeof (junk) / sizeof (junk[0]))
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[300];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, 'a' + iter, sizeof (buf));
+
+  op.packet = buf;
+  op.bytes = 10 + iter * 13;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  if (nr_pages_read >= NR_PACKETS)
+    FAIL ("Too many pages read");
+
+#ifdef DEBUG
+  printf ("page %d at %llx (expected %llx)\n", nr_pages_read,
+          (long long)oggz_tell (oggz),
+          (long long)page_offsets[nr_pages_read]);
+#endif
+
+  if (oggz_tell (oggz) != page_offsets[nr_pages_read])
+    FAIL ("Page read at incorrect offset");
+
+  if (ogg_page_pageno (og) != nr_pages_read)
+    FAIL ("Page read out of sequence");
+
+  nr_pages_read++;
+
+  return 0;
+}
+
+static void
+read_in_blocks (long blocksize)
+{
+  OGGZ * reader;
+  long offset, n;
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, NULL);
+
+  nr_pages_read = 0;
+
+  for (offset = 0; offset < data_len; offset += n) {
+    n = MIN (blocksize, data_len - offset);
+    if (oggz_read_input (reader, data + offset, n) != n)
+      FAIL ("Could not input data");
+  }
+
+  if (nr_pages_read != NR_PACKETS)
+    FAIL ("Not all pages were read");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  long n, offset, page_len;
+  long blocksizes[] = {1, 3, 27, 100, 4096, 131072};
+  int i, j;
+
+  INFO ("Testing resynchronisation on junk between pages");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, pages + pages_len,
+                                 sizeof (pages) - pages_len)) > 0) {
+    pages_len += n;
+  }
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  /* Interleave junk with the generated pages */
+  offset = 0;
+  for (i = 0; i < NR_PACKETS; i++) {
+    const char * j_str = junk[i % NR_JUNK];
+
+    memcpy (data + data_len, j_str, strlen (j_str));
+    data_len += strlen (j_str);
+
+    page_len = 27 + pages[offset + 26];
+    for (j = 0; j < pages[offset + 26]; j++)
+      page_len += pages[offset + 27 + j];
+
+    page_offsets[i] = data_len;
+    memcpy (data + data_len, pages + offset, page_len);
+    data_len += page_len;
+    offset += page_len;
+  }
+
+  if (offset != pages_len)
+    FAIL ("Generated data does not consist of whole pages");
+
+  for (i = 0; i < (int)(sizeof (blocksizes) / sizeof (blocksizes[0])); i++) {
+    read_in_blocks (blocksizes[i]);
+  }
+
+  exit (0);
+}
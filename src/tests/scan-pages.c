@@ -0,0 +1,293 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PACKETS 2000
+#define MAX_PAGES 8000
+#define FAKE_PAGE_MAX 256
+
+static long serialno;
+
+static unsigned char * data_buf = NULL;
+static long offset_end = 0;
+static long my_offset = 0;
+
+/* A complete page with a valid checksum, embedded in packet data */
+static unsigned char fake_page[FAKE_PAGE_MAX];
+static long fake_page_len = 0;
+
+static oggz_off_t page_offsets[MAX_PAGES];
+static long nr_pages = 0;
+
+static void
+make_fake_page (void)
+{
+  OGGZ * oggz;
+  ogg_packet op;
+  unsigned char buf[100];
+
+  if ((oggz = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  memset (buf, 'f', sizeof (buf));
+  op.packet = buf;
+  op.bytes = sizeof (buf);
+  op.b_o_s = 1;
+  op.e_o_s = 1;
+  op.granulepos = 0;
+  op.packetno = 0;
+
+  if (oggz_write_feed (oggz, &op, oggz_serialno_new (oggz), 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  fake_page_len = oggz_write_output (oggz, fake_page, FAKE_PAGE_MAX);
+  if (fake_page_len <= 0)
+    FAIL ("Could not write fake page");
+
+  oggz_close (oggz);
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[4000];
+  ogg_packet op;
+  static int iter = 0;
+  long len, i;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  len = 500 + (iter * 7919) % 3000;
+  memset (buf, 'a' + iter % 26, len);
+  for (i = iter % 300; i + fake_page_len < len; i += 700) {
+    memcpy (&buf[i], fake_page, fake_page_len);
+  }
+
+  op.packet = buf;
+  op.bytes = len;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static void
+write_data (void)
+{
+  OGGZ * writer;
+  long n, data_len = 0;
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL ("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL ("Could not set hungry callback");
+
+  do {
+    if (offset_end + 65536 > data_len) {
+      data_len += 1024*1024;
+      if ((data_buf = realloc (data_buf, data_len)) == NULL)
+        FAIL ("Out of memory");
+    }
+    n = oggz_write_output (writer, data_buf + offset_end, 65536);
+    offset_end += n;
+  } while (n > 0);
+
+  oggz_close (writer);
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  long len;
+
+  len = MIN ((long)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  if (nr_pages >= MAX_PAGES)
+    FAIL ("Too many pages");
+
+  page_offsets[nr_pages++] = oggz_tell (oggz);
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+scan_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  long * count = (long *)user_data;
+
+  if (*count >= nr_pages)
+    FAIL ("Scan found extra pages");
+
+  if (oggz_tell (oggz) != page_offsets[*count])
+    FAIL ("Scan found a page not found by reading");
+
+  if (ogg_page_pageno ((ogg_page *)og) != *count)
+    FAIL ("Scan found pages out of order");
+
+  (*count)++;
+
+  return OGGZ_CONTINUE;
+}
+
+static void
+check_scan (OGGZ * reader, int nthreads)
+{
+  long count = 0, n;
+
+#ifdef DEBUG
+  printf ("scanning with %d threads\n", nthreads);
+#endif
+
+  n = oggz_scan_pages (reader, nthreads, scan_page, &count);
+  if (n < 0)
+    FAIL ("Scan failed");
+
+  if (n != nr_pages || count != nr_pages)
+    FAIL ("Scan did not find all pages");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  FILE * file;
+  oggz_off_t offset_at;
+
+  INFO ("Scanning pages in parallel");
+
+  make_fake_page ();
+  write_data ();
+
+  /* Find the pages with a sequential read */
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    FAIL ("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, NULL);
+  oggz_io_set_seek (reader, my_io_seek, NULL);
+  oggz_io_set_tell (reader, my_io_tell, NULL);
+
+  oggz_set_read_page (reader, -1, read_page, NULL);
+  while (oggz_read (reader, 65536) > 0);
+
+#ifdef DEBUG
+  printf ("%ld pages in %ld bytes\n", nr_pages, offset_end);
+#endif
+
+  if (nr_pages < 100)
+    FAIL ("Too few pages read");
+
+  /* Scanning through IO callbacks restores the read position */
+  offset_at = oggz_seek (reader, 0, SEEK_SET);
+  check_scan (reader, 4);
+  if (oggz_tell (reader) != offset_at || my_offset != offset_at)
+    FAIL ("Scan changed read position");
+
+  oggz_close (reader);
+
+  /* Scan a file in several threads */
+  if ((file = tmpfile ()) == NULL)
+    FAIL ("Could not create temporary file");
+
+  if (fwrite (data_buf, 1, offset_end, file) != (size_t)offset_end)
+    FAIL ("Could not write temporary file");
+  fflush (file);
+
+  if ((reader = oggz_open_stdio (file, OGGZ_READ)) == NULL)
+    FAIL ("Could not open temporary file");
+
+  check_scan (reader, 1);
+  check_scan (reader, 4);
+  check_scan (reader, 16);
+
+  /* This also closes file */
+  oggz_close (reader);
+
+  free (data_buf);
+
+  exit (0);
+}
@@ -0,0 +1,346 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+/*
+ * A data track whose packets carry clip ids, several packets to a clip,
+ * interleaved with a second track which has no order. Some data packets
+ * carry no clip id, and are unordered. Some are large enough to span
+ * pages.
+ */
+
+#define DATA_BUF_LEN (8*1024*1024)
+#define NR_CLIPS 1300
+#define CLIP_PACKETS 3
+#define NR_PACKETS (NR_CLIPS * CLIP_PACKETS)
+#define LARGE_LEN 9000
+#define OTHER_LEN 200
+
+/* Reads allowed for one seek */
+#define MAX_SEEK_READS 16
+
+static long data_serialno;
+static long other_serialno;
+
+static int read_called = 0;
+static int offset_end = 0;
+static int my_offset = 0;
+
+static long target_clip;
+static long first_clip;
+static long found_packet;
+static long early_bytes;
+
+static long
+packet_len (long packetno)
+{
+  if (packetno % 13 == 7) return LARGE_LEN;
+  return 100 + (packetno * 37) % 1000;
+}
+
+static int
+packet_ordered (long packetno)
+{
+  return (packetno % 10 != 9);
+}
+
+static void
+feed (OGGZ * oggz, long serialno, unsigned char * buf, long bytes,
+      ogg_int64_t packetno, int e_o_s)
+{
+  ogg_packet op;
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = e_o_s;
+  op.granulepos = packetno;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+}
+
+static long
+generate (unsigned char * data_buf)
+{
+  OGGZ * writer;
+  unsigned char buf[LARGE_LEN];
+  long i, n = 0, w;
+  int e_o_s;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  data_serialno = oggz_serialno_new (writer);
+  other_serialno = oggz_serialno_new (writer);
+
+  memset (buf, 0, LARGE_LEN);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    /* Each packet is marked with whether it is ordered, its clip id and
+     * its number */
+    buf[0] = packet_ordered (i) ? 'C' : 'U';
+    buf[1] = (unsigned char)((i / CLIP_PACKETS) >> 8);
+    buf[2] = (unsigned char)((i / CLIP_PACKETS) & 0xff);
+    buf[3] = (unsigned char)(i >> 8);
+    buf[4] = (unsigned char)(i & 0xff);
+
+    e_o_s = (i == NR_PACKETS - 1);
+    feed (writer, data_serialno, buf, packet_len (i), i, e_o_s);
+    feed (writer, other_serialno, buf, OTHER_LEN, i, e_o_s);
+
+    while ((w = oggz_write_output (writer, data_buf + n,
+                                   DATA_BUF_LEN - n)) > 0)
+      n += w;
+  }
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  return n;
+}
+
+static int
+clip_order (OGGZ * oggz, ogg_packet * op, void * target, void * user_data)
+{
+  long clip, wanted = *(long *)target;
+
+  if (op->bytes < 5)
+    FAIL ("Order called on a truncated packet");
+
+  if ((op->packet[3] << 8 | op->packet[4]) >= NR_PACKETS ||
+      op->bytes != packet_len (op->packet[3] << 8 | op->packet[4]))
+    FAIL ("Order called on an incomplete packet");
+
+  if (op->packet[0] != 'C') return 2;
+
+  clip = (op->packet[1] << 8) | op->packet[2];
+
+  if (clip < wanted) return -1;
+  if (clip > wanted) return 1;
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  long clip, packetno;
+
+  if (serialno != data_serialno) return OGGZ_CONTINUE;
+
+  clip = (op->packet[1] << 8) | op->packet[2];
+  packetno = (op->packet[3] << 8) | op->packet[4];
+
+  if (first_clip == -1) first_clip = clip;
+
+  if (clip < target_clip) {
+    early_bytes += op->bytes;
+    return OGGZ_CONTINUE;
+  }
+
+  found_packet = packetno;
+
+  return OGGZ_STOP_OK;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+  read_called++;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static void
+try_seek_byorder (OGGZ * reader, long clip)
+{
+  long result, n;
+  int reads;
+
+  target_clip = clip;
+
+  reads = read_called;
+  result = oggz_seek_byorder (reader, &target_clip);
+  reads = read_called - reads;
+
+#ifdef DEBUG
+  printf ("clip %ld: @%ld after %d reads\n", clip, result, reads);
+#endif
+
+  if (result < 0)
+    FAIL ("Seek failed");
+
+  if (reads > MAX_SEEK_READS)
+    FAIL ("Seek used too many reads");
+
+  first_clip = -1;
+  found_packet = -1;
+  early_bytes = 0;
+
+  while (found_packet == -1) {
+    n = oggz_read (reader, 4096);
+    if (n == 0 || (n < 0 && n != OGGZ_ERR_STOP_OK)) break;
+  }
+
+  if (clip <= 0) {
+    if (found_packet != 0)
+      FAIL ("Reading did not resume at the start");
+    return;
+  }
+
+  if (clip >= NR_CLIPS) {
+    if (found_packet != -1)
+      FAIL ("Packets found beyond the last clip");
+    return;
+  }
+
+  /* Reading resumes before the first packet of the clip, at most a page
+   * before it */
+  if (found_packet != clip * CLIP_PACKETS)
+    FAIL ("Reading did not reach the first packet of the clip");
+
+  if (first_clip >= clip)
+    FAIL ("Reading resumed too late");
+
+  if (early_bytes > 65536 + LARGE_LEN)
+    FAIL ("Reading resumed too early");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  unsigned char * data_buf;
+  long i;
+
+  INFO ("Testing seeking by OggzOrder");
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  offset_end = generate (data_buf);
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+
+  /* Seeking with no order set fails */
+  target_clip = 10;
+  if (oggz_seek_byorder (reader, &target_clip) != -1)
+    FAIL ("Seek with no order did not fail");
+
+  /* Read the bos pages, then order the data track only */
+  oggz_read (reader, 1024);
+  if (oggz_set_order (reader, data_serialno, clip_order, NULL) != 0)
+    FAIL ("Could not set order");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  INFO ("+ Seeking to clips");
+  try_seek_byorder (reader, 500);
+  try_seek_byorder (reader, 1);
+  try_seek_byorder (reader, 1000);
+  try_seek_byorder (reader, 999);
+  try_seek_byorder (reader, 3);
+  try_seek_byorder (reader, NR_CLIPS - 1);
+
+  INFO ("+ Seeking before the first and beyond the last clip");
+  try_seek_byorder (reader, 0);
+  try_seek_byorder (reader, NR_CLIPS);
+
+  INFO ("+ Seeking around the whole track");
+  for (i = 0; i < NR_CLIPS; i += 37) {
+    try_seek_byorder (reader, (i * 7919) % NR_CLIPS);
+  }
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  free (data_buf);
+
+  exit (0);
+}
@@ -0,0 +1,269 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN (256*1024)
+#define NR_PACKETS 1000
+#define PACKET_LEN 200
+
+static long serialno;
+static int read_called = 0;
+static long read_bytes = 0;
+
+static int offset_end = 0;
+static int my_offset = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[PACKET_LEN];
+  ogg_packet op;
+  static int iter = 0;
+
+  if (iter >= NR_PACKETS) return 1;
+
+  memset (buf, 'a' + iter % 26, PACKET_LEN);
+
+  op.packet = buf;
+  op.bytes = PACKET_LEN;
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == NR_PACKETS - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  if (oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  iter++;
+
+  return 0;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+
+  read_called++;
+  read_bytes += len;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static void
+try_seek (OGGZ * reader, ogg_int64_t units)
+{
+  ogg_int64_t result;
+
+  result = oggz_seek_units (reader, units, SEEK_SET);
+
+#ifdef DEBUG
+  printf ("seek %" PRId64 ": %" PRId64 " after %d reads, %ld bytes\n",
+          units, result, read_called, read_bytes);
+#endif
+
+  if (result == -1)
+    FAIL ("Seek failure");
+
+  if (result > units)
+    FAIL ("Seek went past target");
+
+  if (units - result > 1)
+    FAIL ("Seek did not find the page before target");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader, * writer;
+  unsigned char * data_buf, * page;
+  int reads;
+  long n, w;
+
+  INFO ("Testing seek probe reads and page cache");
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  serialno = oggz_serialno_new (writer);
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  n = 0;
+  while ((w = oggz_write_output (writer, data_buf + n, DATA_BUF_LEN - n)) > 0)
+    n += w;
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  /* Start with only the first half of the data available */
+  offset_end = (NR_PACKETS / 2) * (n / NR_PACKETS);
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+
+  /* Read the bos page, then count one granule per millisecond */
+  oggz_read (reader, 256);
+  if (oggz_set_granulerate (reader, serialno, 1000, 1000) != 0)
+    FAIL("Could not set granulerate");
+
+  /* The duration is found once, and found again when the file grows */
+  if (oggz_get_duration (reader) != NR_PACKETS/2 - 1)
+    FAIL("Incorrect duration");
+
+  reads = read_called;
+  if (oggz_get_duration (reader) != NR_PACKETS/2 - 1)
+    FAIL("Incorrect duration on second query");
+  if (read_called != reads)
+    FAIL("Duration was not remembered");
+
+  offset_end = n;
+  if (oggz_get_duration (reader) != NR_PACKETS - 1)
+    FAIL("Duration not updated after the file grew");
+
+  read_called = 0;
+  read_bytes = 0;
+
+  /* Bisection reads a small part of the file */
+  try_seek (reader, 600);
+  if (read_bytes >= offset_end / 2)
+    FAIL("Seek read too much of the file");
+
+  /* Scrubbing back and forth near the same point hits the page cache */
+  try_seek (reader, 200);
+  try_seek (reader, 600);
+  try_seek (reader, 200);
+
+  reads = read_called;
+  try_seek (reader, 600);
+  try_seek (reader, 200);
+  if (read_called != reads)
+    FAIL("Repeated seeks were not served from the page cache");
+
+  /* Replacing the read method drops cached pages */
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  reads = read_called;
+  try_seek (reader, 600);
+  if (read_called == reads)
+    FAIL("Page cache survived a change of read method");
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  /* Give the page for 310 the granulepos of 900, leaving its CRC stale */
+  page = data_buf + 310 * (n / NR_PACKETS);
+  if (memcmp (page, "OggS", 4) != 0)
+    FAIL("Pages are not of equal length");
+  page[7] = 900 >> 8;
+  page[6] = 900 & 0xff;
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+
+  oggz_read (reader, 256);
+  if (oggz_set_granulerate (reader, serialno, 1000, 1000) != 0)
+    FAIL("Could not set granulerate");
+
+  /* Walking on from a verified page must still check the corrupt one */
+  try_seek (reader, 300);
+  try_seek (reader, 320);
+  try_seek (reader, 600);
+  try_seek (reader, 320);
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  free (data_buf);
+
+  exit (0);
+}
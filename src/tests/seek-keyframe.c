@@ -0,0 +1,279 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+/*
+ * A video track of NR_FRAMES frames at 25 fps with a keyframe every
+ * KEYFRAME_INTERVAL frames, interleaved with an audio track of 40ms
+ * packets. Keyframes are large enough to span several pages.
+ */
+
+#define DATA_BUF_LEN (2*1024*1024)
+#define NR_FRAMES 1000
+#define GRANULESHIFT 5
+#define KEYFRAME_INTERVAL 32
+#define KEYFRAME_LEN 9000
+#define FRAME_LEN 400
+#define AUDIO_LEN 100
+
+/* Reads allowed for one keyframe seek */
+#define MAX_SEEK_READS 12
+
+static long video_serialno;
+static long audio_serialno;
+
+static int read_called = 0;
+static int offset_end = 0;
+static int my_offset = 0;
+
+static long first_video_frame;
+static long found_keyframe;
+static long wanted_keyframe;
+
+static void
+feed (OGGZ * oggz, long serialno, unsigned char * buf, long bytes,
+      ogg_int64_t granulepos, ogg_int64_t packetno)
+{
+  ogg_packet op;
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = 0;
+  op.granulepos = granulepos;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER, NULL) != 0)
+    FAIL ("Oggz write failed");
+}
+
+static long
+generate (unsigned char * data_buf)
+{
+  OGGZ * writer;
+  unsigned char buf[KEYFRAME_LEN];
+  long i, keyframe, n = 0, w;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  video_serialno = oggz_serialno_new (writer);
+  audio_serialno = oggz_serialno_new (writer);
+
+  memset (buf, 'H', KEYFRAME_LEN);
+  feed (writer, video_serialno, buf, 1, 0, 0);
+  feed (writer, audio_serialno, buf, 1, 0, 0);
+
+  for (i = 0; i < NR_FRAMES; i++) {
+    keyframe = i - (i % KEYFRAME_INTERVAL);
+
+    /* Each frame is marked with its number, and whether it is a keyframe */
+    buf[0] = (i == keyframe) ? 'K' : 'P';
+    buf[1] = (unsigned char)(i >> 8);
+    buf[2] = (unsigned char)(i & 0xff);
+
+    feed (writer, video_serialno, buf,
+          (i == keyframe) ? KEYFRAME_LEN : FRAME_LEN,
+          (keyframe << GRANULESHIFT) + (i - keyframe), i + 1);
+    feed (writer, audio_serialno, buf, AUDIO_LEN, (i + 1) * 320, i + 1);
+
+    while ((w = oggz_write_output (writer, data_buf + n,
+                                   DATA_BUF_LEN - n)) > 0)
+      n += w;
+  }
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  return n;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  long frame;
+
+  if (serialno != video_serialno || op->bytes == 1) return 0;
+
+  frame = (op->packet[1] << 8) | op->packet[2];
+
+  if (first_video_frame == -1) first_video_frame = frame;
+
+  if (found_keyframe == -1 && frame >= wanted_keyframe) {
+    if (op->packet[0] != 'K')
+      FAIL ("Keyframe not found after seeking");
+    found_keyframe = frame;
+  }
+
+  return 0;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+  read_called++;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static void
+try_seek_keyframe (OGGZ * reader, long frame)
+{
+  ogg_int64_t units, result;
+  long keyframe, reads;
+
+  units = frame * 40;
+  keyframe = frame - (frame % KEYFRAME_INTERVAL);
+
+  result = oggz_seek_keyframe (reader, units, &reads);
+
+#ifdef DEBUG
+  printf ("frame %ld (keyframe %ld): u%" PRId64 " after %ld reads\n",
+          frame, keyframe, result, reads);
+#endif
+
+  if (result != keyframe * 40)
+    FAIL ("Seek did not return the unit of the keyframe");
+
+  if (reads > MAX_SEEK_READS)
+    FAIL ("Seek used too many reads");
+
+  first_video_frame = -1;
+  found_keyframe = -1;
+  wanted_keyframe = keyframe;
+  while (found_keyframe == -1 && oggz_read (reader, 4096) > 0);
+
+  /* Reading resumes no later than the keyframe, and at most one frame
+   * before it */
+  if (found_keyframe != keyframe)
+    FAIL ("Reading did not reach the keyframe");
+
+  if (first_video_frame < keyframe - 1)
+    FAIL ("Reading resumed too early");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  unsigned char * data_buf;
+
+  INFO ("Testing keyframe seeking");
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  offset_end = generate (data_buf);
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+
+  /* Read the bos pages, then describe both tracks */
+  oggz_read (reader, 1024);
+  if (oggz_set_granulerate (reader, video_serialno, 25, 1000) != 0)
+    FAIL("Could not set video granulerate");
+  if (oggz_set_granuleshift (reader, video_serialno, GRANULESHIFT) != 0)
+    FAIL("Could not set video granuleshift");
+  if (oggz_set_granulerate (reader, audio_serialno, 8000, 1000) != 0)
+    FAIL("Could not set audio granulerate");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  try_seek_keyframe (reader, 500);
+  try_seek_keyframe (reader, 31);
+  try_seek_keyframe (reader, 777);
+  try_seek_keyframe (reader, 64);
+  try_seek_keyframe (reader, 95);
+  try_seek_keyframe (reader, 999);
+  try_seek_keyframe (reader, 200);
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  free (data_buf);
+
+  exit (0);
+}
@@ -0,0 +1,317 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+/*
+ * A data track of NR_PACKETS packets, some of several per page and some
+ * spanning pages, interleaved with a second track of small packets.
+ * Each data packet is marked with its number.
+ */
+
+#define DATA_BUF_LEN (4*1024*1024)
+#define NR_PACKETS 2000
+#define LARGE_LEN 9000
+#define OTHER_LEN 50
+
+static long data_serialno;
+static long other_serialno;
+
+static int read_called = 0;
+static int seek_called = 0;
+static int offset_end = 0;
+static int my_offset = 0;
+
+static long found_packet;
+
+static long
+packet_len (long packetno)
+{
+  if (packetno % 17 == 5) return LARGE_LEN;
+  if (packetno % 3 == 0) return 3;
+  return 300 + (packetno * 37) % 700;
+}
+
+static void
+feed (OGGZ * oggz, long serialno, unsigned char * buf, long bytes,
+      ogg_int64_t packetno, int e_o_s)
+{
+  ogg_packet op;
+
+  op.packet = buf;
+  op.bytes = bytes;
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = e_o_s;
+  op.granulepos = packetno;
+  op.packetno = packetno;
+
+  if (oggz_write_feed (oggz, &op, serialno, 0, NULL) != 0)
+    FAIL ("Oggz write failed");
+}
+
+static long
+generate (unsigned char * data_buf)
+{
+  OGGZ * writer;
+  unsigned char buf[LARGE_LEN];
+  long i, n = 0, w;
+  int e_o_s;
+
+  writer = oggz_new (OGGZ_WRITE);
+  if (writer == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  data_serialno = oggz_serialno_new (writer);
+  other_serialno = oggz_serialno_new (writer);
+
+  memset (buf, 'D', LARGE_LEN);
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    buf[0] = (unsigned char)(i >> 8);
+    buf[1] = (unsigned char)(i & 0xff);
+
+    e_o_s = (i == NR_PACKETS - 1);
+    feed (writer, data_serialno, buf, packet_len (i), i, e_o_s);
+    feed (writer, other_serialno, buf, OTHER_LEN, i, e_o_s);
+
+    while ((w = oggz_write_output (writer, data_buf + n,
+                                   DATA_BUF_LEN - n)) > 0)
+      n += w;
+  }
+
+  if (n >= DATA_BUF_LEN)
+    FAIL("Too much data generated by writer");
+
+  if (oggz_close (writer) != 0)
+    FAIL("Could not close OGGZ writer");
+
+  return n;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  long packetno;
+
+  if (serialno != data_serialno) return OGGZ_CONTINUE;
+
+  packetno = (op->packet[0] << 8) | op->packet[1];
+
+#ifdef DEBUG
+  printf ("read packet %ld (packetno %" PRId64 ")\n", packetno,
+          op->packetno);
+#endif
+
+  if (op->bytes != packet_len (packetno))
+    FAIL ("Packet has incorrect length");
+
+  if (op->packetno != packetno)
+    FAIL ("Packet has incorrect packetno");
+
+  if ((op->e_o_s != 0) != (packetno == NR_PACKETS - 1))
+    FAIL ("Packet has incorrect e_o_s");
+
+  found_packet = packetno;
+
+  return OGGZ_STOP_OK;
+}
+
+static size_t
+my_io_read (void * user_handle, void * buf, size_t n)
+{
+  unsigned char * data_buf = (unsigned char *)user_handle;
+  int len;
+
+  len = MIN ((int)n, offset_end - my_offset);
+  memcpy (buf, &data_buf[my_offset], len);
+
+  my_offset += len;
+  read_called++;
+
+  return len;
+}
+
+static int
+my_io_seek (void * user_handle, long offset, int whence)
+{
+  switch (whence) {
+  case SEEK_SET:
+    my_offset = offset;
+    break;
+  case SEEK_CUR:
+    my_offset += offset;
+    break;
+  case SEEK_END:
+    my_offset = offset_end + offset;
+    break;
+  default:
+    return -1;
+  }
+
+  seek_called++;
+
+  return 0;
+}
+
+static long
+my_io_tell (void * user_handle)
+{
+  return my_offset;
+}
+
+static long
+read_data_packet (OGGZ * reader)
+{
+  long n;
+
+  found_packet = -1;
+
+  /* A stop is also reported by the read following it */
+  while (found_packet == -1) {
+    n = oggz_read (reader, 4096);
+    if (n == 0 || (n < 0 && n != OGGZ_ERR_STOP_OK)) break;
+  }
+
+  return found_packet;
+}
+
+static void
+try_seek_packets (OGGZ * reader, long packets, int whence, long expected)
+{
+  long result;
+
+  result = oggz_seek_packets (reader, data_serialno, packets, whence);
+
+#ifdef DEBUG
+  printf ("seek %ld (whence %d): %ld\n", packets, whence, result);
+#endif
+
+  if (result != expected)
+    FAIL ("Seek did not return the packet expected");
+
+  if (read_data_packet (reader) != expected)
+    FAIL ("Reading did not resume at the packet sought");
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * reader;
+  unsigned char * data_buf;
+  int reads, seeks;
+  long i;
+
+  INFO ("Testing seeking by packet number");
+
+  data_buf = malloc (DATA_BUF_LEN);
+  if (data_buf == NULL)
+    FAIL("Could not allocate data buffer");
+
+  offset_end = generate (data_buf);
+
+  reader = oggz_new (OGGZ_READ);
+  if (reader == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_io_set_read (reader, my_io_read, data_buf);
+  oggz_io_set_seek (reader, my_io_seek, data_buf);
+  oggz_io_set_tell (reader, my_io_tell, data_buf);
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+
+  /* Read the start of the data track */
+  for (i = 0; i < 100; i++) {
+    if (read_data_packet (reader) != i)
+      FAIL ("Packets not read in order");
+  }
+
+  INFO ("+ Seeking beyond the packets read");
+  try_seek_packets (reader, 1500, SEEK_SET, 1500);
+
+  INFO ("+ Seeking to packets already indexed");
+  try_seek_packets (reader, 37, SEEK_SET, 37);
+  try_seek_packets (reader, 1234, SEEK_SET, 1234);
+  try_seek_packets (reader, 0, SEEK_SET, 0);
+  try_seek_packets (reader, 5, SEEK_SET, 5);
+  try_seek_packets (reader, 6, SEEK_SET, 6);
+
+  INFO ("+ Stepping forward without I/O");
+  reads = read_called;
+  seeks = seek_called;
+  if (oggz_seek_packets (reader, data_serialno, 1, SEEK_CUR) != 8)
+    FAIL ("Relative seek did not return the packet expected");
+  if (oggz_seek_packets (reader, data_serialno, 2, SEEK_CUR) != 10)
+    FAIL ("Relative seek did not return the packet expected");
+  if (read_called != reads || seek_called != seeks)
+    FAIL ("Relative seek by a few packets used I/O");
+  if (read_data_packet (reader) != 10)
+    FAIL ("Reading did not resume at the packet sought");
+
+  try_seek_packets (reader, -3, SEEK_CUR, 8);
+  try_seek_packets (reader, 300, SEEK_CUR, 309);
+
+  INFO ("+ Seeking from the end");
+  try_seek_packets (reader, -1, SEEK_END, NR_PACKETS - 1);
+  try_seek_packets (reader, -NR_PACKETS, SEEK_END, 0);
+
+  INFO ("+ Seeking to packets which do not exist");
+  if (oggz_seek_packets (reader, data_serialno, NR_PACKETS, SEEK_SET) != -1)
+    FAIL ("Seek beyond the last packet did not fail");
+  if (oggz_seek_packets (reader, data_serialno, -1, SEEK_SET) != -1)
+    FAIL ("Seek before the first packet did not fail");
+  if (read_data_packet (reader) != 1)
+    FAIL ("Failed seek moved the reader");
+
+  INFO ("+ Seeking around the whole track");
+  for (i = 0; i < NR_PACKETS; i += 97) {
+    try_seek_packets (reader, (i * 7919) % NR_PACKETS, SEEK_SET,
+                      (i * 7919) % NR_PACKETS);
+  }
+
+  if (oggz_close (reader) != 0)
+    FAIL("Could not close OGGZ reader");
+
+  free (data_buf);
+
+  exit (0);
+}
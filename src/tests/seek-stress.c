@@ -49,6 +49,12 @@
 static int has_skeleton = 0;
 static int verbose = 0;
 
+/* Probes made by seeks, as counted by oggz_get_stats() */
+static long nr_seeks = 0;
+static ogg_int64_t total_probes = 0;
+static ogg_int64_t total_reads = 0;
+static ogg_int64_t max_probes = 0;
+
 static int
 read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 {
@@ -71,17 +77,29 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 static ogg_int64_t
 try_seek_units (OGGZ * oggz, ogg_int64_t units)
 {
-  ogg_int64_t result, diff;
+  OggzStats before, after;
+  ogg_int64_t result, diff, probes, reads;
 
   if (verbose)
     printf ("\tAttempt seek to %" PRId64 " ms:\n", units);
 
+  oggz_get_stats (oggz, &before);
   result = oggz_seek_units (oggz, units, SEEK_SET);
+  oggz_get_stats (oggz, &after);
   diff = result - units;
 
+  probes = after.seek_iterations - before.seek_iterations;
+  reads = after.seek_reads - before.seek_reads;
+
+  nr_seeks++;
+  total_probes += probes;
+  total_reads += reads;
+  if (probes > max_probes) max_probes = probes;
+
   if (verbose)
-    printf ("\t%0" PRId64 "x: %" PRId64 " ms (%+" PRId64 " ms)\n",
-	    oggz_tell (oggz), oggz_tell_units (oggz), diff);
+    printf ("\t%0" PRId64 "x: %" PRId64 " ms (%+" PRId64 " ms) "
+            "%" PRId64 " probes, %" PRId64 " reads\n",
+	    oggz_tell (oggz), oggz_tell_units (oggz), diff, probes, reads);
 
   if (result < 0) {
     FAIL ("Seek failure\n");
@@ -105,19 +123,22 @@ main (int argc, char * argv[])
   OGGZ * oggz;
   ogg_int64_t max_units;
   char * filename = NULL;
+  double limit = 0.0;
   int i;
   long n;
 
   for (i = 1; i < argc; i++) {
     if (!strcmp (argv[i], "--verbose")) {
       verbose = 1;
+    } else if (!strcmp (argv[i], "--max-probes") && i+1 < argc) {
+      limit = atof (argv[++i]);
     } else {
       filename = argv[i];
     }
   }
 
   if (filename == NULL) {
-    printf ("usage: %s [--verbose] filename\n", argv[0]);
+    printf ("usage: %s [--verbose] [--max-probes n] filename\n", argv[0]);
     exit(1);
   }
 
@@ -146,6 +167,18 @@ main (int argc, char * argv[])
   try_seek_units (oggz, 999 * max_units / 1000);
   try_seek_units (oggz, max_units / 100);
 
+  /* A spread of targets, visited out of order, for the probe counts */
+  for (i = 0; i < 64; i++) {
+    try_seek_units (oggz, ((i * 37) % 64) * max_units / 64);
+  }
+
+  printf ("\t%ld seeks: %.2f probes, %.2f reads per seek (max %" PRId64
+          " probes)\n", nr_seeks, (double)total_probes / nr_seeks,
+          (double)total_reads / nr_seeks, max_probes);
+
+  if (limit > 0.0 && (double)total_probes / nr_seeks > limit)
+    FAIL ("Too many probes per seek");
+
   oggz_close (oggz);
 
   exit (0);
@@ -0,0 +1,183 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN (256*1024)
+
+#define NR_PACKETS 60
+
+static long serialno1 = 1001, serialno2 = 2002;
+
+static int hungry_iter = 0;
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  unsigned char buf[6000];
+  ogg_packet op;
+  long serialno;
+  int flush = 0;
+
+  if (hungry_iter >= NR_PACKETS) return 1;
+
+  serialno = (hungry_iter%2) ? serialno1 : serialno2;
+
+  /* A mix of small packets and packets spanning several pages */
+  op.bytes = (hungry_iter % 7 == 0) ? 5557 : 100 + hungry_iter;
+  memset (buf, 'a' + hungry_iter % 26, op.bytes);
+
+  op.packet = buf;
+  op.b_o_s = (hungry_iter < 2);
+  op.e_o_s = (hungry_iter >= NR_PACKETS - 2);
+  op.granulepos = hungry_iter/2;
+  op.packetno = hungry_iter/2;
+
+  if (hungry_iter % 11 == 0) flush = OGGZ_FLUSH_AFTER;
+
+  if (oggz_write_feed (oggz, &op, serialno, flush, NULL) != 0)
+    FAIL ("Oggz write failed");
+
+  hungry_iter++;
+
+  return 0;
+}
+
+static OGGZ *
+new_writer (void)
+{
+  OGGZ * writer;
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  hungry_iter = 0;
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 1, NULL) == -1)
+    FAIL("Could not set hungry callback");
+
+  return writer;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  const ogg_page * og;
+  static unsigned char bytes_buf[DATA_BUF_LEN];
+  static unsigned char pages_buf[DATA_BUF_LEN];
+  long bytes_len = 0, pages_len = 0, n, end;
+  int pages = 0;
+
+  INFO ("Testing oggz_write_next_page()");
+
+  /* The reference: the same packets output as a byte stream */
+  writer = new_writer ();
+  while ((n = oggz_write_output (writer, bytes_buf + bytes_len,
+                                 1000)) > 0) {
+    bytes_len += n;
+    if (bytes_len + 1000 > DATA_BUF_LEN) FAIL ("Output too long");
+  }
+  end = n;
+  oggz_close (writer);
+
+  if (bytes_len == 0)
+    FAIL ("No data generated by oggz_write_output()");
+
+  writer = new_writer ();
+  while ((n = oggz_write_next_page (writer, &og)) > 0) {
+    if (n != og->header_len + og->body_len)
+      FAIL ("Return value is not the page length");
+
+    if (og->header_len < 27 || memcmp (og->header, "OggS", 4))
+      FAIL ("Page does not begin with a page header");
+
+    if (!oggz_page_checksum_verify (og))
+      FAIL ("Page checksum does not verify");
+
+    if (pages_len + n > DATA_BUF_LEN) FAIL ("Output too long");
+
+    memcpy (pages_buf + pages_len, og->header, og->header_len);
+    memcpy (pages_buf + pages_len + og->header_len, og->body, og->body_len);
+    pages_len += n;
+    pages++;
+  }
+
+  if (n != end)
+    FAIL ("oggz_write_next_page() ended differently to oggz_write_output()");
+
+  if (pages < 2)
+    FAIL ("Too few pages generated");
+
+  if (pages_len != bytes_len || memcmp (pages_buf, bytes_buf, bytes_len))
+    FAIL ("Pages differ from the output of oggz_write_output()");
+
+  oggz_close (writer);
+
+  INFO ("Testing oggz_write_next_page() after partial output");
+
+  writer = new_writer ();
+
+  if (oggz_write_next_page (writer, NULL) != OGGZ_ERR_INVALID)
+    FAIL ("NULL page location not rejected");
+
+  if (oggz_write_output (writer, bytes_buf, 10) != 10)
+    FAIL ("Could not output start of first page");
+
+  if (oggz_write_next_page (writer, &og) != OGGZ_ERR_INVALID)
+    FAIL ("Page handed out after part of it was output");
+
+  /* Finishing the page as bytes allows whole pages again */
+  n = oggz_write_get_next_page_size (writer);
+  if (oggz_write_output (writer, bytes_buf + 10, n) != n)
+    FAIL ("Could not output rest of first page");
+
+  if (oggz_write_next_page (writer, &og) <= 0)
+    FAIL ("No page after completing a partial page");
+
+  if (og->header_len + og->body_len > bytes_len - 10 - n ||
+      memcmp (og->header, pages_buf + 10 + n, og->header_len))
+    FAIL ("Second page differs");
+
+  oggz_close (writer);
+
+  exit (0);
+}
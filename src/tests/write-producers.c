@@ -0,0 +1,381 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define NR_PRODUCERS 4
+#define NR_PACKETS 2000
+
+/* Small enough that producers often find their queue full */
+#define QUEUE_PACKETS 16
+
+#define DATA_BUF_LEN (4*1024*1024)
+
+#ifdef HAVE_PTHREAD
+
+/* In the OGGZ_AUTO run, each stream is Vorbis at its own sample rate */
+static const long rates[NR_PRODUCERS] = {8000, 16000, 32000, 48000};
+
+static int use_auto = 0;
+
+static int read_iter[NR_PRODUCERS];
+static ogg_int64_t prev_unit = -1;
+
+static long
+producer_serialno (int p)
+{
+  return 1000 + p;
+}
+
+/* Each stream has its own packet duration, in ms */
+static long
+packet_ms (int p)
+{
+  return 10 + 10 * p;
+}
+
+static ogg_int64_t
+packet_granulepos (int p, int iter)
+{
+  if (!use_auto) return iter;
+
+  /* Three Vorbis headers, then data */
+  if (iter < 3) return 0;
+  return (ogg_int64_t)(iter - 2) * packet_ms (p) * rates[p] / 1000;
+}
+
+static ogg_int64_t
+page_unit (int p, ogg_int64_t granulepos)
+{
+  if (!use_auto) return granulepos * packet_ms (p);
+  return granulepos * 1000 / rates[p];
+}
+
+static ogg_int64_t
+metric (OGGZ * oggz, long serialno, ogg_int64_t granulepos, void * user_data)
+{
+  return page_unit ((int)(serialno - 1000), granulepos);
+}
+
+static int
+packet_byte (int p, int iter)
+{
+  return (p * 64 + iter) & 0xff;
+}
+
+/*
+ * Fill buf with packet iter of stream p, returning its length. In the
+ * OGGZ_AUTO run the first packet is a Vorbis identification header.
+ */
+static long
+make_packet (int p, int iter, unsigned char * buf)
+{
+  long bytes;
+
+  if (use_auto && iter == 0) {
+    memset (buf, 0, 30);
+    buf[0] = 1;
+    memcpy (buf + 1, "vorbis", 6);
+    buf[11] = 2; /* channels */
+    buf[12] = rates[p] & 0xff;
+    buf[13] = (rates[p] >> 8) & 0xff;
+    buf[14] = (rates[p] >> 16) & 0xff;
+    buf[15] = (rates[p] >> 24) & 0xff;
+    buf[28] = 0xb8; /* blocksizes */
+    buf[29] = 1; /* framing */
+    return 30;
+  }
+
+  bytes = 50 + (iter * 31 + p * 17) % 200;
+  memset (buf, packet_byte (p, iter), bytes);
+
+  return bytes;
+}
+
+typedef struct {
+  OGGZ * oggz;
+  int p;
+} producer_t;
+
+static pthread_mutex_t done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int nr_done = 0;
+
+static void *
+producer_run (void * arg)
+{
+  producer_t * producer = (producer_t *)arg;
+  unsigned char buf[256];
+  ogg_packet op;
+  int i, ret, others_done = 0;
+
+  /* The last stream starts only once the others have been fed, so its
+   * headers must still be written before their data */
+  while (producer->p == NR_PRODUCERS - 1 && !others_done) {
+    pthread_mutex_lock (&done_mutex);
+    others_done = (nr_done == NR_PRODUCERS - 1);
+    pthread_mutex_unlock (&done_mutex);
+    if (!others_done) sched_yield ();
+  }
+
+  for (i = 0; i < NR_PACKETS; i++) {
+    op.bytes = make_packet (producer->p, i, buf);
+    op.packet = buf;
+    op.b_o_s = (i == 0);
+    op.e_o_s = (i == NR_PACKETS - 1);
+    op.granulepos = packet_granulepos (producer->p, i);
+    op.packetno = i;
+
+    while ((ret = oggz_write_feed (producer->oggz, &op,
+                                   producer_serialno (producer->p),
+                                   0, NULL)) == OGGZ_ERR_QUEUE_FULL)
+      sched_yield ();
+
+    if (ret != 0) FAIL ("Oggz write failed");
+  }
+
+  pthread_mutex_lock (&done_mutex);
+  nr_done++;
+  pthread_mutex_unlock (&done_mutex);
+
+  return NULL;
+}
+
+static int
+producers_done (void)
+{
+  int done;
+
+  pthread_mutex_lock (&done_mutex);
+  done = (nr_done == NR_PRODUCERS);
+  pthread_mutex_unlock (&done_mutex);
+
+  return done;
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  ogg_int64_t granulepos, unit;
+
+  granulepos = ogg_page_granulepos ((ogg_page *)og);
+  if (granulepos != -1) {
+    unit = metric (oggz, serialno, granulepos, NULL);
+    if (unit < prev_unit) FAIL ("Page written out of time order");
+    prev_unit = unit;
+  }
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  unsigned char buf[256];
+  int p = (int)(serialno - 1000), iter;
+  long bytes;
+
+  if (p < 0 || p >= NR_PRODUCERS) FAIL ("Packet has unknown serialno");
+  iter = read_iter[p];
+
+  bytes = make_packet (p, iter, buf);
+
+  if (op->bytes != bytes)
+    FAIL ("Packet has incorrect length");
+
+  if (memcmp (op->packet, buf, bytes))
+    FAIL ("Packet contains incorrect data");
+
+  if (op->packetno != iter)
+    FAIL ("Packet has incorrect packetno");
+
+  read_iter[p]++;
+
+  return 0;
+}
+
+static void
+test_producers (int flags)
+{
+  OGGZ * writer, * reader;
+  producer_t producers[NR_PRODUCERS];
+  pthread_t threads[NR_PRODUCERS];
+  unsigned char * data_buf;
+  ogg_int64_t granulerate_n, granulerate_d;
+  long n, data_len = 0;
+  int p, empty = 0;
+
+  use_auto = (flags & OGGZ_AUTO);
+  nr_done = 0;
+  prev_unit = -1;
+  memset (read_iter, 0, sizeof (read_iter));
+
+  if ((writer = oggz_new (OGGZ_WRITE | flags)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  /* Without OGGZ_AUTO, one metric covers all streams */
+  if (!use_auto && oggz_set_metric (writer, -1, metric, NULL) != 0)
+    FAIL ("Could not set metric");
+
+  for (p = 0; p < NR_PRODUCERS; p++) {
+    if (oggz_write_set_producer (writer, producer_serialno (p),
+                                 QUEUE_PACKETS) != 0)
+      FAIL ("Could not set producer");
+  }
+
+  if (oggz_write_set_producer (writer, producer_serialno (0), QUEUE_PACKETS)
+      != OGGZ_ERR_INVALID)
+    FAIL ("Producer set up twice");
+
+  if ((data_buf = malloc (DATA_BUF_LEN)) == NULL)
+    FAIL ("Out of memory");
+
+  for (p = 0; p < NR_PRODUCERS; p++) {
+    producers[p].oggz = writer;
+    producers[p].p = p;
+    if (pthread_create (&threads[p], NULL, producer_run, &producers[p]) != 0)
+      FAIL ("Could not create producer thread");
+  }
+
+  /* Write while the producers feed; once they are done, drain the
+   * queues until output runs dry twice in a row */
+  while (empty < 2) {
+    n = oggz_write_output (writer, data_buf + data_len, 4096);
+    if (n > 0) {
+      data_len += n;
+      if (data_len + 4096 > DATA_BUF_LEN) FAIL ("Output too long");
+      empty = 0;
+    } else if (n < 0) {
+      FAIL ("Oggz write output failed");
+    } else if (producers_done ()) {
+      empty++;
+    } else {
+      sched_yield ();
+    }
+  }
+
+  for (p = 0; p < NR_PRODUCERS; p++)
+    pthread_join (threads[p], NULL);
+
+  /* Streams fed by producers are identified by the writing thread */
+  if (use_auto) {
+    for (p = 0; p < NR_PRODUCERS; p++) {
+      if (oggz_stream_get_content (writer, producer_serialno (p))
+          != OGGZ_CONTENT_VORBIS)
+        FAIL ("Producer stream not identified");
+
+      if (oggz_get_granulerate (writer, producer_serialno (p),
+                                &granulerate_n, &granulerate_d) != 0 ||
+          granulerate_n != rates[p] || granulerate_d != 1)
+        FAIL ("Producer stream metric not set");
+    }
+  }
+
+  oggz_close (writer);
+
+#ifdef DEBUG
+  printf ("%ld bytes written\n", data_len);
+#endif
+
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, NULL);
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  oggz_read_input (reader, data_buf, data_len);
+  oggz_close (reader);
+
+  for (p = 0; p < NR_PRODUCERS; p++) {
+    if (read_iter[p] != NR_PACKETS)
+      FAIL ("Not all packets were written");
+  }
+
+  free (data_buf);
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer;
+  int ret;
+
+  INFO ("Testing concurrent feeding by producer threads");
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  ret = oggz_write_set_producer (writer, producer_serialno (0), 0);
+  oggz_close (writer);
+
+  if (ret == OGGZ_ERR_DISABLED) {
+    INFO ("Producers not supported by this build, skipping");
+    exit (0);
+  } else if (ret != OGGZ_ERR_INVALID) {
+    FAIL ("Empty producer queue accepted");
+  }
+
+  test_producers (OGGZ_SORT);
+
+  INFO ("Testing producers with streams identified by OGGZ_AUTO");
+
+  test_producers (OGGZ_SORT | OGGZ_AUTO);
+
+  exit (0);
+}
+
+#else /* HAVE_PTHREAD */
+
+int
+main (int argc, char * argv[])
+{
+  INFO ("Testing concurrent feeding by producer threads");
+  INFO ("POSIX threads not available, skipping");
+
+  exit (0);
+}
+
+#endif /* HAVE_PTHREAD */
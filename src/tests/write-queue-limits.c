@@ -0,0 +1,209 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN (256*1024)
+
+#define NR_PACKETS 50
+#define MAX_PACKETS 4
+#define MAX_BYTES 1000
+
+static long serialno = 7;
+
+static unsigned char packet_buf[6000];
+
+static int hungry_iter = 0;
+static int read_iter = 0;
+
+static int
+feed (OGGZ * oggz, long bytes, ogg_int64_t packetno)
+{
+  ogg_packet op;
+
+  memset (packet_buf, 'a' + (int)(packetno % 26), bytes);
+
+  op.packet = packet_buf;
+  op.bytes = bytes;
+  op.b_o_s = (packetno == 0);
+  op.e_o_s = (packetno == NR_PACKETS - 1);
+  op.granulepos = packetno;
+  op.packetno = packetno;
+
+  return oggz_write_feed (oggz, &op, serialno, 0, NULL);
+}
+
+static long
+packet_bytes (int iter)
+{
+  return 100 + (iter * 37) % 300;
+}
+
+static int
+hungry (OGGZ * oggz, int empty, void * user_data)
+{
+  long packets, bytes;
+  int ret;
+
+  if (oggz_write_get_queue_space (oggz, &packets, &bytes) != 0)
+    FAIL ("Could not get queue space");
+
+  if (packets < 0 || packets > MAX_PACKETS ||
+      bytes < 0 || bytes > MAX_BYTES)
+    FAIL ("Queue space out of range");
+
+  /* Feed according to the demand hint, and once beyond it */
+  while (hungry_iter < NR_PACKETS) {
+    ret = feed (oggz, packet_bytes (hungry_iter), hungry_iter);
+    if (ret == OGGZ_ERR_QUEUE_FULL) {
+      if (packets > 0 && bytes >= packet_bytes (hungry_iter))
+        FAIL ("Packet refused within reported queue space");
+      break;
+    } else if (ret != 0) {
+      FAIL ("Oggz write failed");
+    }
+    packets--;
+    bytes -= packet_bytes (hungry_iter);
+    hungry_iter++;
+  }
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+
+  if (op->bytes != packet_bytes (read_iter))
+    FAIL ("Packet has incorrect length");
+
+  if (op->packet[0] != 'a' + read_iter % 26)
+    FAIL ("Packet contains incorrect data");
+
+  if (op->packetno != read_iter)
+    FAIL ("Packet has incorrect packetno");
+
+  read_iter++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * reader;
+  static unsigned char data_buf[DATA_BUF_LEN];
+  long n, data_len = 0, packets, bytes;
+
+  INFO ("Testing queue limits");
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  if (oggz_write_set_queue_limits (writer, -1, 0) != OGGZ_ERR_INVALID)
+    FAIL ("Negative limit accepted");
+
+  if (oggz_write_get_queue_space (writer, &packets, &bytes) != 0 ||
+      packets != -1 || bytes != -1)
+    FAIL ("Unlimited queue space not reported");
+
+  if (oggz_write_set_queue_limits (writer, 2, 500) != 0)
+    FAIL ("Could not set queue limits");
+
+  /* A packet larger than the byte limit is accepted into an empty queue */
+  if (feed (writer, 800, 0) != 0)
+    FAIL ("Large packet refused by empty queue");
+
+  if (feed (writer, 100, 1) != OGGZ_ERR_QUEUE_FULL)
+    FAIL ("Packet accepted beyond byte limit");
+
+  if (oggz_write_get_queue_space (writer, &packets, &bytes) != 0 ||
+      packets != 1 || bytes != 0)
+    FAIL ("Incorrect queue space reported");
+
+  /* Drain the queue; the refused packet must not have updated the stream */
+  while (oggz_write_output (writer, data_buf, DATA_BUF_LEN) > 0);
+
+  if (feed (writer, 100, 1) != 0)
+    FAIL ("Refused packet not accepted after draining");
+
+  if (feed (writer, 100, 2) != 0)
+    FAIL ("Packet refused within limits");
+
+  if (feed (writer, 100, 3) != OGGZ_ERR_QUEUE_FULL)
+    FAIL ("Packet accepted beyond packet limit");
+
+  oggz_close (writer);
+
+  INFO ("Testing hungry feeding with a demand hint");
+
+  if ((writer = oggz_new (OGGZ_WRITE)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  if (oggz_write_set_queue_limits (writer, MAX_PACKETS, MAX_BYTES) != 0)
+    FAIL ("Could not set queue limits");
+
+  if (oggz_write_set_hungry_callback (writer, hungry, 0, NULL) != 0)
+    FAIL ("Could not set hungry callback");
+
+  while ((n = oggz_write_output (writer, data_buf + data_len, 1024)) > 0) {
+    data_len += n;
+    if (data_len + 1024 > DATA_BUF_LEN) FAIL ("Output too long");
+  }
+
+  oggz_close (writer);
+
+  if (hungry_iter != NR_PACKETS)
+    FAIL ("Not all packets were fed");
+
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  oggz_read_input (reader, data_buf, data_len);
+  oggz_close (reader);
+
+  if (read_iter != NR_PACKETS)
+    FAIL ("Not all packets were written");
+
+  exit (0);
+}
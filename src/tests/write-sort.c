@@ -0,0 +1,195 @@
+/*
+   Copyright (C) 2003 Commonwealth Scientific and Industrial Research
+   Organisation (CSIRO) Australia
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   - Neither the name of CSIRO Australia nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "oggz/oggz.h"
+
+#include "oggz_tests.h"
+
+/* #define DEBUG */
+
+#define DATA_BUF_LEN (512*1024)
+
+/* Two streams covering the same time, at different packet rates */
+#define NR_PACKETS_A 60
+#define NR_PACKETS_B 15
+
+#define SERIALNO_A 100
+#define SERIALNO_B 200
+
+static unsigned char packet_buf[9000];
+
+static int read_iter_a = 0;
+static int read_iter_b = 0;
+static int nr_pages = 0;
+static int nr_switches = 0;
+static long prev_serialno = -1;
+static ogg_int64_t prev_unit = -1;
+static int seen_data_page = 0;
+
+static ogg_int64_t
+metric (OGGZ * oggz, long serialno, ogg_int64_t granulepos, void * user_data)
+{
+  return granulepos * (serialno == SERIALNO_A ? 10 : 40);
+}
+
+static long
+packet_bytes (long serialno, int iter)
+{
+  /* Every seventh packet of A spans pages */
+  if (serialno == SERIALNO_A && iter > 0 && iter % 7 == 0) return 9000;
+  return 200 + (iter * 53) % 700;
+}
+
+static int
+feed (OGGZ * oggz, long serialno, int iter, int nr_packets)
+{
+  ogg_packet op;
+
+  memset (packet_buf, 'a' + iter % 26, packet_bytes (serialno, iter));
+
+  op.packet = packet_buf;
+  op.bytes = packet_bytes (serialno, iter);
+  op.b_o_s = (iter == 0);
+  op.e_o_s = (iter == nr_packets - 1);
+  op.granulepos = iter;
+  op.packetno = iter;
+
+  return oggz_write_feed (oggz, &op, serialno, OGGZ_FLUSH_AFTER * (iter == 0),
+                          NULL);
+}
+
+static int
+read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  ogg_int64_t granulepos, unit;
+
+  if (ogg_page_bos ((ogg_page *)og)) {
+    if (seen_data_page) FAIL ("bos page after data pages");
+  } else {
+    seen_data_page = 1;
+  }
+
+  granulepos = ogg_page_granulepos ((ogg_page *)og);
+  if (granulepos != -1) {
+    unit = metric (oggz, serialno, granulepos, NULL);
+#ifdef DEBUG
+    printf ("page %d: serialno %ld, %lld ms\n", nr_pages, serialno, unit);
+#endif
+    if (unit < prev_unit) FAIL ("Page written out of time order");
+    prev_unit = unit;
+  }
+
+  if (prev_serialno != -1 && serialno != prev_serialno) nr_switches++;
+  prev_serialno = serialno;
+  nr_pages++;
+
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  ogg_packet * op = &zp->op;
+  int * iter;
+
+  iter = (serialno == SERIALNO_A) ? &read_iter_a : &read_iter_b;
+
+  if (op->bytes != packet_bytes (serialno, *iter))
+    FAIL ("Packet has incorrect length");
+
+  if (op->packet[0] != 'a' + *iter % 26 ||
+      op->packet[op->bytes-1] != 'a' + *iter % 26)
+    FAIL ("Packet contains incorrect data");
+
+  if (op->packetno != *iter)
+    FAIL ("Packet has incorrect packetno");
+
+  (*iter)++;
+
+  return 0;
+}
+
+int
+main (int argc, char * argv[])
+{
+  OGGZ * writer, * reader;
+  static unsigned char data_buf[DATA_BUF_LEN];
+  long n, data_len = 0;
+  int i;
+
+  INFO ("Testing OGGZ_SORT with streams fed one after the other");
+
+  if ((writer = oggz_new (OGGZ_WRITE | OGGZ_SORT)) == NULL)
+    FAIL("newly created OGGZ writer == NULL");
+
+  if (oggz_set_metric (writer, -1, metric, NULL) != 0)
+    FAIL ("Could not set metric");
+
+  for (i = 0; i < NR_PACKETS_A; i++) {
+    if (feed (writer, SERIALNO_A, i, NR_PACKETS_A) != 0)
+      FAIL ("Oggz write failed");
+  }
+
+  for (i = 0; i < NR_PACKETS_B; i++) {
+    if (feed (writer, SERIALNO_B, i, NR_PACKETS_B) != 0)
+      FAIL ("Oggz write failed");
+  }
+
+  while ((n = oggz_write_output (writer, data_buf + data_len, 1024)) > 0) {
+    data_len += n;
+    if (data_len + 1024 > DATA_BUF_LEN) FAIL ("Output too long");
+  }
+
+  oggz_close (writer);
+
+  if ((reader = oggz_new (OGGZ_READ)) == NULL)
+    FAIL("newly created OGGZ reader == NULL");
+
+  oggz_set_read_page (reader, -1, read_page, NULL);
+  oggz_set_read_callback (reader, -1, read_packet, NULL);
+  oggz_read_input (reader, data_buf, data_len);
+  oggz_close (reader);
+
+  if (read_iter_a != NR_PACKETS_A || read_iter_b != NR_PACKETS_B)
+    FAIL ("Not all packets were written");
+
+  /* Fed one after the other, the streams are only interleaved if sorted */
+  if (nr_switches < 4)
+    FAIL ("Streams were not interleaved");
+
+  exit (0);
+}
@@ -49,6 +49,11 @@ typedef struct {
 typedef struct {
   ogg_int64_t base_units;
   OggzTable * tracks;
+  /* In-place mode: page header edits, applied to filename in batches */
+  const char * filename;
+  int nthreads;
+  OggzPageEdit * edits;
+  long nedits;
 } OBData;
 
 static  ogg_int64_t
@@ -114,6 +119,10 @@ or_data_new (void)
   if (ord == NULL) return NULL;
 
   ord->base_units = -1;
+  ord->filename = NULL;
+  ord->nthreads = 1;
+  ord->edits = NULL;
+  ord->nedits = 0;
   ord->tracks = oggz_table_new ();
   if (ord->tracks == NULL) {
     free (ord);
@@ -135,6 +144,7 @@ or_data_delete (OBData * ord)
     or_track_data_delete (ort);
   }
   oggz_table_delete (ord->tracks);
+  free (ord->edits);
 }
 
 /********** checked_fwrite **********/
@@ -149,6 +159,53 @@ checked_fwrite (const void *data, size_t size, size_t count, FILE *stream)
   }
 }
 
+/********** In-place patching **********/
+
+/* Number of page header edits to collect before applying them */
+#define EDITS_BATCH 65536
+
+static int
+apply_edits (OBData * ord)
+{
+  long ret;
+
+  if (ord->nedits == 0) return 0;
+
+  ret = oggz_page_rewrite (ord->filename, ord->edits, ord->nedits,
+                           ord->nthreads);
+  if (ret != ord->nedits) return -1;
+
+  ord->nedits = 0;
+
+  return 0;
+}
+
+/*
+ * Record the new granulepos of the page at offset in the input file.
+ * Pages already read are rewritten in place a batch at a time; the
+ * lacing values and the page body are left untouched.
+ */
+static int
+patch_page (OBData * ord, oggz_off_t offset, const ogg_page * og)
+{
+  OggzPageEdit * edit;
+
+  if (ord->edits == NULL) {
+    ord->edits = malloc (EDITS_BATCH * sizeof (OggzPageEdit));
+    if (ord->edits == NULL) return -1;
+  }
+
+  edit = &ord->edits[ord->nedits++];
+  edit->offset = offset;
+  edit->type = OGGZ_PAGE_EDIT_GRANULEPOS;
+  edit->value = ogg_page_granulepos ((ogg_page *)og);
+
+  if (ord->nedits == EDITS_BATCH)
+    return apply_edits (ord);
+
+  return 0;
+}
+
 /********** Filter **********/
 
 static int
@@ -175,15 +232,13 @@ filter_page (OGGZ * oggz, const ogg_page * og, long serialno, OBData * ord)
     fprintf (stderr, "old gp %lld, new gp %lld", granulepos, new_granulepos);
 #endif
 
-  *(ogg_int64_t *)(&og->header[6]) = _le_64(new_granulepos);
+  /* Update the granulepos and the page checksum together */
+  oggz_page_set_granulepos ((ogg_page *)og, new_granulepos);
 
 #ifdef DEBUG
   fprintf (stderr, ", totally new gp %lld\n", INT64_LE_AT(&og->header[6]));
 #endif
 
-  /* AFTER making any changes to the page, recalculate the page checksum */
-  ogg_page_checksum_set ((ogg_page *)og);
-
   return 0;
 }
 
@@ -193,7 +248,7 @@ read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
 {
   OBData * ord = (OBData *)user_data;
   OBTrackData * ort;
-  ogg_int64_t gr_n, gr_d;
+  ogg_int64_t gr_n, gr_d, granulepos;
   int numheaders;
 
   if (ogg_page_bos ((ogg_page *)og)) {
@@ -226,16 +281,27 @@ read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
    * by which to shift all pages of this track */
   if (ord->base_units != -1 && ort->nr_packets >= numheaders && ort->delta == -1) {
     oggz_get_granulerate (oggz, serialno, &gr_n, &gr_d);
-    ort->delta = (ord->base_units * gr_n) / (gr_d);
+    /* Streams without a granulerate, such as Skeleton, are not shifted */
+    ort->delta = gr_d ? (ord->base_units * gr_n) / (gr_d) : 0;
 #ifdef DEBUG
     fprintf (stderr, "%010lu: DELTA %lld (gr: %lld/%lld)\n",
 	     serialno, ort->delta, gr_n, gr_d);
 #endif
   }
 
-  /* header pages have a granulepos 0 and should not have it changed */
-  if (ogg_page_granulepos ((ogg_page *) og) != 0) {
+  /* header pages have a granulepos 0 and should not have it changed,
+   * and pages on which no packet ends have no granulepos to change */
+  granulepos = ogg_page_granulepos ((ogg_page *) og);
+  if (granulepos != 0 && granulepos != -1) {
     filter_page (oggz, og, serialno, ord);
+
+    if (ord->filename != NULL &&
+        ogg_page_granulepos ((ogg_page *) og) != granulepos) {
+      if (patch_page (ord, oggz_tell (oggz), og) == -1) {
+        fprintf (stderr, "unable to update %s\n", ord->filename);
+        exit (1);
+      }
+    }
   }
 
   ort->nr_packets += ogg_page_packets ((ogg_page *)og);
@@ -245,8 +311,10 @@ read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
 	   serialno, ort->nr_packets, ogg_page_granulepos ((ogg_page *)og));
 #endif
 
-  checked_fwrite (og->header, 1, og->header_len, stdout);
-  checked_fwrite (og->body, 1, og->body_len, stdout);
+  if (ord->filename == NULL) {
+    checked_fwrite (og->header, 1, og->header_len, stdout);
+    checked_fwrite (og->body, 1, og->body_len, stdout);
+  }
 
   return 0;
 }
@@ -254,8 +322,13 @@ read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
 int
 usage (char * progname)
 {
-  printf ("usage: %s filename\n", progname);
+  printf ("usage: %s [-i [-j jobs]] filename\n", progname);
   printf ("Shift timestamps on all pages such that the stream starts at 0.\n");
+  printf ("\n");
+  printf ("  -i, --in-place         Rewrite the page headers of filename in place,\n");
+  printf ("                         instead of writing a new file to stdout\n");
+  printf ("  -j jobs, --jobs jobs   Rewrite page headers using the given number\n");
+  printf ("                         of threads\n");
 
   return 0;
 }
@@ -264,9 +337,11 @@ int
 main (int argc, char ** argv)
 {
   char * progname = argv[0];
+  char * filename = NULL;
   OGGZ * oggz;
   OBData * ord;
-  int ret;
+  int in_place = 0, nthreads = 1;
+  int i, ret;
 
   if (argc < 2) {
     usage (progname);
@@ -283,20 +358,46 @@ main (int argc, char ** argv)
     return (0);
   }
 
+  for (i = 1; i < argc; i++) {
+    if (!strcmp (argv[i], "-i") || !strcmp (argv[i], "--in-place")) {
+      in_place = 1;
+    } else if ((!strcmp (argv[i], "-j") || !strcmp (argv[i], "--jobs")) &&
+               i+1 < argc) {
+      nthreads = atoi (argv[++i]);
+    } else {
+      filename = argv[i];
+    }
+  }
+
+  if (filename == NULL) {
+    usage (progname);
+    return (1);
+  }
+
   ord = or_data_new ();
   if (ord == NULL) goto oom;
 
-  if ((oggz = oggz_open ((char *)argv[1], OGGZ_READ | OGGZ_AUTO)) == NULL) {
-    printf ("unable to open file %s\n", argv[1]);
+  if ((oggz = oggz_open (filename, OGGZ_READ | OGGZ_AUTO)) == NULL) {
+    printf ("unable to open file %s\n", filename);
     exit (1);
   }
 
+  if (in_place) {
+    ord->filename = filename;
+    ord->nthreads = nthreads;
+  }
+
   oggz_set_read_page (oggz, -1, read_page, ord);
 
   ret = oggz_run (oggz);
 
   oggz_close (oggz);
 
+  if (ord->filename != NULL && apply_edits (ord) == -1) {
+    fprintf (stderr, "%s: unable to update %s\n", progname, filename);
+    exit (1);
+  }
+
   or_data_delete (ord);
 
   if (ret == OGGZ_ERR_STOP_ERR) goto oom;
@@ -185,8 +185,7 @@ _ogg_page_set_eos (const ogg_page * og)
 {
   if (og == NULL) return;
 
-  og->header[5] |= 0x04;
-  ogg_page_checksum_set ((ogg_page *)og);
+  oggz_page_set_eos ((ogg_page *)og, 1);
 }
 
 static void
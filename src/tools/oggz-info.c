@@ -66,6 +66,9 @@ usage (const char * progname)
   printf ("  -p, --packet-stats     Display Ogg packet statistics\n");
   printf ("  -k, --skeleton         Display Extra data from OggSkeleton bitstream\n");
   printf ("  -a, --all              Display all information\n");
+  printf ("\nPerformance options\n");
+  printf ("  -j jobs, --jobs jobs   Scan pages with the given number of threads,\n");
+  printf ("                         without assembling packets\n");
   printf ("\nMiscellaneous options\n");
   printf ("  -h, --help             Display this help and exit\n");
   printf ("  -v, --version          Output version information and exit\n");
@@ -124,6 +127,9 @@ struct _OI_Stats {
   long length_avg;
   ogg_int64_t length_deviation_total;
   double length_stddev;
+
+  /* Single pass (--jobs), instead of pass 2 */
+  ogg_int64_t length_squares_total;
 };
 
 struct _OI_TrackInfo {
@@ -135,6 +141,11 @@ struct _OI_TrackInfo {
   int has_fisbone;
   fishead_packet fhInfo;
   fisbone_packet fbInfo;
+
+  /* Packet reassembly from page headers (--jobs) */
+  long packet_partial;
+  int has_skeleton_stream;
+  ogg_stream_state skeleton_stream;
 };
 
 static int show_length = 0;
@@ -207,6 +218,8 @@ oi_stats_clear (OI_Stats * stats)
   stats->length_avg = 0;
   stats->length_deviation_total = 0;
   stats->length_stddev = 0;
+
+  stats->length_squares_total = 0;
 }
 
 static OI_TrackInfo *
@@ -226,6 +239,9 @@ oggz_info_trackinfo_new (void)
   oit->has_fishead = 0;
   oit->has_fisbone = 0;
 
+  oit->packet_partial = 0;
+  oit->has_skeleton_stream = 0;
+
   return oit;
 }
 
@@ -458,23 +474,8 @@ read_page_pass2 (OGGZ * oggz, const ogg_page * og, long serialno, void * user_da
 }
 
 static int
-read_packet_pass1 (OGGZ * oggz, oggz_packet * zp, long serialno,
-		   void * user_data)
+oi_read_skeleton_packet (OI_Info * info, OI_TrackInfo * oit, ogg_packet * op)
 {
-  OI_Info * info = (OI_Info *)user_data;
-  ogg_packet * op = &zp->op;
-  OI_TrackInfo * oit;
-
-  oit = oggz_table_lookup (info->tracks, serialno);
-
-  /* Increment the packet statistics */
-  oit->packets.count++;
-  oit->packets.length_total += op->bytes;
-  if (op->bytes < oit->packets.length_min)
-    oit->packets.length_min = op->bytes;
-  if (op->bytes > oit->packets.length_max)
-    oit->packets.length_max = op->bytes;
-
   if (!op->e_o_s && !memcmp(op->packet, FISBONE_IDENTIFIER, 8)) {
     fisbone_packet fp;
     int ret = fisbone_from_ogg(op, &fp);
@@ -499,6 +500,27 @@ read_packet_pass1 (OGGZ * oggz, oggz_packet * zp, long serialno,
   return 0;
 }
 
+static int
+read_packet_pass1 (OGGZ * oggz, oggz_packet * zp, long serialno,
+		   void * user_data)
+{
+  OI_Info * info = (OI_Info *)user_data;
+  ogg_packet * op = &zp->op;
+  OI_TrackInfo * oit;
+
+  oit = oggz_table_lookup (info->tracks, serialno);
+
+  /* Increment the packet statistics */
+  oit->packets.count++;
+  oit->packets.length_total += op->bytes;
+  if (op->bytes < oit->packets.length_min)
+    oit->packets.length_min = op->bytes;
+  if (op->bytes > oit->packets.length_max)
+    oit->packets.length_max = op->bytes;
+
+  return oi_read_skeleton_packet (info, oit, op);
+}
+
 static int
 read_packet_pass2 (OGGZ * oggz, oggz_packet * zp, long serialno,
 		   void * user_data)
@@ -517,13 +539,29 @@ read_packet_pass2 (OGGZ * oggz, oggz_packet * zp, long serialno,
   return 0;
 }
 
-static int
-oi_pass1 (OGGZ * oggz, OI_Info * info)
+/* Find the Skeleton track if present, and subtract the presentation time */
+static void
+oi_skeleton_adjust_duration (OI_Info * info)
 {
-  long n, serialno;
+  long serialno;
   int ntracks, i;
   OI_TrackInfo * oit;
 
+  ntracks = oggz_table_size (info->tracks);
+  for (i = 0; i < ntracks; i++) {
+    oit = oggz_table_nth (info->tracks, i, &serialno);
+    if (oit->has_fishead) {
+      info->duration -= 1000 * oit->fhInfo.ptime_n / oit->fhInfo.ptime_d;
+      break;
+    }
+  }
+}
+
+static int
+oi_pass1 (OGGZ * oggz, OI_Info * info)
+{
+  long n;
+
   oggz_seek (oggz, 0, SEEK_SET);
   oggz_set_read_page (oggz, -1, read_page_pass1, info);
   oggz_set_read_callback (oggz, -1, read_packet_pass1, info);
@@ -539,15 +577,7 @@ oi_pass1 (OGGZ * oggz, OI_Info * info)
   /* Now we are at the end of the file, calculate the duration */
   info->duration = oggz_tell_units (oggz);
 
-  /* Find the Skeleton track if present, and subtract the presentation time */
-  ntracks = oggz_table_size (info->tracks);
-  for (i = 0; i < ntracks; i++) {
-    oit = oggz_table_nth (info->tracks, i, &serialno);
-    if (oit->has_fishead) {
-      info->duration -= 1000 * oit->fhInfo.ptime_n / oit->fhInfo.ptime_d;
-      break;
-    }
-  }
+  oi_skeleton_adjust_duration (info);
 
   return 0;
 }
@@ -570,6 +600,147 @@ oi_pass2 (OGGZ * oggz, OI_Info * info)
   return 0;
 }
 
+static void
+oi_stats_add_squares (OI_Stats * stats, long length)
+{
+  stats->length_squares_total += (ogg_int64_t)length * length;
+}
+
+/*
+ * Count the packets finishing on a page, and their lengths, from the
+ * lacing values of its header. A packet continues across pages for as
+ * long as its lacing values are 255.
+ */
+static void
+oi_scan_packets (OI_TrackInfo * oit, const ogg_page * og)
+{
+  const unsigned char * lacing = og->header + 27;
+  int nsegs = og->header[26], i;
+  long bytes;
+
+  if (!ogg_page_continued ((ogg_page *)og))
+    oit->packet_partial = 0;
+
+  for (i = 0; i < nsegs; i++) {
+    oit->packet_partial += lacing[i];
+    if (lacing[i] < 255) {
+      bytes = oit->packet_partial;
+      oit->packet_partial = 0;
+
+      oit->packets.count++;
+      oit->packets.length_total += bytes;
+      if (bytes < oit->packets.length_min)
+        oit->packets.length_min = bytes;
+      if (bytes > oit->packets.length_max)
+        oit->packets.length_max = bytes;
+      oi_stats_add_squares (&oit->packets, bytes);
+    }
+  }
+}
+
+static int
+oi_scan_skeleton (OI_Info * info, OI_TrackInfo * oit, long serialno,
+                  const ogg_page * og)
+{
+  ogg_packet op;
+  int ret;
+
+  if (!oit->has_skeleton_stream) {
+    ogg_stream_init (&oit->skeleton_stream, (int)serialno);
+    oit->has_skeleton_stream = 1;
+  }
+
+  ogg_stream_pagein (&oit->skeleton_stream, (ogg_page *)og);
+  while (ogg_stream_packetout (&oit->skeleton_stream, &op) == 1) {
+    if ((ret = oi_read_skeleton_packet (info, oit, &op)) < 0)
+      return ret;
+  }
+
+  return 0;
+}
+
+static int
+read_page_scan (OGGZ * oggz, const ogg_page * og, long serialno,
+                void * user_data)
+{
+  OI_Info * info = (OI_Info *)user_data;
+  OI_TrackInfo * oit;
+  ogg_int64_t granulepos, ns;
+
+  if (read_page_pass1 (oggz, og, serialno, user_data) != 0)
+    return OGGZ_STOP_ERR;
+
+  oit = oggz_table_lookup (info->tracks, serialno);
+
+  oi_stats_add_squares (&oit->pages, og->header_len + og->body_len);
+  oi_scan_packets (oit, og);
+
+  if (oggz_stream_get_content (oggz, serialno) == OGGZ_CONTENT_SKELETON) {
+    if (oi_scan_skeleton (info, oit, serialno, og) < 0)
+      return OGGZ_STOP_ERR;
+  }
+
+  /* The duration is that of the last page with a granulepos */
+  granulepos = ogg_page_granulepos ((ogg_page *)og);
+  if (granulepos != -1) {
+    ns = oggz_granulepos_to_time (oggz, serialno, granulepos);
+    if (ns != -1) {
+      info->duration = ns / 1000000;
+    } else if (granulepos == 0) {
+      info->duration = 0;
+    }
+  }
+
+  return OGGZ_CONTINUE;
+}
+
+/* Sum of squared deviations from the average length */
+static void
+oi_stats_deviation (OI_Stats * stats)
+{
+  ogg_int64_t avg = stats->length_avg;
+
+  stats->length_deviation_total = stats->length_squares_total
+    - 2 * avg * stats->length_total + stats->count * avg * avg;
+}
+
+static int
+oit_calc_deviation (OI_Info * info, OI_TrackInfo * oit, long serialno)
+{
+  oi_stats_deviation (&oit->pages);
+  oi_stats_deviation (&oit->packets);
+  return 0;
+}
+
+/*
+ * Gather all statistics in one pass over the pages, scanned by several
+ * threads. Packet lengths are found from page headers, so no packets
+ * are assembled except those of a Skeleton track.
+ */
+static int
+oi_scan (OGGZ * oggz, OI_Info * info, int nthreads)
+{
+  long n;
+
+  info->duration = 0;
+
+  n = oggz_scan_pages (oggz, nthreads, read_page_scan, info);
+
+  /* We only return an error from our user callback on OOM */
+  if (n == OGGZ_ERR_STOP_ERR || n == OGGZ_ERR_OUT_OF_MEMORY)
+    exit_out_of_memory ();
+
+  if (n < 0) return n;
+
+  oggz_info_apply (oit_calc_average, info);
+  oggz_info_apply (oit_calc_deviation, info);
+  oggz_info_apply (oit_calc_stddev, info);
+
+  oi_skeleton_adjust_duration (info);
+
+  return 0;
+}
+
 static int
 oit_delete (OI_Info * info, OI_TrackInfo * oit, long serialno)
 {
@@ -578,6 +749,8 @@ oit_delete (OI_Info * info, OI_TrackInfo * oit, long serialno)
       fisbone_clear (&oit->fbInfo);
     free (oit->codec_info);
   }
+  if (oit->has_skeleton_stream)
+    ogg_stream_clear (&oit->skeleton_stream);
   free (oit);
 
   return 0;
@@ -597,7 +770,10 @@ main (int argc, char ** argv)
   OGGZ * oggz;
   OI_Info info;
 
-  char * optstring = "hvlbgpka";
+  int nthreads = 0;
+  int err;
+
+  char * optstring = "hvlbgpkaj:";
 
 #ifdef HAVE_GETOPT_LONG
   static struct option long_options[] = {
@@ -609,6 +785,7 @@ main (int argc, char ** argv)
     {"packet-stats", no_argument, 0, 'p'},
     {"skeleton", no_argument, 0, 'k'},
     {"all", no_argument, 0, 'a'},
+    {"jobs", required_argument, 0, 'j'},
     {NULL,0,0,0}
   };
 #endif
@@ -666,6 +843,9 @@ main (int argc, char ** argv)
     case 'a':
       show_all = 1;
       break;
+    case 'j': /* jobs */
+      nthreads = atoi (optarg);
+      break;
     default:
       break;
     }
@@ -713,9 +893,21 @@ main (int argc, char ** argv)
     info.length_total = 0;
     info.overhead_length_total = 0;
     
-    oi_pass1 (oggz, &info);
-
-    oi_pass2 (oggz, &info);
+    /* Scanning needs a seekable file; otherwise read it in two passes.
+     * Other errors may come after some pages were counted, so the passes
+     * cannot take over from them */
+    err = (nthreads < 1) ? OGGZ_ERR_DISABLED : oi_scan (oggz, &info, nthreads);
+    if (err == OGGZ_ERR_NOSEEK || err == OGGZ_ERR_DISABLED) {
+      oi_pass1 (oggz, &info);
+      oi_pass2 (oggz, &info);
+    } else if (err != 0) {
+      fprintf (stderr, "%s: %s: error scanning input file\n",
+               progname, infilename);
+      oggz_info_apply (oit_delete, &info);
+      oggz_table_delete (info.tracks);
+      oggz_close (oggz);
+      goto exit_err;
+    }
     
     /* Print summary information */
     if (many_files)
@@ -44,6 +44,8 @@
 #endif
 #include <fcntl.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include <getopt.h>
 #include <errno.h>
@@ -67,6 +69,15 @@ typedef struct {
   OggzTable *serialno_table;
   OggzTable *stream_index_table;
   OggzTable *content_types_table;
+
+  long bytes_written;
+
+  /* Split mode: each stream, or each chain link, to its own file */
+  const char *split_pattern;
+  int split_links;
+  OggzTable *split_filenames;
+  int link; /* index of the current chain link */
+  int in_headers; /* all pages of the current link so far are bos */
 } ORData;
 
 typedef struct {
@@ -74,6 +85,8 @@ typedef struct {
   int streamid;
   const char *content_type;
   int bos;
+  int link;
+  FILE *outfile; /* in split mode, the file of this stream */
 } ORStream;
 
 static int streamid_count = 0;
@@ -95,6 +108,16 @@ usage (char * progname)
   printf ("                         Filter by content-type. Run oggz-known-codecs\n");
   printf ("                         for a list of codec names which can be detected\n");
   printf ("                         by this version of oggz.\n");
+  printf ("\nSplit options\n");
+  printf ("  -S pattern, --split pattern\n");
+  printf ("                         Write each stream to its own file, in one pass\n");
+  printf ("                         over the input. All streams are written unless\n");
+  printf ("                         filter options are given. In the pattern,\n");
+  printf ("                         %%i is replaced by the stream index, %%s by the\n");
+  printf ("                         serialno, %%c by the content-type, %%l by the\n");
+  printf ("                         chain link index and %%%% by %%.\n");
+  printf ("  -L, --split-links      With --split, write each chain link to its own\n");
+  printf ("                         file instead of each stream\n");
   printf ("\nMiscellaneous options\n");
   printf ("  -o filename, --output filename\n");
   printf ("                         Specify output filename\n");
@@ -123,13 +146,38 @@ ordata_new ()
 
   ordata->content_types_table = oggz_table_new();
   assert (ordata->content_types_table != NULL);
+
+  ordata->split_filenames = oggz_table_new();
+  assert (ordata->split_filenames != NULL);
+
+  ordata->link = -1;
   
   return ordata;
 }
 
+static void orstream_delete (ORData *ordata, ORStream *stream);
+
 static void 
 ordata_delete (ORData *ordata)
 {
+  ORStream *stream;
+  char *filename;
+  int i, n;
+
+  /* Close the files of streams which did not end */
+  n = oggz_table_size (ordata->streams);
+  for (i = 0; i < n; i++) {
+    stream = oggz_table_nth (ordata->streams, i, NULL);
+    orstream_delete (ordata, stream);
+  }
+
+  n = oggz_table_size (ordata->split_filenames);
+  for (i = 0; i < n; i++) {
+    filename = oggz_table_nth (ordata->split_filenames, i, NULL);
+    free (filename);
+  }
+  oggz_table_delete (ordata->split_filenames);
+
   oggz_table_delete (ordata->streams);
   oggz_table_delete (ordata->serialno_table);
   oggz_table_delete (ordata->stream_index_table);
@@ -152,6 +200,13 @@ filter_stream_p (const ORData *ordata, ORStream *stream,
   if (oggz_table_lookup (ordata->serialno_table, serialno) != NULL)
     return 1;
 
+  /* Split mode with no filters splits all streams */
+  if (ordata->split_pattern != NULL &&
+      oggz_table_size (ordata->serialno_table) == 0 &&
+      oggz_table_size (ordata->stream_index_table) == 0 &&
+      oggz_table_size (ordata->content_types_table) == 0)
+    return 1;
+
   if (stream == NULL)
     return 0;
 
@@ -180,6 +235,8 @@ orstream_new (OGGZ *oggz, const ORData *ordata, const ogg_page *og,
   stream->serialno = serialno;
   stream->streamid = streamid_count++;
   stream->content_type = "unknown";
+  stream->link = ordata->link;
+  stream->outfile = NULL;
 
   stream->content_type = oggz_stream_get_content_type (oggz, serialno);
    
@@ -199,6 +256,9 @@ orstream_delete (ORData *ordata, ORStream *stream)
   if (ordata->verbose)
     fprintf (stderr, "End of logical stream %li   \n", stream->serialno);
 
+  if (stream->outfile != NULL)
+    fclose (stream->outfile);
+
   free (stream);
 }
 
@@ -212,14 +272,171 @@ checked_fwrite (const void *data, size_t size, size_t count, FILE *stream)
   }
 }
 
+/*
+ * Expand a split pattern for a stream, or for a chain link if stream is
+ * NULL. Returns a newly allocated filename, or NULL if the pattern gives
+ * a filename already used for another output.
+ */
+static char *
+or_split_filename (ORData *ordata, ORStream *stream)
+{
+  const char *p;
+  char *filename, *tmp;
+  char field[64];
+  size_t len = 0, size = 256, n;
+  int i, nfiles;
+
+  filename = malloc (size);
+  assert (filename != NULL);
+
+  for (p = ordata->split_pattern; *p != '\0'; p++) {
+    if (*p == '%' && p[1] != '\0') {
+      p++;
+      switch (*p) {
+      case 'i':
+        snprintf (field, sizeof (field), "%d", stream ? stream->streamid : 0);
+        break;
+      case 's':
+        snprintf (field, sizeof (field), "%ld", stream ? stream->serialno : 0);
+        break;
+      case 'c':
+        snprintf (field, sizeof (field), "%s",
+                  stream ? stream->content_type : "ogg");
+        break;
+      case 'l':
+        snprintf (field, sizeof (field), "%d", ordata->link);
+        break;
+      default:
+        field[0] = *p;
+        field[1] = '\0';
+        break;
+      }
+    } else {
+      field[0] = *p;
+      field[1] = '\0';
+    }
+
+    n = strlen (field);
+    if (len + n + 1 > size) {
+      size = 2 * (len + n + 1);
+      tmp = realloc (filename, size);
+      assert (tmp != NULL);
+      filename = tmp;
+    }
+    memcpy (filename + len, field, n);
+    len += n;
+  }
+  filename[len] = '\0';
+
+  nfiles = oggz_table_size (ordata->split_filenames);
+  for (i = 0; i < nfiles; i++) {
+    if (!strcmp (filename, oggz_table_nth (ordata->split_filenames, i, NULL))) {
+      free (filename);
+      return NULL;
+    }
+  }
+  oggz_table_insert (ordata->split_filenames, (long)nfiles, filename);
+
+  return filename;
+}
+
+/*
+ * Open an output file for split mode, buffered in blocks of the
+ * filesystem block size.
+ */
+static FILE *
+or_split_open (ORData *ordata, ORStream *stream)
+{
+  FILE *outfile;
+  char *filename;
+  size_t bufsize = WRITE_SIZE;
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+  struct stat statbuf;
+#endif
+
+  if ((filename = or_split_filename (ordata, stream)) == NULL) {
+    fprintf (stderr, "ERROR: split pattern %s does not give a new filename "
+             "for each output\n", ordata->split_pattern);
+    exit (1);
+  }
+
+  if ((outfile = fopen (filename, "wb")) == NULL) {
+    fprintf (stderr, "ERROR: unable to open output file %s : %s\n",
+             filename, strerror (errno));
+    exit (1);
+  }
+
+#ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
+  if (fstat (fileno (outfile), &statbuf) == 0 && statbuf.st_blksize > 0)
+    bufsize = statbuf.st_blksize;
+#endif
+  setvbuf (outfile, NULL, _IOFBF, bufsize);
+
+  if (ordata->verbose)
+    fprintf (stderr, "Writing %s\n", filename);
+
+  return outfile;
+}
+
+/*
+ * Keep track of chain links: a bos page which follows other pages of
+ * the file begins a new link.
+ */
+static void
+or_link_page (ORData *ordata, const ogg_page *og)
+{
+  if (!ogg_page_bos ((ogg_page *)og)) {
+    ordata->in_headers = 0;
+    return;
+  }
+
+  if (ordata->in_headers) return;
+
+  ordata->in_headers = 1;
+  ordata->link++;
+
+  if (ordata->split_pattern != NULL && ordata->split_links) {
+    if (ordata->outfile != NULL)
+      fclose (ordata->outfile);
+    ordata->outfile = NULL;
+  }
+}
+
 static int
 rip_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
 {
   ORData *ordata = (ORData *) user_data;
   ORStream *stream = oggz_table_lookup (ordata->streams, serialno);
+  FILE *outfile = ordata->outfile;
 
-  checked_fwrite (og->header, 1, og->header_len, ordata->outfile);
-  checked_fwrite (og->body, 1, og->body_len, ordata->outfile);
+  or_link_page (ordata, og);
+
+  /* A stream of a later chain link may reuse the serialno of a ripped
+   * stream, in which case its pages come straight here */
+  if (stream == NULL && ogg_page_bos ((ogg_page *)og)) {
+    stream = orstream_new (oggz, ordata, og, serialno);
+    stream = oggz_table_insert (ordata->streams, serialno, stream);
+    assert (stream != NULL);
+  }
+
+  if (ordata->split_pattern != NULL) {
+    if (ordata->split_links) {
+      /* Open the file of a link when it has a page to write */
+      if (ordata->outfile == NULL)
+        ordata->outfile = or_split_open (ordata, NULL);
+      outfile = ordata->outfile;
+    } else if (stream != NULL) {
+      if (stream->outfile == NULL)
+        stream->outfile = or_split_open (ordata, stream);
+      outfile = stream->outfile;
+    }
+  }
+
+  if (outfile == NULL) return 0;
+
+  checked_fwrite (og->header, 1, og->header_len, outfile);
+  checked_fwrite (og->body, 1, og->body_len, outfile);
+  ordata->bytes_written += og->header_len + og->body_len;
 
   if (ogg_page_eos ((ogg_page *)og) && stream != NULL) {
     oggz_table_remove (ordata->streams, serialno);
@@ -235,6 +452,8 @@ read_page (OGGZ *oggz, const ogg_page *og, long serialno, void *user_data)
   ORData *ordata = (ORData *) user_data;
   ORStream *stream = oggz_table_lookup (ordata->streams, serialno);
 
+  or_link_page (ordata, og);
+
   if (ogg_page_bos ((ogg_page *)og)) {
     stream = orstream_new (oggz, ordata, og, serialno);
     stream = oggz_table_insert (ordata->streams, serialno, stream);
@@ -260,7 +479,7 @@ oggz_rip (ORData * ordata)
     if (ordata->verbose) {
       fprintf (stderr, "\r Read %li k, wrote %li k ...\r",
 	       (long) (oggz_tell (ordata->reader)/1024),
-	       (long) (ftell (ordata->outfile)/1024));
+	       ordata->bytes_written/1024);
     }
   }
 
@@ -301,7 +520,7 @@ main (int argc, char * argv[])
   long l;
   int i, n;
 
-  char * optstring = "hvVo:s:i:c:";
+  char * optstring = "hvVo:s:i:c:S:L";
 
 #ifdef HAVE_GETOPT_LONG
   static struct option long_options[] = {
@@ -312,6 +531,8 @@ main (int argc, char * argv[])
     {"serialno", required_argument, 0, 's'},
     {"stream-index", required_argument, 0, 'i'},
     {"content-type", required_argument, 0, 'c'},
+    {"split", required_argument, 0, 'S'},
+    {"split-links", no_argument, 0, 'L'},
     {0,0,0,0}
   };
 #endif
@@ -375,6 +596,12 @@ main (int argc, char * argv[])
       n = oggz_table_size (ordata->content_types_table);
       oggz_table_insert (ordata->content_types_table, (long)n, optarg);
       break;
+    case 'S': /* split */
+      ordata->split_pattern = optarg;
+      break;
+    case 'L': /* split-links */
+      ordata->split_links = 1;
+      break;
     default:
       break;
     }
@@ -399,6 +626,17 @@ main (int argc, char * argv[])
     goto exit_err;
   }
 
+  if (ordata->split_links && ordata->split_pattern == NULL) {
+    fprintf (stderr, "%s: --split-links requires --split\n", progname);
+    goto exit_err;
+  }
+
+  if (ordata->split_pattern != NULL && outfilename != NULL) {
+    fprintf (stderr, "%s: --split and --output cannot be used together\n",
+             progname);
+    goto exit_err;
+  }
+
   infilename = argv[optind];
   infile = fopen (infilename, "rb");
   if (infile == NULL) {
@@ -409,7 +647,9 @@ main (int argc, char * argv[])
     ordata->reader = oggz_open_stdio (infile, OGGZ_READ|OGGZ_AUTO);
   }
 
-  if (outfilename == NULL) {
+  if (ordata->split_pattern != NULL) {
+    /* Output files are opened as their streams or links begin */
+  } else if (outfilename == NULL) {
     ordata->outfile = stdout;
   } else {
     ordata->outfile = fopen (outfilename, "wb");
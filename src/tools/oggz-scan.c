@@ -66,6 +66,7 @@ typedef struct {
   int keyframes;
   int cmml;
   int html;
+  OggzTable * streams;
 } OSData;
 
 static char * progname;
@@ -97,6 +98,8 @@ usage (char * progname)
   printf ("                         cmml, and html. (Default: plain)\n");
   printf ("\nFeature options\n");
   printf ("  -k, --keyframe         Display timestamps of unforced theora keyframes\n");
+  printf ("\nPerformance options\n");
+  printf ("  -j jobs, --jobs jobs   Scan the file with the given number of threads\n");
   printf ("\nMiscellaneous options\n");
   printf ("  -h, --help             Display this help and exit\n");
   printf ("  -v, --version          Output version information and exit\n");
@@ -121,13 +124,39 @@ filter_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
   return OGGZ_CONTINUE;
 }
 
-static int
-read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+static void
+print_clip (OGGZ * oggz, OSData * osdata, ogg_int64_t units)
 {
-  OSData * osdata = (OSData *) user_data;
-  ogg_packet * op = &zp->op;
   double time_offset;
 
+  if (units == -1) {
+    time_offset = oggz_tell(oggz);
+  } else {
+    time_offset = (double)units / 1000.0;
+  }
+
+  /* output in requested format */
+  if (osdata->html) {
+    fprintf(outfile, HTML_CLIP, osdata->clipcount, time_offset);
+  }
+  if (osdata->cmml) {
+    fprintf(outfile, CMML_CLIP, osdata->clipcount, time_offset);
+  }
+  osdata->clipcount++;
+  if (!osdata->html && !osdata->cmml) {
+    ot_fprint_time (outfile, time_offset);
+    fputc ('\n', outfile);
+  }
+}
+
+/*
+ * Returns 1 if the packet is a new shot boundary, ie. an unforced
+ * theora keyframe.
+ */
+static int
+is_clip (OGGZ * oggz, OSData * osdata, ogg_packet * op, long serialno)
+{
+
   /* calculate granuleshift for theora track */
   if (osdata->granuleshift == 0) {
     osdata->granuleshift = 1 << oggz_get_granuleshift (oggz, serialno);
@@ -139,7 +168,7 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
 
   /* don't do anything on bos page */
   if (op->b_o_s) {
-    return OGGZ_CONTINUE;
+    return 0;
   }
 
   /* calculate the keyframes if requested */
@@ -148,9 +177,9 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
     osdata->pktssincekey++;
 
     /* does the current packet contain a keyframe? */
-    if(!(op->packet[0] & 0x80) /* data packet */ &&
+    if(op->bytes > 0 &&
+       !(op->packet[0] & 0x80) /* data packet */ &&
        !(op->packet[0] & 0x40) /* intra frame */ ) {
-      ogg_int64_t units;
 
 #ifdef DEBUG
       fprintf(outfile, "Keyframe found: packetno=%" PRId64 
@@ -160,30 +189,12 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
       /* if the keyframe is on the granuleshift position, ignore it */
       if (osdata->pktssincekey >= osdata->granuleshift) {
         osdata->pktssincekey=0;
-        return OGGZ_CONTINUE;
+        return 0;
       }
       osdata->pktssincekey=0;
 
-      /* new shot boundary found: calculate time */
-      units = oggz_tell_units (oggz);
-      if (units == -1) {
-        time_offset = oggz_tell(oggz);
-      } else {
-        time_offset = (double)units / 1000.0;
-      }
-
-      /* output in requested format */
-      if (osdata->html) {
-        fprintf(outfile, HTML_CLIP, osdata->clipcount, time_offset);
-      }
-      if (osdata->cmml) {
-        fprintf(outfile, CMML_CLIP, osdata->clipcount, time_offset);
-      }
-      osdata->clipcount++;
-      if (!osdata->html && !osdata->cmml) {
-	ot_fprint_time (outfile, time_offset);
-	fputc ('\n', outfile);
-      }
+      /* new shot boundary found */
+      return 1;
     }
   }
 
@@ -191,9 +202,104 @@ read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
   fprintf (outfile, "%ld bytes pktno=%" PRId64 "\n", op->bytes, op->packetno);
 #endif
 
+  return 0;
+}
+
+static int
+read_packet (OGGZ * oggz, oggz_packet * zp, long serialno, void * user_data)
+{
+  OSData * osdata = (OSData *) user_data;
+
+  if (is_clip (oggz, osdata, &zp->op, serialno))
+    print_clip (oggz, osdata, oggz_tell_units (oggz));
+
   return OGGZ_CONTINUE;
 }
 
+/*
+ * When scanning pages with several threads, theora packets are assembled
+ * here rather than by the reader. The page granulepos gives the frame
+ * number of the last packet completed on the page, and each packet
+ * before it is one frame earlier.
+ */
+static int
+scan_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
+{
+  OSData * osdata = (OSData *) user_data;
+  ogg_stream_state * os;
+  ogg_packet * ops = NULL, * tmp;
+  ogg_packet op;
+  const char * ident;
+  ogg_int64_t granulepos, frame, units;
+  int shift, n = 0, max = 0, i;
+
+  if (ogg_page_bos ((ogg_page *)og)) {
+    ident = ot_page_identify (oggz, og, NULL);
+    if (ident && (strcasecmp ("theora", ident) == 0)) {
+      if ((os = malloc (sizeof (ogg_stream_state))) == NULL)
+        return OGGZ_STOP_ERR;
+      ogg_stream_init (os, (int)serialno);
+      if (oggz_table_insert (osdata->streams, serialno, os) == NULL) {
+        ogg_stream_clear (os);
+        free (os);
+        return OGGZ_STOP_ERR;
+      }
+    }
+  }
+
+  if ((os = oggz_table_lookup (osdata->streams, serialno)) == NULL)
+    return OGGZ_CONTINUE;
+
+  ogg_stream_pagein (os, (ogg_page *)og);
+  while (ogg_stream_packetout (os, &op) == 1) {
+    if (n == max) {
+      max = max ? max * 2 : 16;
+      if ((tmp = realloc (ops, max * sizeof (ogg_packet))) == NULL) {
+        free (ops);
+        return OGGZ_STOP_ERR;
+      }
+      ops = tmp;
+    }
+    ops[n++] = op;
+  }
+
+  granulepos = ogg_page_granulepos ((ogg_page *)og);
+  shift = oggz_get_granuleshift (oggz, serialno);
+
+  for (i = 0; i < n; i++) {
+    if (!is_clip (oggz, osdata, &ops[i], serialno))
+      continue;
+
+    units = -1;
+    if (granulepos != -1) {
+      frame = (granulepos >> shift) + (granulepos & ((1 << shift) - 1));
+      frame -= n - 1 - i;
+      units = oggz_granulepos_to_time (oggz, serialno, frame << shift);
+      if (units != -1) units /= 1000000;
+    }
+    print_clip (oggz, osdata, units);
+  }
+
+  free (ops);
+
+  return OGGZ_CONTINUE;
+}
+
+static void
+scan_streams_delete (OSData * osdata)
+{
+  ogg_stream_state * os;
+  int i, n;
+
+  n = oggz_table_size (osdata->streams);
+  for (i = 0; i < n; i++) {
+    os = oggz_table_nth (osdata->streams, i, NULL);
+    ogg_stream_clear (os);
+    free (os);
+  }
+  oggz_table_delete (osdata->streams);
+}
+
 int
 main (int argc, char ** argv)
 {
@@ -202,13 +308,15 @@ main (int argc, char ** argv)
   int output_cmml = 0;
   int output_html = 0;
   int scan_keyframes = 0;
+  int nthreads = 0;
+  long n = -1;
 
   OSData * osdata = NULL;
   OGGZ * oggz;
   char * infilename = NULL, * outfilename = NULL;
   int i;
 
-  char * optstring = "f:khvo:";
+  char * optstring = "f:khvo:j:";
 
 #ifdef HAVE_GETOPT_LONG
   static struct option long_options[] = {
@@ -217,6 +325,7 @@ main (int argc, char ** argv)
     {"keyframe", no_argument, 0, 'k'},
     {"help",     no_argument, 0, 'h'},
     {"version",  no_argument, 0, 'v'},
+    {"jobs",     required_argument, 0, 'j'},
     {0,0,0,0}
   };
 #endif
@@ -277,6 +386,9 @@ main (int argc, char ** argv)
     case 'o': /* output */
       outfilename = optarg;
       break;
+    case 'j': /* jobs */
+      nthreads = atoi (optarg);
+      break;
     default:
       break;
     }
@@ -344,9 +456,6 @@ main (int argc, char ** argv)
   if (output_cmml)    osdata->cmml = 1;
   if (output_html)    osdata->html = 1;
 
-  /* set up the right filters on the tracks */
-  oggz_set_read_page (oggz, -1, filter_page, osdata);
-
   /* correct output format */
   if (output_html) {
     fprintf(outfile, HTML_HEAD, infilename);
@@ -355,8 +464,29 @@ main (int argc, char ** argv)
     fprintf(outfile, CMML_HEAD, infilename, infilename);
   }
 
-  oggz_run_set_blocksize (oggz, 1024*1024);
-  oggz_run (oggz);
+  /* Scanning needs a seekable file; otherwise read it with oggz_run() */
+  if (nthreads > 0) {
+    if ((osdata->streams = oggz_table_new ()) == NULL) {
+      fprintf (stderr, "%s: Out of memory\n", progname);
+      exit (1);
+    }
+
+    n = oggz_scan_pages (oggz, nthreads, scan_page, osdata);
+    if (n == OGGZ_ERR_STOP_ERR || n == OGGZ_ERR_OUT_OF_MEMORY) {
+      fprintf (stderr, "%s: Out of memory\n", progname);
+      exit (1);
+    }
+
+    scan_streams_delete (osdata);
+  }
+
+  if (n < 0) {
+    /* set up the right filters on the tracks */
+    oggz_set_read_page (oggz, -1, filter_page, osdata);
+
+    oggz_run_set_blocksize (oggz, 1024*1024);
+    oggz_run (oggz);
+  }
 
   /* finish output */
   if (output_html) {
@@ -44,6 +44,10 @@
 
 #define READ_SIZE 4096
 
+/* Streaming mode defaults */
+#define DEFAULT_MAX_LATENCY 10000 /* ms */
+#define DEFAULT_MAX_BUFFER (32*1024) /* kB */
+
 static char * progname;
 
 static void
@@ -51,6 +55,18 @@ usage (char * progname)
 {
   printf ("Usage: %s [options] filename ...\n", progname);
   printf ("Sort the pages of an Ogg file in order of presentation time.\n");
+  printf ("\nStreaming options\n");
+  printf ("  -s, --stream           Read the input once, holding pages in a bounded\n");
+  printf ("                         reorder buffer. This is the default when the\n");
+  printf ("                         input filename is - (standard input)\n");
+  printf ("  -l ms, --max-latency ms\n");
+  printf ("                         Hold no page for longer than this many\n");
+  printf ("                         milliseconds of input time (default %d, 0 for\n",
+          DEFAULT_MAX_LATENCY);
+  printf ("                         no limit)\n");
+  printf ("  -b kB, --max-buffer kB Hold at most this many kilobytes of pages\n");
+  printf ("                         (default %d, 0 for no limit)\n",
+          DEFAULT_MAX_BUFFER);
   printf ("\nMiscellaneous options\n");
   printf ("  -o filename, --output filename\n");
   printf ("                         Specify output filename\n");
@@ -81,11 +97,25 @@ checked_fwrite (const void *data, size_t size, size_t count, FILE *stream)
 typedef struct _OSData OSData;
 typedef struct _OSInput OSInput;
 typedef struct _OSITrack OSITrack;
+typedef struct _OSPage OSPage;
+typedef struct _OSTrack OSTrack;
 
 struct _OSData {
   char * infilename;
   OggzTable * inputs;
   int verbose;
+
+  /* Streaming mode */
+  ogg_int64_t max_latency; /* ns, or 0 for no limit */
+  long max_buffer; /* bytes, or 0 for no limit */
+  OggzTable * tracks;
+  OSTrack ** heap; /* tracks with pages held, earliest first */
+  int heap_size;
+  int heap_max;
+  long buffered; /* bytes of pages held */
+  long seq; /* number of pages read */
+  ogg_int64_t newest; /* latest page time read */
+  FILE * outfile;
 };
 
 struct _OSInput {
@@ -99,6 +129,23 @@ struct _OSITrack {
   long output_serialno;
 };
 
+/* A page held in the reorder buffer of a track */
+struct _OSPage {
+  ogg_page * og;
+  ogg_int64_t time;
+  long seq;
+  OSPage * next;
+};
+
+struct _OSTrack {
+  long serialno;
+  OSPage * head;
+  OSPage * tail;
+  ogg_int64_t time; /* time of the latest page read */
+  int timed; /* the granulepos of this track can be converted to time */
+  int eos;
+};
+
 static ogg_page *
 _ogg_page_copy (const ogg_page * og)
 {
@@ -160,6 +207,17 @@ osdata_new (void)
 
   osdata->verbose = 0;
 
+  osdata->max_latency = (ogg_int64_t)DEFAULT_MAX_LATENCY * 1000000;
+  osdata->max_buffer = DEFAULT_MAX_BUFFER * 1024L;
+  osdata->tracks = NULL;
+  osdata->heap = NULL;
+  osdata->heap_size = 0;
+  osdata->heap_max = 0;
+  osdata->buffered = 0;
+  osdata->seq = 0;
+  osdata->newest = 0;
+  osdata->outfile = NULL;
+
   return osdata;
 }
 
@@ -167,8 +225,24 @@ static void
 osdata_delete (OSData * osdata)
 {
   OSInput * input;
+  OSTrack * track;
+  OSPage * page;
   int i, ninputs;
 
+  if (osdata->tracks != NULL) {
+    for (i = 0; i < oggz_table_size (osdata->tracks); i++) {
+      track = (OSTrack *) oggz_table_nth (osdata->tracks, i, NULL);
+      while ((page = track->head) != NULL) {
+        track->head = page->next;
+        _ogg_page_free (page->og);
+        free (page);
+      }
+      free (track);
+    }
+    oggz_table_delete (osdata->tracks);
+  }
+  free (osdata->heap);
+
   ninputs = oggz_table_size (osdata->inputs);
   for (i = 0; i < ninputs; i++) {
     input = (OSInput *) oggz_table_nth (osdata->inputs, i, NULL);
@@ -194,8 +268,7 @@ read_page (OGGZ * oggz, const ogg_page * og, long serialno, void * user_data)
     /* If this page's granulepos should be -1 but isn't then fix that before
      * storing and sorting the page. */
     if(ogg_page_packets(iog)==0&&ogg_page_granulepos(iog)!=-1) {
-      memset(iog->header+6,0xFF,8);
-      ogg_page_checksum_set(iog);
+      oggz_page_set_granulepos(iog, -1);
     }
     input->og = iog;
     return OGGZ_STOP_OK;
@@ -366,6 +439,239 @@ oggz_sort (OSData * osdata, FILE * outfile)
   return 0;
 }
 
+/*
+ * Streaming sort: the input is read once. Each track keeps its pages in
+ * order in a queue, and the tracks with queued pages are kept in a
+ * min-heap on the time of their first page. A page is written once
+ * every track which has not ended has read a page at least as late, or
+ * earlier if the page has been held for longer than the maximum latency
+ * or the buffer is full.
+ */
+
+static int
+ospage_before (const OSPage * a, const OSPage * b)
+{
+  if (a->time != b->time) return (a->time < b->time);
+  return (a->seq < b->seq);
+}
+
+static void
+osheap_swap (OSData * osdata, int i, int j)
+{
+  OSTrack * tmp = osdata->heap[i];
+  osdata->heap[i] = osdata->heap[j];
+  osdata->heap[j] = tmp;
+}
+
+static void
+osheap_push (OSData * osdata, OSTrack * track)
+{
+  OSTrack ** new_heap;
+  int i, parent;
+
+  if (osdata->heap_size == osdata->heap_max) {
+    osdata->heap_max = osdata->heap_max ? osdata->heap_max * 2 : 16;
+    new_heap = realloc (osdata->heap, osdata->heap_max * sizeof (OSTrack *));
+    if (new_heap == NULL) exit_out_of_memory ();
+    osdata->heap = new_heap;
+  }
+
+  i = osdata->heap_size++;
+  osdata->heap[i] = track;
+
+  while (i > 0) {
+    parent = (i - 1) / 2;
+    if (!ospage_before (osdata->heap[i]->head, osdata->heap[parent]->head))
+      break;
+    osheap_swap (osdata, i, parent);
+    i = parent;
+  }
+}
+
+static OSTrack *
+osheap_pop (OSData * osdata)
+{
+  OSTrack * top = osdata->heap[0];
+  int i = 0, child;
+
+  osdata->heap[0] = osdata->heap[--osdata->heap_size];
+
+  while ((child = 2*i + 1) < osdata->heap_size) {
+    if (child + 1 < osdata->heap_size &&
+        ospage_before (osdata->heap[child+1]->head, osdata->heap[child]->head))
+      child++;
+    if (!ospage_before (osdata->heap[child]->head, osdata->heap[i]->head))
+      break;
+    osheap_swap (osdata, i, child);
+    i = child;
+  }
+
+  return top;
+}
+
+/*
+ * Write out the earliest held pages, as far as is allowed. If flush is
+ * set, write all held pages.
+ */
+static void
+osdata_emit (OSData * osdata, int flush)
+{
+  OSTrack * track;
+  OSPage * page;
+  ogg_int64_t horizon;
+  int i, n, forced;
+
+  while (osdata->heap_size > 0) {
+    page = osdata->heap[0]->head;
+
+    /* The earliest time at which another page may yet be read */
+    horizon = -1;
+    n = oggz_table_size (osdata->tracks);
+    for (i = 0; i < n; i++) {
+      track = (OSTrack *) oggz_table_nth (osdata->tracks, i, NULL);
+      if (!track->eos && track->timed &&
+          (horizon == -1 || track->time < horizon))
+        horizon = track->time;
+    }
+
+    forced = 0;
+    if (!flush && horizon != -1 && page->time > horizon) {
+      if (osdata->max_buffer > 0 && osdata->buffered > osdata->max_buffer)
+        forced = 1;
+      else if (osdata->max_latency > 0 &&
+               osdata->newest - page->time > osdata->max_latency)
+        forced = 1;
+      else
+        break;
+    }
+
+    track = osheap_pop (osdata);
+    track->head = page->next;
+    if (track->head == NULL) track->tail = NULL;
+    else osheap_push (osdata, track);
+
+    if (osdata->verbose && forced) {
+      fprintf (stderr, "%s: writing serialno %010lu at ", progname,
+               track->serialno);
+      ot_fprint_time (stderr, (double)page->time / 1000000000.0);
+      fprintf (stderr, " before all tracks reached it\n");
+    }
+
+    checked_fwrite (page->og->header, 1, page->og->header_len,
+                    osdata->outfile);
+    checked_fwrite (page->og->body, 1, page->og->body_len, osdata->outfile);
+
+    osdata->buffered -= page->og->header_len + page->og->body_len;
+    _ogg_page_free (page->og);
+    free (page);
+  }
+}
+
+static int
+read_page_stream (OGGZ * oggz, const ogg_page * og, long serialno,
+                  void * user_data)
+{
+  OSData * osdata = (OSData *)user_data;
+  OSTrack * track;
+  OSPage * page;
+  ogg_int64_t granulepos, time;
+
+  track = (OSTrack *) oggz_table_lookup (osdata->tracks, serialno);
+  if (track == NULL) {
+    track = (OSTrack *) malloc (sizeof (OSTrack));
+    if (track == NULL) return OGGZ_STOP_ERR;
+
+    track->serialno = serialno;
+    track->head = track->tail = NULL;
+    track->time = 0;
+    track->timed = 1;
+    track->eos = 0;
+
+    if (oggz_table_insert (osdata->tracks, serialno, track) == NULL) {
+      free (track);
+      return OGGZ_STOP_ERR;
+    }
+  } else if (ogg_page_bos ((ogg_page *)og)) {
+    /* A chained stream reusing the serialno of an ended track */
+    track->time = 0;
+    track->timed = 1;
+    track->eos = 0;
+  }
+
+  page = (OSPage *) malloc (sizeof (OSPage));
+  if (page == NULL) return OGGZ_STOP_ERR;
+
+  if ((page->og = _ogg_page_copy (og)) == NULL) {
+    free (page);
+    return OGGZ_STOP_ERR;
+  }
+
+  /* Pages on which no packet ends must have a granulepos of -1 */
+  if (ogg_page_packets (page->og) == 0 &&
+      ogg_page_granulepos (page->og) != -1) {
+    oggz_page_set_granulepos (page->og, -1);
+  }
+
+  /* A page with no granulepos takes the time of the page before it. The
+   * pages of tracks whose time is not known are not waited for. */
+  granulepos = ogg_page_granulepos (page->og);
+  if (granulepos != -1 && track->timed) {
+    time = oggz_granulepos_to_time (oggz, serialno, granulepos);
+    if (time < 0) track->timed = 0;
+    else if (time > track->time) track->time = time;
+  }
+
+  page->time = track->timed ? track->time : osdata->newest;
+  page->seq = osdata->seq++;
+  page->next = NULL;
+
+  if (page->time > osdata->newest) osdata->newest = page->time;
+
+  if (track->tail == NULL) {
+    track->head = track->tail = page;
+    osheap_push (osdata, track);
+  } else {
+    track->tail->next = page;
+    track->tail = page;
+  }
+
+  osdata->buffered += og->header_len + og->body_len;
+
+  if (ogg_page_eos ((ogg_page *)og)) track->eos = 1;
+
+  osdata_emit (osdata, 0);
+
+  return OGGZ_CONTINUE;
+}
+
+static int
+oggz_sort_stream (OSData * osdata, FILE * infile, FILE * outfile)
+{
+  OGGZ * reader;
+  long n;
+
+  if ((reader = oggz_open_stdio (infile, OGGZ_READ|OGGZ_AUTO)) == NULL)
+    return -1;
+
+  if ((osdata->tracks = oggz_table_new ()) == NULL)
+    exit_out_of_memory ();
+
+  osdata->outfile = outfile;
+
+  oggz_set_read_page (reader, -1, read_page_stream, osdata);
+
+  while ((n = oggz_read (reader, READ_SIZE)) > 0);
+
+  if (n == OGGZ_ERR_STOP_ERR || n == OGGZ_ERR_OUT_OF_MEMORY)
+    exit_out_of_memory ();
+
+  osdata_emit (osdata, 1);
+
+  oggz_close (reader);
+
+  return 0;
+}
+
 int
 main (int argc, char * argv[])
 {
@@ -375,9 +681,10 @@ main (int argc, char * argv[])
   char * infilename = NULL, * outfilename = NULL;
   FILE * infile = NULL, * outfile = NULL;
   OSData * osdata;
+  int streaming = 0;
   int i;
 
-  char * optstring = "hvVo:";
+  char * optstring = "hvVo:sl:b:";
 
 #ifdef HAVE_GETOPT_LONG
   static struct option long_options[] = {
@@ -385,6 +692,9 @@ main (int argc, char * argv[])
     {"version", no_argument, 0, 'v'},
     {"verbose", no_argument, 0, 'V'},
     {"output", required_argument, 0, 'o'},
+    {"stream", no_argument, 0, 's'},
+    {"max-latency", required_argument, 0, 'l'},
+    {"max-buffer", required_argument, 0, 'b'},
     {0,0,0,0}
   };
 #endif
@@ -433,6 +743,15 @@ main (int argc, char * argv[])
     case 'o': /* output */
       outfilename = optarg;
       break;
+    case 's': /* stream */
+      streaming = 1;
+      break;
+    case 'l': /* max-latency */
+      osdata->max_latency = (ogg_int64_t)atol (optarg) * 1000000;
+      break;
+    case 'b': /* max-buffer */
+      osdata->max_buffer = atol (optarg) * 1024;
+      break;
     case 'V': /* verbose */
       osdata->verbose = 1;
     default:
@@ -458,7 +777,17 @@ main (int argc, char * argv[])
   }
 
   infilename = argv[optind++];
-  if (osdata_add_file (osdata, infilename) == -1) {
+  if (!strcmp (infilename, "-")) {
+    infile = stdin;
+    streaming = 1;
+  } else if (streaming) {
+    infile = fopen (infilename, "rb");
+    if (infile == NULL) {
+      fprintf (stderr, "%s: unable to open input file %s\n",
+               progname, infilename);
+      goto exit_err;
+    }
+  } else if (osdata_add_file (osdata, infilename) == -1) {
     fprintf (stderr, "%s: unable to open input file %s\n",
              progname, infilename);
     goto exit_err;
@@ -475,7 +804,15 @@ main (int argc, char * argv[])
     }
   }
 
-  oggz_sort (osdata, outfile);
+  if (streaming) {
+    if (oggz_sort_stream (osdata, infile, outfile) == -1) {
+      fprintf (stderr, "%s: unable to read input file %s\n",
+               progname, infilename);
+      goto exit_err;
+    }
+  } else {
+    oggz_sort (osdata, outfile);
+  }
 
  exit_ok:
   osdata_delete (osdata);